@@ -21,6 +21,10 @@
 #define MMR_DMNI_BASE	0x08000000U
 #define MMR_DBG_BASE	0x80000000U
 
+#ifndef HAL_PROFILE
+	#define HAL_PROFILE 0	//!< Timestamps the traps to measure latency and context switch cost
+#endif
+
 ENUM_BEGIN
 	// HAL_REG_ZERO,
 	ENUM_VAL(HAL_REG_RA)
@@ -75,6 +79,39 @@ ENUM_BEGIN
 	ENUM_VALASSIGN(HAL_EXC_STORE_PAGE_FLT, 15)
 ENUM_END(hal_exc_e)
 
+/* Timestamps of the last trap, as written by the HAL when profiling */
+ENUM_BEGIN
+	ENUM_VAL(HAL_PROF_ENTRY)		// vector_entry
+	ENUM_VAL(HAL_PROF_DISPATCH)		// Call to the dispatcher
+	ENUM_VAL(HAL_PROF_EXIT)			// Return of the dispatcher, scheduler included
+	ENUM_VAL(HAL_PROF_LEAVE)		// mret, before the context loads, or idle
+	ENUM_VAL(HAL_PROF_ENTRY_PATH)
+	ENUM_VAL(HAL_PROF_EXIT_PATH)
+
+	ENUM_VAL(HAL_PROF_MAX)
+ENUM_END(hal_prof_e)
+
+/* Paths from vector_entry to the dispatcher */
+ENUM_BEGIN
+	ENUM_VAL(HAL_ENTRY_IDLE)		// Interrupt of the idle task, nothing saved
+	ENUM_VAL(HAL_ENTRY_ECALL)		// Syscall, save_minimum
+	ENUM_VAL(HAL_ENTRY_IRQ)			// Interrupt of a task, full save
+	ENUM_VAL(HAL_ENTRY_EXC)			// Exception, full save
+
+	ENUM_VAL(HAL_ENTRY_MAX)
+ENUM_END(hal_entry_e)
+
+/* Paths from the dispatcher return to mret */
+ENUM_BEGIN
+	ENUM_VAL(HAL_EXIT_IDLE)			// Idle task scheduled
+	ENUM_VAL(HAL_EXIT_ISR_SAME)		// restore_minimum to the interrupted task
+	ENUM_VAL(HAL_EXIT_ISR_SWITCH)	// Callee registers and page, then restore_minimum
+	ENUM_VAL(HAL_EXIT_ECALL_SAME)	// ecall_return to the calling task
+	ENUM_VAL(HAL_EXIT_COMPLETE)		// restore_complete
+
+	ENUM_VAL(HAL_EXIT_MAX)			// No trap left the HAL yet
+ENUM_END(hal_exit_e)
+
 #ifndef __ASSEMBLY__
 
 /* Forward Declaration */
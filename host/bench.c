@@ -0,0 +1,574 @@
+/**
+ * MAestro
+ * @file bench.c
+ *
+ * @author Angelo Elias Dalzotto (angelo.dalzotto@edu.pucrs.br)
+ * GAPH - Hardware Design Support Group (https://corfu.pucrs.br/)
+ * PUCRS - Pontifical Catholic University of Rio Grande do Sul (http://pucrs.br/)
+ *
+ * @date October 2026
+ *
+ * @brief Micro-benchmarks of the kernel hot paths on the host.
+ *
+ * @details Each case boots a fresh simulation, allocates a synthetic task set
+ * through TASK_ALLOCATION packets and calls the kernel function under test
+ * directly. Two costs are reported per operation: host cycles, which follow
+ * the compiled code, and model cycles, which count the register accesses and
+ * transfers of the simulation and are reproducible across runs.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <sim.h>
+
+#include <hal.h>
+#include <task_control.h>
+#include <task_allocation.h>
+#include <message.h>
+
+#include <memphis/services.h>
+
+#ifndef BENCH_ITERATIONS
+	#define BENCH_ITERATIONS 1000	//!< Default operations measured per case
+#endif
+
+#ifndef BENCH_SETTLE
+	#define BENCH_SETTLE 200000	//!< Cycles given to the kernels to handle the packets of a step
+#endif
+
+#ifndef BENCH_PERIOD
+	#define BENCH_PERIOD 100000	//!< Period of the real-time tasks in cycles
+#endif
+
+#define BENCH_IMAGE_SIZE 16	//!< Bytes of text and of data of the synthetic tasks
+#define BENCH_APP 1			//!< Application of the synthetic tasks
+
+/**
+ * @brief Kernel functions under test, resolved per PE
+ */
+typedef struct _bench_kernel {
+	tcb_t *(*tcb_find)(int task);
+	app_t *(*tcb_get_app)(tcb_t *tcb);
+	sched_t *(*tcb_get_sched)(tcb_t *tcb);
+	int (*app_copy_location)(app_t *app, size_t task_cnt, int *task_location);
+	void (*sched_run)();
+	void (*sched_real_time_task)(sched_t *sched, unsigned period, int deadline, unsigned execution_time);
+	int (*sys_writepipe)(tcb_t *tcb, void *buf, size_t size, int cons_task, bool sync);
+	int (*sys_readpipe)(tcb_t *tcb, void *buf, size_t size, int prod_task, bool sync);
+	void *(*hermes_recv_pkt)(uint8_t service);
+	int (*msg_recv_message_request)(msg_hdshk_t *hdshk);
+	void (*pool_free)(void *ptr);
+} bench_kernel_t;
+
+/**
+ * @brief Cost accumulated by a case
+ */
+typedef struct _bench_stat {
+	uint64_t host;			//!< Host cycles
+	uint64_t model;			//!< Model cycles
+	uint64_t host_start;
+	uint64_t model_start;
+	unsigned ops;
+} bench_stat_t;
+
+static const unsigned BENCH_SIZES[] = {16, 256, 1024};
+static const unsigned BENCH_TASKS[] = {1, 2, 4, 8, 16};
+static const unsigned BENCH_RT[] = {0, 50, 100};
+
+static const unsigned BENCH_SIZE_CNT = sizeof(BENCH_SIZES)/sizeof(BENCH_SIZES[0]);
+static const unsigned BENCH_TASK_CNT = sizeof(BENCH_TASKS)/sizeof(BENCH_TASKS[0]);
+static const unsigned BENCH_RT_CNT = sizeof(BENCH_RT)/sizeof(BENCH_RT[0]);
+
+/* Message buffer in the data bank of the tasks, past their image */
+static void *const BENCH_BUF = (void*)(MMR_DATA_BASE | 0x100);
+
+bench_kernel_t _bench_k[2];
+const char *_bench_kernel = "./kernel-host.so";
+unsigned _bench_iter = BENCH_ITERATIONS;
+
+/**
+ * @brief Reads the host cycle counter
+ *
+ * @return uint64_t Host cycles, nanoseconds if there is no counter
+ */
+static inline uint64_t _bench_tsc()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	return __builtin_ia32_rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec)*1000000000 + ts.tv_nsec;
+#endif
+}
+
+/**
+ * @brief Starts timing an operation
+ *
+ * @param stat Pointer to the cost of the case
+ */
+void _bench_start(bench_stat_t *stat);
+
+/**
+ * @brief Stops timing an operation
+ *
+ * @param stat Pointer to the cost of the case
+ */
+void _bench_stop(bench_stat_t *stat);
+
+/**
+ * @brief Prints the cost per operation of a case
+ *
+ * @param name Name of the case
+ * @param stat Pointer to the cost of the case
+ */
+void _bench_report(const char *name, bench_stat_t *stat);
+
+/**
+ * @brief Boots a simulation and resolves the kernel functions
+ *
+ * @param pe_cnt Number of PEs, in a row
+ *
+ * @return int 0 success, -1 on failure
+ */
+int _bench_boot(unsigned pe_cnt);
+
+/**
+ * @brief Allocates synthetic tasks of the same application
+ *
+ * @details The tasks are released as if sent by the Injector, and every PE
+ * learns where each task is.
+ *
+ * @param pes Sequential PE address of each task
+ * @param cnt Number of tasks
+ *
+ * @return int 0 success, -1 on failure
+ */
+int _bench_tasks(const unsigned *pes, unsigned cnt);
+
+/**
+ * @brief Gets the TCB of a synthetic task
+ *
+ * @param pe Sequential PE address
+ * @param idx Task index in the application
+ *
+ * @return tcb_t* Pointer to the TCB, NULL if not allocated
+ */
+tcb_t *_bench_tcb(unsigned pe, unsigned idx);
+
+/**
+ * @brief Measures the scheduler with N tasks and a share of real-time tasks
+ *
+ * @param cnt Number of tasks
+ * @param rt Percentage of real-time tasks
+ *
+ * @return int 0 success, -1 on failure
+ */
+int _bench_sched(unsigned cnt, unsigned rt);
+
+/**
+ * @brief Measures the TCB lookup of present and absent tasks
+ *
+ * @param cnt Number of tasks
+ *
+ * @return int 0 success, -1 on failure
+ */
+int _bench_tcb_find(unsigned cnt);
+
+/**
+ * @brief Measures a message between two tasks of the same PE
+ *
+ * @param size Message size in bytes
+ *
+ * @return int 0 success, -1 on failure
+ */
+int _bench_pipe_local(unsigned size);
+
+/**
+ * @brief Measures a message between tasks of neighbour PEs
+ *
+ * @details The message request is received and handled by direct calls, the
+ * DATA_AV and the delivery through the interrupts of the consumer PE.
+ *
+ * @param size Message size in bytes
+ *
+ * @return int 0 success, -1 on failure
+ */
+int _bench_pipe_remote(unsigned size);
+
+int main(int argc, char *argv[])
+{
+	int opt;
+	while ((opt = getopt(argc, argv, "k:n:")) != -1) {
+		switch (opt) {
+			case 'k':
+				_bench_kernel = optarg;
+				break;
+			case 'n':
+				_bench_iter = strtoul(optarg, NULL, 0);
+				break;
+			default:
+				fprintf(stderr, "Usage: %s [-k kernel] [-n iterations]\n", argv[0]);
+				return 1;
+		}
+	}
+
+	if (_bench_iter == 0)
+		_bench_iter = 1;
+
+	printf("%-36s %8s %14s %14s\n", "case", "ops", "host cyc/op", "model cyc/op");
+
+	int ret = 0;
+	for (unsigned i = 0; i < BENCH_TASK_CNT; i++) {
+		for (unsigned j = 0; j < BENCH_RT_CNT; j++)
+			ret |= _bench_sched(BENCH_TASKS[i], BENCH_RT[j]);
+	}
+
+	for (unsigned i = 0; i < BENCH_TASK_CNT; i++)
+		ret |= _bench_tcb_find(BENCH_TASKS[i]);
+
+	for (unsigned i = 0; i < BENCH_SIZE_CNT; i++)
+		ret |= _bench_pipe_local(BENCH_SIZES[i]);
+
+	for (unsigned i = 0; i < BENCH_SIZE_CNT; i++)
+		ret |= _bench_pipe_remote(BENCH_SIZES[i]);
+
+	return (ret != 0);
+}
+
+void _bench_start(bench_stat_t *stat)
+{
+	stat->model_start = sim_get_time();
+	stat->host_start = _bench_tsc();
+}
+
+void _bench_stop(bench_stat_t *stat)
+{
+	stat->host += _bench_tsc() - stat->host_start;
+	stat->model += sim_get_time() - stat->model_start;
+	stat->ops++;
+}
+
+void _bench_report(const char *name, bench_stat_t *stat)
+{
+	if (stat->ops == 0) {
+		printf("%-36s %8u %14s %14s\n", name, 0, "-", "-");
+		return;
+	}
+
+	printf(
+		"%-36s %8u %14.1f %14.1f\n",
+		name,
+		stat->ops,
+		(double)stat->host/stat->ops,
+		(double)stat->model/stat->ops
+	);
+}
+
+int _bench_boot(unsigned pe_cnt)
+{
+	sim_cfg_t cfg = {
+		.kernel    = _bench_kernel,
+		.x_cnt     = pe_cnt,
+		.y_cnt     = 1,
+		.slots     = 16,
+		.page_size = 65536
+	};
+
+	if (sim_init(&cfg) != 0)
+		return -1;
+
+	for (unsigned i = 0; i < pe_cnt; i++) {
+		bench_kernel_t *k = &_bench_k[i];
+
+		k->tcb_find                 = sim_sym(i, "tcb_find");
+		k->tcb_get_app              = sim_sym(i, "tcb_get_app");
+		k->tcb_get_sched            = sim_sym(i, "tcb_get_sched");
+		k->app_copy_location        = sim_sym(i, "app_copy_location");
+		k->sched_run                = sim_sym(i, "sched_run");
+		k->sched_real_time_task     = sim_sym(i, "sched_real_time_task");
+		k->sys_writepipe            = sim_sym(i, "sys_writepipe");
+		k->sys_readpipe             = sim_sym(i, "sys_readpipe");
+		k->hermes_recv_pkt          = sim_sym(i, "hermes_recv_pkt");
+		k->msg_recv_message_request = sim_sym(i, "msg_recv_message_request");
+		k->pool_free                = sim_sym(i, "pool_free");
+
+		/* Any missing symbol is an incompatible kernel */
+		void **fn = (void**)k;
+		for (unsigned j = 0; j < sizeof(bench_kernel_t)/sizeof(void*); j++) {
+			if (fn[j] == NULL) {
+				fprintf(stderr, "ERROR: %s misses a benchmarked function\n", _bench_kernel);
+				sim_destroy();
+				return -1;
+			}
+		}
+	}
+
+	return 0;
+}
+
+int _bench_tasks(const unsigned *pes, unsigned cnt)
+{
+	size_t size = sizeof(talloc_t) + 2*BENCH_IMAGE_SIZE;
+	talloc_t *alloc = calloc(1, size);
+	int *locs = malloc(cnt*sizeof(int));
+	if (alloc == NULL || locs == NULL) {
+		free(alloc);
+		free(locs);
+		return -1;
+	}
+
+	for (unsigned i = 0; i < cnt; i++) {
+		locs[i] = (pes[i] << 8);
+
+		alloc->hermes.address = locs[i];
+		alloc->hermes.service = TASK_ALLOCATION;
+		alloc->entry_point    = 0;
+		alloc->text_size      = BENCH_IMAGE_SIZE;
+		alloc->data_size      = BENCH_IMAGE_SIZE;
+		alloc->bss_size       = 0;
+		alloc->mapper_address = 0;
+		alloc->task           = (BENCH_APP << 8) | i;
+		alloc->mapper_task    = -1;
+		alloc->batch          = 1;
+
+		sim_inject(pes[i], alloc, size, sim_get_time());
+	}
+
+	free(alloc);
+	sim_run(sim_get_time() + BENCH_SETTLE);
+
+	int ret = 0;
+	for (unsigned i = 0; i < cnt; i++) {
+		if (_bench_tcb(pes[i], i) == NULL) {
+			fprintf(stderr, "ERROR: task %u was not allocated\n", i);
+			ret = -1;
+		}
+	}
+
+	/* The location table is kept per application in each PE */
+	for (unsigned pe = 0; pe < sim_pe_cnt() && ret == 0; pe++) {
+		for (unsigned i = 0; i < cnt; i++) {
+			if (pes[i] != pe)
+				continue;
+
+			tcb_t *tcb = _bench_tcb(pe, i);
+			_bench_k[pe].app_copy_location(_bench_k[pe].tcb_get_app(tcb), cnt, locs);
+			break;
+		}
+	}
+
+	free(locs);
+	return ret;
+}
+
+tcb_t *_bench_tcb(unsigned pe, unsigned idx)
+{
+	return _bench_k[pe].tcb_find((BENCH_APP << 8) | idx);
+}
+
+int _bench_sched(unsigned cnt, unsigned rt)
+{
+	if (_bench_boot(1) != 0)
+		return -1;
+
+	unsigned pes[cnt];
+	memset(pes, 0, sizeof(pes));
+
+	bench_kernel_t *k = &_bench_k[0];
+	int ret = _bench_tasks(pes, cnt);
+	for (unsigned i = 0; ret == 0 && i < cnt*rt/100; i++) {
+		/* Half of the processor is shared by the real-time tasks */
+		sched_t *sched = k->tcb_get_sched(_bench_tcb(0, i));
+		k->sched_real_time_task(sched, BENCH_PERIOD, BENCH_PERIOD, BENCH_PERIOD/(2*cnt));
+	}
+
+	bench_stat_t stat = {0};
+	for (unsigned i = 0; ret == 0 && i < _bench_iter; i++) {
+		_bench_start(&stat);
+		k->sched_run();
+		_bench_stop(&stat);
+	}
+
+	char name[64];
+	snprintf(name, sizeof(name), "sched_run n=%u rt=%u%%", cnt, rt);
+	_bench_report(name, &stat);
+
+	sim_destroy();
+	return ret;
+}
+
+int _bench_tcb_find(unsigned cnt)
+{
+	if (_bench_boot(1) != 0)
+		return -1;
+
+	unsigned pes[cnt];
+	memset(pes, 0, sizeof(pes));
+
+	bench_kernel_t *k = &_bench_k[0];
+	int ret = _bench_tasks(pes, cnt);
+
+	bench_stat_t hit = {0};
+	bench_stat_t miss = {0};
+	for (unsigned i = 0; ret == 0 && i < _bench_iter; i++) {
+		tcb_t *tcb;
+
+		_bench_start(&hit);
+		tcb = k->tcb_find((BENCH_APP << 8) | (i % cnt));
+		_bench_stop(&hit);
+		if (tcb == NULL)
+			ret = -1;
+
+		_bench_start(&miss);
+		tcb = k->tcb_find(((BENCH_APP + 1) << 8) | (i % cnt));
+		_bench_stop(&miss);
+		if (tcb != NULL)
+			ret = -1;
+	}
+
+	char name[64];
+	snprintf(name, sizeof(name), "tcb_find hit n=%u", cnt);
+	_bench_report(name, &hit);
+	snprintf(name, sizeof(name), "tcb_find miss n=%u", cnt);
+	_bench_report(name, &miss);
+
+	sim_destroy();
+	return ret;
+}
+
+int _bench_pipe_local(unsigned size)
+{
+	if (_bench_boot(1) != 0)
+		return -1;
+
+	bench_kernel_t *k = &_bench_k[0];
+	const unsigned pes[] = {0, 0};
+	int ret = _bench_tasks(pes, 2);
+
+	tcb_t *prod = _bench_tcb(0, 0);
+	tcb_t *cons = _bench_tcb(0, 1);
+
+	bench_stat_t wr = {0};
+	bench_stat_t rd = {0};
+	for (unsigned i = 0; ret == 0 && i < _bench_iter; i++) {
+		_bench_start(&wr);
+		int result = k->sys_writepipe(prod, BENCH_BUF, size, 1, true);
+		_bench_stop(&wr);
+		if (result != size) {
+			fprintf(stderr, "ERROR: local writepipe returned %d\n", result);
+			ret = -1;
+			break;
+		}
+
+		_bench_start(&rd);
+		result = k->sys_readpipe(cons, BENCH_BUF, size, 0, true);
+		_bench_stop(&rd);
+		if (result != size) {
+			fprintf(stderr, "ERROR: local readpipe returned %d\n", result);
+			ret = -1;
+		}
+	}
+
+	char name[64];
+	snprintf(name, sizeof(name), "sys_writepipe local size=%u", size);
+	_bench_report(name, &wr);
+	snprintf(name, sizeof(name), "sys_readpipe local size=%u", size);
+	_bench_report(name, &rd);
+
+	sim_destroy();
+	return ret;
+}
+
+int _bench_pipe_remote(unsigned size)
+{
+	if (_bench_boot(2) != 0)
+		return -1;
+
+	bench_kernel_t *kp = &_bench_k[0];
+	bench_kernel_t *kc = &_bench_k[1];
+	const unsigned pes[] = {0, 1};
+	int ret = _bench_tasks(pes, 2);
+
+	tcb_t *prod = _bench_tcb(0, 0);
+	tcb_t *cons = _bench_tcb(1, 1);
+
+	bench_stat_t wr = {0};
+	bench_stat_t rd = {0};
+	bench_stat_t recv = {0};
+	bench_stat_t req = {0};
+	for (unsigned i = 0; ret == 0 && i < _bench_iter; i++) {
+		/* Stores the message and sends DATA_AV */
+		_bench_start(&wr);
+		int result = kp->sys_writepipe(prod, BENCH_BUF, size, 1, true);
+		_bench_stop(&wr);
+		if (result != size) {
+			fprintf(stderr, "ERROR: remote writepipe returned %d\n", result);
+			ret = -1;
+			break;
+		}
+
+		sim_run(sim_get_time() + BENCH_SETTLE);
+
+		/* Consumes the DATA_AV and sends MESSAGE_REQUEST */
+		_bench_start(&rd);
+		result = kc->sys_readpipe(cons, BENCH_BUF, size, 0, true);
+		_bench_stop(&rd);
+
+		uint64_t arrival = sim_pending(0);
+		if (result != -EAGAIN || arrival == UINT64_MAX) {
+			fprintf(stderr, "ERROR: remote readpipe returned %d\n", result);
+			ret = -1;
+			break;
+		}
+
+		/* Stops right before the producer PE would be interrupted */
+		sim_run(arrival);
+
+		_bench_start(&recv);
+		msg_hdshk_t *hdshk = kp->hermes_recv_pkt(MESSAGE_REQUEST);
+		_bench_stop(&recv);
+		if (hdshk == NULL) {
+			fprintf(stderr, "ERROR: MESSAGE_REQUEST not received\n");
+			ret = -1;
+			break;
+		}
+
+		_bench_start(&req);
+		result = kp->msg_recv_message_request(hdshk);
+		_bench_stop(&req);
+		kp->pool_free(hdshk);
+		if (result < 0) {
+			fprintf(stderr, "ERROR: MESSAGE_REQUEST handling returned %d\n", result);
+			ret = -1;
+			break;
+		}
+
+		/* The consumer PE receives the delivery and the read completes */
+		sim_run(sim_get_time() + BENCH_SETTLE);
+		result = kc->sys_readpipe(cons, BENCH_BUF, size, 0, true);
+		if (result != size) {
+			fprintf(stderr, "ERROR: delivered readpipe returned %d\n", result);
+			ret = -1;
+		}
+	}
+
+	char name[64];
+	snprintf(name, sizeof(name), "sys_writepipe remote size=%u", size);
+	_bench_report(name, &wr);
+	snprintf(name, sizeof(name), "sys_readpipe remote size=%u", size);
+	_bench_report(name, &rd);
+	snprintf(name, sizeof(name), "hermes_recv_pkt request size=%u", size);
+	_bench_report(name, &recv);
+	snprintf(name, sizeof(name), "msg_recv_message_request size=%u", size);
+	_bench_report(name, &req);
+
+	sim_destroy();
+	return ret;
+}
@@ -0,0 +1,21 @@
+/**
+ * MAestro
+ * @file syscall.h
+ *
+ * @author Angelo Elias Dalzotto (angelo.dalzotto@edu.pucrs.br)
+ * GAPH - Hardware Design Support Group (https://corfu.pucrs.br/)
+ * PUCRS - Pontifical Catholic University of Rio Grande do Sul (http://pucrs.br/)
+ *
+ * @date October 2026
+ *
+ * @brief Syscall numbers of newlib for RISC-V, for host builds against glibc.
+ */
+
+#pragma once
+
+#define SYS_close	57
+#define SYS_write	64
+#define SYS_fstat	80
+#define SYS_exit	93
+#define SYS_getpid	172
+#define SYS_brk		214
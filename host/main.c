@@ -0,0 +1,177 @@
+/**
+ * MAestro
+ * @file main.c
+ *
+ * @author Angelo Elias Dalzotto (angelo.dalzotto@edu.pucrs.br)
+ * GAPH - Hardware Design Support Group (https://corfu.pucrs.br/)
+ * PUCRS - Pontifical Catholic University of Rio Grande do Sul (http://pucrs.br/)
+ *
+ * @date October 2026
+ *
+ * @brief Runs the kernel of a many-core on the host.
+ *
+ * @details The optional replay file holds packets to inject, each one as
+ * little-endian 32-bit words {arrival time, sequential PE address, size in
+ * bytes} followed by the packet, header included. It is also the entry point
+ * to fuzz the packet handlers. With -t, the records written to the trace
+ * register are printed as they are completed.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+
+#include <sim.h>
+
+/**
+ * @brief Injects the packets of a replay file
+ *
+ * @param path Path of the file
+ *
+ * @return int Number of packets injected, -1 on failure
+ */
+int _replay(const char *path);
+
+/**
+ * @brief Prints the packets sent to peripherals
+ *
+ * @param src Sequential address of the source PE
+ * @param pkt Pointer to the packet
+ * @param size Size in bytes
+ */
+void _io(unsigned src, const void *pkt, size_t size);
+
+/**
+ * @brief Prints a trace record
+ *
+ * @param src Sequential address of the source PE
+ * @param rec Record words
+ */
+void _trace(unsigned src, const uint32_t rec[4]);
+
+int main(int argc, char *argv[])
+{
+	sim_cfg_t cfg = {
+		.kernel    = "./kernel-host.so",
+		.x_cnt     = 0,
+		.y_cnt     = 0,
+		.slots     = 4,
+		.page_size = 65536
+	};
+	uint64_t until = UINT64_MAX;
+	bool trace = false;
+
+	int opt;
+	while ((opt = getopt(argc, argv, "k:s:p:c:t")) != -1) {
+		switch (opt) {
+			case 'k':
+				cfg.kernel = optarg;
+				break;
+			case 's':
+				cfg.slots = strtoul(optarg, NULL, 0);
+				break;
+			case 'p':
+				cfg.page_size = strtoul(optarg, NULL, 0);
+				break;
+			case 'c':
+				until = strtoull(optarg, NULL, 0);
+				break;
+			case 't':
+				trace = true;
+				break;
+			default:
+				argc = 0;
+				break;
+		}
+	}
+
+	if (argc - optind < 2) {
+		fprintf(
+			stderr,
+			"Usage: %s [-k kernel] [-s slots] [-p page size] [-c cycles] [-t] X Y [replay]\n",
+			argv[0]
+		);
+		return 1;
+	}
+
+	cfg.x_cnt = strtoul(argv[optind], NULL, 0);
+	cfg.y_cnt = strtoul(argv[optind + 1], NULL, 0);
+
+	if (sim_init(&cfg) != 0)
+		return 1;
+
+	sim_set_io(_io);
+	if (trace)
+		sim_set_trace(_trace);
+
+	if (argc - optind > 2 && _replay(argv[optind + 2]) < 0) {
+		sim_destroy();
+		return 1;
+	}
+
+	uint64_t end = sim_run(until);
+	printf(
+		"Simulation %s at %llu cycles\n",
+		sim_halted() ? "halted" : "ended",
+		(unsigned long long)end
+	);
+
+	sim_destroy();
+	return 0;
+}
+
+int _replay(const char *path)
+{
+	FILE *file = fopen(path, "rb");
+	if (file == NULL) {
+		perror(path);
+		return -1;
+	}
+
+	int cnt = 0;
+	uint32_t rec[3];
+	while (fread(rec, sizeof(uint32_t), 3, file) == 3) {
+		void *pkt = malloc(rec[2]);
+		if (pkt == NULL || fread(pkt, 1, rec[2], file) != rec[2]) {
+			free(pkt);
+			break;
+		}
+
+		if (sim_inject(rec[1], pkt, rec[2], rec[0]) != 0)
+			fprintf(stderr, "WARN: invalid packet %d in %s\n", cnt, path);
+		else
+			cnt++;
+
+		free(pkt);
+	}
+
+	fclose(file);
+	return cnt;
+}
+
+void _io(unsigned src, const void *pkt, size_t size)
+{
+	const uint32_t *head = pkt;
+	printf(
+		"IO packet from PE %u at %llu: head %x, %zu bytes\n",
+		src,
+		(unsigned long long)sim_get_time(),
+		head[0],
+		size
+	);
+}
+
+void _trace(unsigned src, const uint32_t rec[4])
+{
+	printf(
+		"Trace from PE %u at %u: task %d event %u args %x %x\n",
+		src,
+		rec[0],
+		(int16_t)(rec[1] >> 16),
+		rec[1] & 0xFFFF,
+		rec[2],
+		rec[3]
+	);
+}
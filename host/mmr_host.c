@@ -0,0 +1,56 @@
+/**
+ * MAestro
+ * @file mmr_host.c
+ *
+ * @author Angelo Elias Dalzotto (angelo.dalzotto@edu.pucrs.br)
+ * GAPH - Hardware Design Support Group (https://corfu.pucrs.br/)
+ * PUCRS - Pontifical Catholic University of Rio Grande do Sul (http://pucrs.br/)
+ *
+ * @date October 2026
+ *
+ * @brief Memory mapped registers of a PE simulated on the host.
+ */
+
+#include <mmr_host.h>
+
+#include <time.h>
+
+#include <hal.h>
+
+mmr_host_t _mmr_host = { .pe = NULL };
+
+void mmr_host_bind(const mmr_host_t *host)
+{
+	_mmr_host = *host;
+}
+
+volatile unsigned *mmr_host_reg(unsigned addr)
+{
+	return _mmr_host.reg(_mmr_host.pe, addr);
+}
+
+unsigned mmr_host_mem()
+{
+	return _mmr_host.mem;
+}
+
+uint64_t mmr_host_cycles()
+{
+#if defined(__i386__) || defined(__x86_64__)
+	return __builtin_ia32_rdtsc();
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec)*1000000000 + ts.tv_nsec;
+#endif
+}
+
+void _hal_enable_mti()
+{
+	_mmr_host.mti(_mmr_host.pe, true);
+}
+
+void _hal_disable_mti()
+{
+	_mmr_host.mti(_mmr_host.pe, false);
+}
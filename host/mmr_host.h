@@ -0,0 +1,66 @@
+/**
+ * MAestro
+ * @file mmr_host.h
+ *
+ * @author Angelo Elias Dalzotto (angelo.dalzotto@edu.pucrs.br)
+ * GAPH - Hardware Design Support Group (https://corfu.pucrs.br/)
+ * PUCRS - Pontifical Catholic University of Rio Grande do Sul (http://pucrs.br/)
+ *
+ * @date October 2026
+ *
+ * @brief Memory mapped registers of a PE simulated on the host.
+ *
+ * @details The host build compiles the kernel as a shared object. Each
+ * simulated PE loads its own copy, so the kernel state is not shared, and
+ * binds it to the simulator. Every register access calls the simulator back
+ * before the load or store, which then applies the effects of the previous
+ * accesses, such as starting a DMNI transfer.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Simulator callbacks of a PE
+ */
+typedef struct _mmr_host {
+	void *pe;											//!< Simulated PE, passed back to the callbacks
+	volatile unsigned *(*reg)(void *pe, unsigned addr);	//!< Gets the storage of a register
+	void (*mti)(void *pe, bool enable);					//!< Sets the timer interrupt enable
+	unsigned mem;										//!< Host buffer holding the PE memory
+} mmr_host_t;
+
+/**
+ * @brief Binds the kernel to a simulated PE
+ *
+ * @param host Pointer to the callbacks (copied)
+ */
+void mmr_host_bind(const mmr_host_t *host);
+
+/**
+ * @brief Gets the storage of a register
+ *
+ * @param addr Register address
+ *
+ * @return volatile unsigned* Pointer to the register
+ */
+volatile unsigned *mmr_host_reg(unsigned addr);
+
+/**
+ * @brief Gets the memory of the PE
+ *
+ * @details Aligned to the largest task region, so task offsets are still
+ * composed by OR-ing.
+ *
+ * @return unsigned Address of the host buffer
+ */
+unsigned mmr_host_mem();
+
+/**
+ * @brief Reads the host cycle counter
+ *
+ * @return uint64_t Cycle count
+ */
+uint64_t mmr_host_cycles();
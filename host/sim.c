@@ -0,0 +1,867 @@
+/**
+ * MAestro
+ * @file sim.c
+ *
+ * @author Angelo Elias Dalzotto (angelo.dalzotto@edu.pucrs.br)
+ * GAPH - Hardware Design Support Group (https://corfu.pucrs.br/)
+ * PUCRS - Pontifical Catholic University of Rio Grande do Sul (http://pucrs.br/)
+ *
+ * @date October 2026
+ *
+ * @brief Deterministic many-core simulation of the kernel on the host.
+ *
+ * @details C has no hook for a load or a store, so the register model works
+ * on the next access: a write is seen when the kernel comes back to the
+ * registers, which it always does before depending on its effect. START bits
+ * are cleared once served, write-only registers are served on the access
+ * that follows them, and the broadcast service register is presented with a
+ * marker bit, so a send is told apart from the message being read.
+ */
+
+/* Registers are addresses for the model, not pointers */
+#define MMR_REG(addr) (addr)
+
+#include <sim.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dlfcn.h>
+#include <sys/mman.h>
+
+#include <mmr.h>
+#include <hal.h>
+#include <hermes.h>
+#include <interrupts.h>
+#include <mmr_host.h>
+
+static const uint64_t SIM_NEVER = UINT64_MAX;
+static const unsigned SIM_BR_SHOWN = 0x100;	//!< Marks the service of a broadcast presented to the kernel
+static const unsigned SIM_BR_EXTERNAL = 0xFFFF;	//!< Source of broadcasts from outside the many-core
+
+/**
+ * @brief Index of the registers in the register file
+ */
+enum SIM_REG {
+	SIM_REG_RTC = 0,					//!< 4 words from MMR_RTC_BASE
+	SIM_REG_PLIC = 4,					//!< IP, IE, ID
+	SIM_REG_DMNI = 7,					//!< 24 words from MMR_DMNI_BASE
+	SIM_REG_DBG = SIM_REG_DMNI + 24,	//!< 29 words from MMR_DBG_BASE
+	SIM_REG_SCRATCH = SIM_REG_DBG + 29,	//!< Unmapped addresses
+	SIM_REG_CNT
+};
+
+/**
+ * @brief Packet in the NoC
+ */
+typedef struct _sim_pkt {
+	struct _sim_pkt *next;
+	uint64_t time;		//!< Arrival time
+	uint32_t sent;		//!< Lower word of the injection time
+	size_t size;		//!< Size in bytes
+	size_t read;		//!< Bytes already received by the DMNI
+	uint8_t data[];
+} sim_pkt_t;
+
+/**
+ * @brief Broadcast in the BrLite
+ */
+typedef struct _sim_br {
+	struct _sim_br *next;
+	uint64_t time;		//!< Arrival time
+	uint32_t ksvc;
+	uint32_t payload;	//!< (source << 16) | payload
+} sim_br_t;
+
+/**
+ * @brief Simulated PE
+ */
+typedef struct _sim_pe {
+	void *lib;						//!< Kernel copy of the PE
+	tcb_t *(*isr)(unsigned status);	//!< Interrupt dispatcher of the kernel
+	void *map;						//!< Host mapping of the memory
+	size_t map_size;
+	uint32_t regs[SIM_REG_CNT];
+	uint32_t ksvc;					//!< Broadcast service presented, a different value is a send
+	uint32_t payload;				//!< Broadcast payload presented
+	int wr;							//!< Write-only register accessed last, -1 if none
+	uint32_t trace[4];				//!< Trace record being written to MMR_DBG_TRACE
+	unsigned trace_cnt;				//!< Words of the trace record written
+	bool mti;						//!< Timer interrupt enabled
+	bool br_shown;					//!< Head broadcast presented to the dispatcher
+	sim_pkt_t *rx;					//!< Inbound packets in arrival order
+	sim_br_t *br;					//!< Inbound broadcasts in arrival order
+} sim_pe_t;
+
+sim_pe_t *_sim_pes = NULL;
+unsigned _sim_x_cnt = 0;
+unsigned _sim_y_cnt = 0;
+uint64_t _sim_time = 0;
+bool _sim_halt = false;
+void (*_sim_io)(unsigned src, const void *pkt, size_t size) = NULL;
+void (*_sim_trace)(unsigned src, const uint32_t rec[4]) = NULL;
+
+/**
+ * @brief Gets the index of a register in the register file
+ *
+ * @param addr Register address
+ *
+ * @return unsigned Index, SIM_REG_SCRATCH if not mapped
+ */
+static inline unsigned _sim_idx(unsigned addr)
+{
+	unsigned off = addr & 0x00FFFFFF;
+
+	switch (addr & 0xFF000000) {
+		case MMR_RTC_BASE:
+			if (off < 0x10)
+				return SIM_REG_RTC + (off >> 2);
+			break;
+		case MMR_PLIC_BASE:
+			if (addr == MMR_PLIC_IP)
+				return SIM_REG_PLIC;
+			if (addr == MMR_PLIC_IE)
+				return SIM_REG_PLIC + 1;
+			if (addr == MMR_PLIC_ID)
+				return SIM_REG_PLIC + 2;
+			break;
+		case MMR_DMNI_BASE:
+			if (off < 0x60)
+				return SIM_REG_DMNI + (off >> 2);
+			break;
+		case MMR_DBG_BASE:
+			if (off < 0x74)
+				return SIM_REG_DBG + (off >> 2);
+			break;
+		default:
+			break;
+	}
+
+	return SIM_REG_SCRATCH;
+}
+
+#define SIM_REG(pe, mmr) ((pe)->regs[_sim_idx(mmr)])
+
+/**
+ * @brief Register callback of the kernel
+ *
+ * @param arg Pointer to the PE
+ * @param addr Register address
+ *
+ * @return volatile unsigned* Pointer to the register
+ */
+volatile unsigned *_sim_reg(void *arg, unsigned addr);
+
+/**
+ * @brief Timer interrupt enable callback of the kernel
+ *
+ * @param arg Pointer to the PE
+ * @param enable Interrupt enable
+ */
+void _sim_mti(void *arg, bool enable);
+
+/**
+ * @brief Applies the effects of the last register writes
+ *
+ * @param pe Pointer to the PE
+ */
+void _sim_settle(sim_pe_t *pe);
+
+/**
+ * @brief Sends the packet programmed in the DMNI
+ *
+ * @param pe Pointer to the PE
+ */
+void _sim_send(sim_pe_t *pe);
+
+/**
+ * @brief Receives the flits programmed in the DMNI
+ *
+ * @param pe Pointer to the PE
+ */
+void _sim_recv(sim_pe_t *pe);
+
+/**
+ * @brief Sends the broadcast written to the BrLite
+ *
+ * @param pe Pointer to the PE
+ */
+void _sim_br_send(sim_pe_t *pe);
+
+/**
+ * @brief Serves a write to a debug register
+ *
+ * @param pe Pointer to the PE
+ * @param idx Register index
+ */
+void _sim_dbg(sim_pe_t *pe, unsigned idx);
+
+/**
+ * @brief Gets the pending DMNI interrupts
+ *
+ * @param pe Pointer to the PE
+ *
+ * @return uint32_t DMNI interrupt pending bits
+ */
+uint32_t _sim_dmni_ip(sim_pe_t *pe);
+
+/**
+ * @brief Gets the pending interrupts of the core
+ *
+ * @param pe Pointer to the PE
+ *
+ * @return unsigned mip & mie
+ */
+unsigned _sim_irq(sim_pe_t *pe);
+
+/**
+ * @brief Presents the oldest arrived broadcast to the dispatcher
+ *
+ * @param pe Pointer to the PE
+ */
+void _sim_br_show(sim_pe_t *pe);
+
+/**
+ * @brief Removes the broadcast presented to the dispatcher
+ *
+ * @param pe Pointer to the PE
+ */
+void _sim_br_pop(sim_pe_t *pe);
+
+/**
+ * @brief Inserts a packet in the inbound queue of a PE, by arrival time
+ *
+ * @param pe Pointer to the PE
+ * @param pkt Pointer to the packet
+ */
+void _sim_push_pkt(sim_pe_t *pe, sim_pkt_t *pkt);
+
+/**
+ * @brief Inserts a broadcast in the inbound queue of every PE but the source
+ *
+ * @param src Sequential address of the source, SIM_BR_EXTERNAL if outside
+ * @param ksvc Kernel service
+ * @param payload Payload
+ * @param time Arrival time
+ *
+ * @return int
+ *  0 success
+ * -ENOMEM: not enough host memory
+ */
+int _sim_push_br(unsigned src, uint8_t ksvc, uint16_t payload, uint64_t time);
+
+/**
+ * @brief Gets the next event after the current time
+ *
+ * @return uint64_t Time of the event, SIM_NEVER if none
+ */
+uint64_t _sim_next_evt();
+
+/**
+ * @brief Maps the memory of a PE
+ *
+ * @details The task and data banks are MMR_DATA_BASE apart, as seen by the
+ * kernel, and aligned so region offsets and the data bank can be OR-ed.
+ *
+ * @param pe Pointer to the PE
+ * @param cfg Pointer to the configuration
+ *
+ * @return unsigned Address of the memory, 0 if not enough host memory
+ */
+unsigned _sim_map(sim_pe_t *pe, const sim_cfg_t *cfg);
+
+/**
+ * @brief Loads a private copy of the kernel
+ *
+ * @details A library is only loaded once per path, so the kernel is copied
+ * to a temporary file for each PE.
+ *
+ * @param kernel Path of the kernel
+ *
+ * @return void* Library handle, NULL on failure
+ */
+void *_sim_load(const char *kernel);
+
+int sim_init(const sim_cfg_t *cfg)
+{
+	if (cfg->x_cnt == 0 || cfg->y_cnt == 0 || cfg->x_cnt > 0xFF || cfg->y_cnt > 0xFF)
+		return -EINVAL;
+
+	if (cfg->slots == 0 || cfg->page_size == 0 || (cfg->page_size & (cfg->page_size - 1)) != 0)
+		return -EINVAL;
+
+	_sim_x_cnt = cfg->x_cnt;
+	_sim_y_cnt = cfg->y_cnt;
+	_sim_time = 0;
+	_sim_halt = false;
+
+	_sim_pes = calloc(_sim_x_cnt*_sim_y_cnt, sizeof(sim_pe_t));
+	if (_sim_pes == NULL)
+		return -ENOMEM;
+
+	for (unsigned i = 0; i < sim_pe_cnt(); i++) {
+		sim_pe_t *pe = &_sim_pes[i];
+		unsigned x = i % _sim_x_cnt;
+		unsigned y = i / _sim_x_cnt;
+
+		pe->wr = -1;
+
+		SIM_REG(pe, MMR_DMNI_INF_ADDRESS)      = (x << 8) | y;
+		SIM_REG(pe, MMR_DMNI_INF_MANYCORE_SZ)  = (cfg->slots << 16) | (_sim_x_cnt << 8) | _sim_y_cnt;
+		SIM_REG(pe, MMR_DMNI_INF_IMEM_PAGE_SZ) = cfg->page_size;
+		SIM_REG(pe, MMR_DMNI_INF_DMEM_PAGE_SZ) = cfg->page_size;
+		SIM_REG(pe, MMR_RTC_MTIMECMP)          = UINT32_MAX;
+		SIM_REG(pe, MMR_RTC_MTIMECMPH)         = UINT32_MAX;
+
+		unsigned mem = _sim_map(pe, cfg);
+		if (mem == 0) {
+			sim_destroy();
+			return -ENOMEM;
+		}
+
+		pe->lib = _sim_load(cfg->kernel);
+		if (pe->lib == NULL) {
+			fprintf(stderr, "ERROR: could not load %s: %s\n", cfg->kernel, dlerror());
+			sim_destroy();
+			return -ENOENT;
+		}
+
+		void (*bind)(const mmr_host_t*) = dlsym(pe->lib, "mmr_host_bind");
+		int (*kmain)() = dlsym(pe->lib, "main");
+		pe->isr = dlsym(pe->lib, "isr_dispatcher");
+		if (bind == NULL || kmain == NULL || pe->isr == NULL) {
+			fprintf(stderr, "ERROR: %s is not a host kernel\n", cfg->kernel);
+			sim_destroy();
+			return -ENOENT;
+		}
+
+		mmr_host_t host = {
+			.pe  = pe,
+			.reg = _sim_reg,
+			.mti = _sim_mti,
+			.mem = mem
+		};
+		bind(&host);
+
+		kmain();
+		_sim_settle(pe);
+	}
+
+	return 0;
+}
+
+void sim_destroy()
+{
+	if (_sim_pes == NULL)
+		return;
+
+	for (unsigned i = 0; i < sim_pe_cnt(); i++) {
+		sim_pe_t *pe = &_sim_pes[i];
+
+		if (pe->lib != NULL)
+			dlclose(pe->lib);
+
+		if (pe->map != NULL)
+			munmap(pe->map, pe->map_size);
+
+		while (pe->rx != NULL) {
+			sim_pkt_t *next = pe->rx->next;
+			free(pe->rx);
+			pe->rx = next;
+		}
+
+		while (pe->br != NULL) {
+			sim_br_t *next = pe->br->next;
+			free(pe->br);
+			pe->br = next;
+		}
+	}
+
+	free(_sim_pes);
+	_sim_pes = NULL;
+}
+
+unsigned sim_pe_cnt()
+{
+	return _sim_x_cnt*_sim_y_cnt;
+}
+
+void *sim_sym(unsigned pe, const char *name)
+{
+	if (pe >= sim_pe_cnt())
+		return NULL;
+
+	return dlsym(_sim_pes[pe].lib, name);
+}
+
+int sim_inject(unsigned pe, const void *pkt, size_t size, uint64_t time)
+{
+	if (pe >= sim_pe_cnt() || size < sizeof(hermes_t) || (size & 3) != 0)
+		return -EINVAL;
+
+	sim_pkt_t *entry = malloc(sizeof(sim_pkt_t) + size);
+	if (entry == NULL)
+		return -ENOMEM;
+
+	memcpy(entry->data, pkt, size);
+	entry->time = (time > _sim_time) ? time : _sim_time;
+	entry->sent = entry->time;
+	entry->size = size;
+	entry->read = 0;
+
+	_sim_push_pkt(&_sim_pes[pe], entry);
+
+	return 0;
+}
+
+int sim_bcast(uint8_t ksvc, uint16_t payload, uint64_t time)
+{
+	return _sim_push_br(SIM_BR_EXTERNAL, ksvc, payload, (time > _sim_time) ? time : _sim_time);
+}
+
+void sim_set_io(void (*io)(unsigned src, const void *pkt, size_t size))
+{
+	_sim_io = io;
+}
+
+void sim_set_trace(void (*trace)(unsigned src, const uint32_t rec[4]))
+{
+	_sim_trace = trace;
+}
+
+uint64_t sim_run(uint64_t until)
+{
+	/* Kernel functions called directly may have left writes behind */
+	for (unsigned i = 0; i < sim_pe_cnt(); i++)
+		_sim_settle(&_sim_pes[i]);
+
+	while (!_sim_halt && _sim_time < until) {
+		bool dispatched = false;
+
+		for (unsigned i = 0; i < sim_pe_cnt() && !_sim_halt; i++) {
+			sim_pe_t *pe = &_sim_pes[i];
+
+			_sim_br_show(pe);
+
+			unsigned status = _sim_irq(pe);
+			if (status == 0)
+				continue;
+
+			_sim_time += SIM_IRQ_CYCLES;
+			pe->isr(status);
+			_sim_settle(pe);
+
+			if (pe->br_shown)
+				_sim_br_pop(pe);
+
+			/* The DMNI would hang on a packet left half read */
+			if (pe->rx != NULL && pe->rx->read != 0) {
+				fprintf(
+					stderr,
+					"WARN: PE %x left %zu bytes of a packet at %llu\n",
+					SIM_REG(pe, MMR_DMNI_INF_ADDRESS),
+					pe->rx->size - pe->rx->read,
+					(unsigned long long)_sim_time
+				);
+				sim_pkt_t *next = pe->rx->next;
+				free(pe->rx);
+				pe->rx = next;
+			}
+
+			dispatched = true;
+		}
+
+		if (dispatched)
+			continue;
+
+		uint64_t next = _sim_next_evt();
+		if (next == SIM_NEVER)
+			break;
+
+		_sim_time = (next < until) ? next : until;
+	}
+
+	return _sim_time;
+}
+
+uint64_t sim_get_time()
+{
+	return _sim_time;
+}
+
+uint64_t sim_pending(unsigned pe)
+{
+	/* Packets sent by kernel functions called directly */
+	for (unsigned i = 0; i < sim_pe_cnt(); i++)
+		_sim_settle(&_sim_pes[i]);
+
+	if (pe >= sim_pe_cnt() || _sim_pes[pe].rx == NULL)
+		return SIM_NEVER;
+
+	return _sim_pes[pe].rx->time;
+}
+
+bool sim_halted()
+{
+	return _sim_halt;
+}
+
+volatile unsigned *_sim_reg(void *arg, unsigned addr)
+{
+	sim_pe_t *pe = arg;
+
+	_sim_settle(pe);
+	_sim_time += SIM_MMR_CYCLES;
+
+	unsigned idx = _sim_idx(addr);
+
+	if (idx == _sim_idx(MMR_RTC_MTIME)) {
+		pe->regs[idx] = _sim_time & UINT32_MAX;
+	} else if (idx == _sim_idx(MMR_RTC_MTIMEH)) {
+		pe->regs[idx] = _sim_time >> 32;
+	} else if (idx == _sim_idx(MMR_DMNI_IRQ_IP)) {
+		pe->regs[idx] = _sim_dmni_ip(pe);
+	} else if (idx == _sim_idx(MMR_PLIC_IP)) {
+		pe->regs[idx] = (_sim_dmni_ip(pe) & SIM_REG(pe, MMR_DMNI_IRQ_IE)) ? (1 << PLIC_IE_DMNI) : 0;
+	} else if (idx == _sim_idx(MMR_DMNI_HERMES_HEAD)) {
+		pe->regs[idx] = (pe->rx != NULL && pe->rx->time <= _sim_time) ? *(uint32_t*)pe->rx->data : 0;
+	} else if (idx == _sim_idx(MMR_DMNI_HERMES_TIMESTAMP)) {
+		pe->regs[idx] = (pe->rx != NULL) ? pe->rx->sent : 0;
+	} else if (idx >= SIM_REG_DBG && idx < SIM_REG_SCRATCH) {
+		/* The debug registers are only written */
+		pe->wr = idx;
+	} else if (idx == SIM_REG_SCRATCH) {
+		fprintf(stderr, "WARN: access to unmapped register %x\n", addr);
+	}
+
+	return &(pe->regs[idx]);
+}
+
+void _sim_mti(void *arg, bool enable)
+{
+	sim_pe_t *pe = arg;
+	pe->mti = enable;
+}
+
+void _sim_settle(sim_pe_t *pe)
+{
+	uint32_t *status = &SIM_REG(pe, MMR_DMNI_IRQ_STATUS);
+
+	if (*status & (1 << DMNI_STATUS_SEND_START)) {
+		*status &= ~(1 << DMNI_STATUS_SEND_START);
+		_sim_send(pe);
+	}
+
+	if (*status & (1 << DMNI_STATUS_RECV_START)) {
+		*status &= ~(1 << DMNI_STATUS_RECV_START);
+		_sim_recv(pe);
+	}
+
+	/* No peripheral is attached */
+	*status &= ~(1 << DMNI_STATUS_REL_PERIPHERAL);
+
+	if (SIM_REG(pe, MMR_DMNI_BRLITE_KSVC) != pe->ksvc) {
+		_sim_br_send(pe);
+		SIM_REG(pe, MMR_DMNI_BRLITE_KSVC)    = pe->ksvc;
+		SIM_REG(pe, MMR_DMNI_BRLITE_PAYLOAD) = pe->payload;
+	}
+
+	if (pe->wr != -1) {
+		unsigned idx = pe->wr;
+		pe->wr = -1;
+		_sim_dbg(pe, idx);
+	}
+}
+
+void _sim_send(sim_pe_t *pe)
+{
+	size_t pkt_size = SIM_REG(pe, MMR_DMNI_HERMES_SIZE)*4;
+	size_t pld_size = SIM_REG(pe, MMR_DMNI_HERMES_SIZE_2)*4;
+
+	sim_pkt_t *pkt = malloc(sizeof(sim_pkt_t) + pkt_size + pld_size);
+	if (pkt == NULL) {
+		fprintf(stderr, "ERROR: no host memory for a packet\n");
+		return;
+	}
+
+	memcpy(pkt->data, (void*)SIM_REG(pe, MMR_DMNI_HERMES_ADDRESS), pkt_size);
+	if (pld_size != 0)
+		memcpy(pkt->data + pkt_size, (void*)SIM_REG(pe, MMR_DMNI_HERMES_ADDRESS_2), pld_size);
+
+	pkt->size = pkt_size + pld_size;
+	pkt->read = 0;
+	pkt->sent = _sim_time & UINT32_MAX;
+
+	unsigned src = pe - _sim_pes;
+	hermes_t *hermes = (hermes_t*)pkt->data;
+
+	if (hermes->flags != 0) {
+		/* Routed to a peripheral port */
+		if (_sim_io != NULL)
+			_sim_io(src, pkt->data, pkt->size);
+
+		free(pkt);
+		return;
+	}
+
+	unsigned x = hermes->address >> 8;
+	unsigned y = hermes->address & 0xFF;
+	if (x >= _sim_x_cnt || y >= _sim_y_cnt) {
+		fprintf(stderr, "ERROR: packet to invalid address %x\n", hermes->address);
+		free(pkt);
+		return;
+	}
+
+	unsigned src_x = src % _sim_x_cnt;
+	unsigned src_y = src / _sim_x_cnt;
+	unsigned hops = ((x > src_x) ? x - src_x : src_x - x) + ((y > src_y) ? y - src_y : src_y - y) + 1;
+
+	/* Wormhole: the header crosses the routers and the flits follow */
+	pkt->time = _sim_time + hops*SIM_HOP_CYCLES + pkt->size/4;
+
+	_sim_push_pkt(&_sim_pes[y*_sim_x_cnt + x], pkt);
+}
+
+void _sim_recv(sim_pe_t *pe)
+{
+	size_t size = SIM_REG(pe, MMR_DMNI_HERMES_SIZE)*4;
+	void *dst = (void*)SIM_REG(pe, MMR_DMNI_HERMES_ADDRESS);
+
+	size_t cnt = 0;
+	sim_pkt_t *pkt = pe->rx;
+	if (pkt != NULL && pkt->time <= _sim_time) {
+		cnt = pkt->size - pkt->read;
+		if (cnt > size)
+			cnt = size;
+
+		/* A NULL address drops the flits */
+		if (dst != NULL)
+			memcpy(dst, pkt->data + pkt->read, cnt);
+
+		pkt->read += cnt;
+		if (pkt->read == pkt->size) {
+			pe->rx = pkt->next;
+			free(pkt);
+		}
+	}
+
+	if (cnt != size) {
+		fprintf(
+			stderr,
+			"WARN: PE %x received %zu of %zu bytes\n",
+			SIM_REG(pe, MMR_DMNI_INF_ADDRESS),
+			cnt,
+			size
+		);
+	}
+
+	SIM_REG(pe, MMR_DMNI_HERMES_RECD_CNT) = cnt;
+
+	/* One flit per cycle */
+	_sim_time += cnt/4;
+}
+
+void _sim_br_send(sim_pe_t *pe)
+{
+	uint8_t ksvc = SIM_REG(pe, MMR_DMNI_BRLITE_KSVC) & 0xFF;
+	uint16_t payload = SIM_REG(pe, MMR_DMNI_BRLITE_PAYLOAD) & 0xFFFF;
+
+	if (_sim_push_br(pe - _sim_pes, ksvc, payload, _sim_time + SIM_BR_CYCLES) != 0)
+		fprintf(stderr, "ERROR: no host memory for a broadcast\n");
+}
+
+void _sim_dbg(sim_pe_t *pe, unsigned idx)
+{
+	uint32_t value = pe->regs[idx];
+
+	if (idx == _sim_idx(MMR_DBG_PUTC)) {
+		putchar(value);
+	} else if (idx == _sim_idx(MMR_DBG_HALT)) {
+		printf(
+			"PE %x halted at %llu\n",
+			SIM_REG(pe, MMR_DMNI_INF_ADDRESS),
+			(unsigned long long)_sim_time
+		);
+		_sim_halt = true;
+	} else if (idx == _sim_idx(MMR_DBG_TRACE)) {
+		/* A record is written as 4 consecutive words, see trace.h */
+		pe->trace[pe->trace_cnt++] = value;
+		if (pe->trace_cnt == 4) {
+			pe->trace_cnt = 0;
+			if (_sim_trace != NULL)
+				_sim_trace(pe - _sim_pes, pe->trace);
+		}
+	}
+
+	/* The other reports to the debugger are not kept */
+}
+
+uint32_t _sim_dmni_ip(sim_pe_t *pe)
+{
+	uint32_t ip = 0;
+
+	/* A packet raises the interrupt until its header is read */
+	if (pe->rx != NULL && pe->rx->time <= _sim_time && pe->rx->read == 0)
+		ip |= (1 << DMNI_IP_HERMES);
+
+	if (pe->br_shown)
+		ip |= (1 << DMNI_IP_BRLITE);
+
+	return ip;
+}
+
+unsigned _sim_irq(sim_pe_t *pe)
+{
+	unsigned status = 0;
+
+	bool dmni = (_sim_dmni_ip(pe) & SIM_REG(pe, MMR_DMNI_IRQ_IE)) != 0;
+	if (dmni && (SIM_REG(pe, MMR_PLIC_IE) & (1 << PLIC_IE_DMNI)))
+		status |= (1 << RISCV_IRQ_MEI);
+
+	uint64_t cmp = (((uint64_t)SIM_REG(pe, MMR_RTC_MTIMECMPH)) << 32) | SIM_REG(pe, MMR_RTC_MTIMECMP);
+	if (pe->mti && _sim_time >= cmp)
+		status |= (1 << RISCV_IRQ_MTI);
+
+	return status;
+}
+
+void _sim_br_show(sim_pe_t *pe)
+{
+	if (pe->br_shown || pe->br == NULL || pe->br->time > _sim_time)
+		return;
+
+	pe->br_shown = true;
+	pe->ksvc     = pe->br->ksvc | SIM_BR_SHOWN;
+	pe->payload  = pe->br->payload;
+
+	SIM_REG(pe, MMR_DMNI_BRLITE_KSVC)    = pe->ksvc;
+	SIM_REG(pe, MMR_DMNI_BRLITE_PAYLOAD) = pe->payload;
+}
+
+void _sim_br_pop(sim_pe_t *pe)
+{
+	sim_br_t *br = pe->br;
+	pe->br = br->next;
+	free(br);
+
+	pe->br_shown = false;
+	pe->ksvc     = 0;
+	pe->payload  = 0;
+
+	SIM_REG(pe, MMR_DMNI_BRLITE_KSVC)    = 0;
+	SIM_REG(pe, MMR_DMNI_BRLITE_PAYLOAD) = 0;
+}
+
+void _sim_push_pkt(sim_pe_t *pe, sim_pkt_t *pkt)
+{
+	/* Never ahead of a packet already being received */
+	sim_pkt_t **pos = &(pe->rx);
+	while (*pos != NULL && ((*pos)->time <= pkt->time || (*pos)->read != 0))
+		pos = &((*pos)->next);
+
+	pkt->next = *pos;
+	*pos = pkt;
+}
+
+int _sim_push_br(unsigned src, uint8_t ksvc, uint16_t payload, uint64_t time)
+{
+	for (unsigned i = 0; i < sim_pe_cnt(); i++) {
+		if (i == src)
+			continue;
+
+		sim_br_t *br = malloc(sizeof(sim_br_t));
+		if (br == NULL)
+			return -ENOMEM;
+
+		br->time    = time;
+		br->ksvc    = ksvc;
+		br->payload = (src << 16) | payload;
+		br->next    = NULL;
+
+		/* The BrLite delivers in order */
+		sim_br_t **pos = &(_sim_pes[i].br);
+		while (*pos != NULL)
+			pos = &((*pos)->next);
+
+		*pos = br;
+	}
+
+	return 0;
+}
+
+uint64_t _sim_next_evt()
+{
+	uint64_t next = SIM_NEVER;
+
+	for (unsigned i = 0; i < sim_pe_cnt(); i++) {
+		sim_pe_t *pe = &_sim_pes[i];
+
+		if (pe->rx != NULL && pe->rx->time > _sim_time && pe->rx->time < next)
+			next = pe->rx->time;
+
+		if (pe->br != NULL && pe->br->time > _sim_time && pe->br->time < next)
+			next = pe->br->time;
+
+		uint64_t cmp = (((uint64_t)SIM_REG(pe, MMR_RTC_MTIMECMPH)) << 32) | SIM_REG(pe, MMR_RTC_MTIMECMP);
+		if (pe->mti && cmp > _sim_time && cmp < next)
+			next = cmp;
+	}
+
+	return next;
+}
+
+unsigned _sim_map(sim_pe_t *pe, const sim_cfg_t *cfg)
+{
+	size_t span = cfg->page_size*(cfg->slots + 1);
+	if (span > MMR_DATA_BASE)
+		return 0;
+
+	/* The kernel also composes data addresses by OR-ing MMR_DATA_BASE */
+	size_t align = MMR_DATA_BASE << 1;
+	while (align < span)
+		align <<= 1;
+
+	/* Task bank, then the data bank at MMR_DATA_BASE */
+	pe->map_size = MMR_DATA_BASE + span + align;
+	pe->map = mmap(NULL, pe->map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (pe->map == MAP_FAILED) {
+		pe->map = NULL;
+		return 0;
+	}
+
+	return ((unsigned)pe->map + align - 1) & ~(align - 1);
+}
+
+void *_sim_load(const char *kernel)
+{
+	int src = open(kernel, O_RDONLY);
+	if (src < 0)
+		return NULL;
+
+	char path[] = "/tmp/maestro-peXXXXXX";
+	int dst = mkstemp(path);
+	if (dst < 0) {
+		close(src);
+		return NULL;
+	}
+
+	char buf[4096];
+	ssize_t len;
+	while ((len = read(src, buf, sizeof(buf))) > 0) {
+		if (write(dst, buf, len) != len) {
+			len = -1;
+			break;
+		}
+	}
+
+	close(src);
+	close(dst);
+
+	void *lib = (len == 0) ? dlopen(path, RTLD_NOW | RTLD_LOCAL) : NULL;
+	unlink(path);
+
+	return lib;
+}
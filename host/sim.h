@@ -0,0 +1,173 @@
+/**
+ * MAestro
+ * @file sim.h
+ *
+ * @author Angelo Elias Dalzotto (angelo.dalzotto@edu.pucrs.br)
+ * GAPH - Hardware Design Support Group (https://corfu.pucrs.br/)
+ * PUCRS - Pontifical Catholic University of Rio Grande do Sul (http://pucrs.br/)
+ *
+ * @date October 2026
+ *
+ * @brief Deterministic many-core simulation of the kernel on the host.
+ *
+ * @details Each PE runs its own copy of the host kernel against a model of
+ * the RTC, PLIC, DMNI and BrLite registers. Time is counted in cycles of a
+ * single clock shared by the PEs: register accesses and transfers advance it,
+ * and the PEs are served in address order, so a run is reproducible.
+ * Transfers complete instantly from the kernel point of view, and the tasks
+ * are not executed: the kernel entry points are reached through interrupts
+ * and by calling the kernel symbols directly.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifndef SIM_MMR_CYCLES
+	#define SIM_MMR_CYCLES 1	//!< Cycles of a register access
+#endif
+
+#ifndef SIM_IRQ_CYCLES
+	#define SIM_IRQ_CYCLES 40	//!< Cycles of the HAL to enter and leave an interrupt
+#endif
+
+#ifndef SIM_HOP_CYCLES
+	#define SIM_HOP_CYCLES 4	//!< Cycles for a packet to cross a router
+#endif
+
+#ifndef SIM_BR_CYCLES
+	#define SIM_BR_CYCLES 64	//!< Cycles for a broadcast to reach the PEs
+#endif
+
+/**
+ * @brief Simulated many-core
+ */
+typedef struct _sim_cfg {
+	const char *kernel;	//!< Path of the host kernel shared object
+	unsigned x_cnt;		//!< PEs in the X axis
+	unsigned y_cnt;		//!< PEs in the Y axis
+	unsigned slots;		//!< Task slots per PE
+	unsigned page_size;	//!< Memory of each task slot in bytes
+} sim_cfg_t;
+
+/**
+ * @brief Loads and boots the kernel of every PE
+ *
+ * @param cfg Pointer to the configuration
+ *
+ * @return int
+ *  0 success
+ * -EINVAL: invalid configuration
+ * -ENOMEM: not enough host memory
+ * -ENOENT: kernel could not be loaded
+ */
+int sim_init(const sim_cfg_t *cfg);
+
+/**
+ * @brief Unloads the kernels and frees the simulation
+ */
+void sim_destroy();
+
+/**
+ * @brief Gets the number of PEs
+ *
+ * @return unsigned Number of PEs
+ */
+unsigned sim_pe_cnt();
+
+/**
+ * @brief Gets a symbol of the kernel of a PE
+ *
+ * @details Kernel functions called directly run against the PE registers
+ *
+ * @param pe Sequential PE address
+ * @param name Name of the symbol
+ *
+ * @return void* Pointer to the symbol, NULL if not found
+ */
+void *sim_sym(unsigned pe, const char *name);
+
+/**
+ * @brief Injects a Hermes packet from outside the many-core
+ *
+ * @param pe Sequential address of the target PE
+ * @param pkt Pointer to the packet, header included (copied)
+ * @param size Size of the packet in bytes, multiple of 4
+ * @param time Arrival time in cycles, the current time if in the past
+ *
+ * @return int
+ *  0 success
+ * -EINVAL: invalid PE or size
+ * -ENOMEM: not enough host memory
+ */
+int sim_inject(unsigned pe, const void *pkt, size_t size, uint64_t time);
+
+/**
+ * @brief Broadcasts a BrLite message from outside the many-core
+ *
+ * @param ksvc Kernel service
+ * @param payload Payload
+ * @param time Arrival time in cycles, the current time if in the past
+ *
+ * @return int
+ *  0 success
+ * -ENOMEM: not enough host memory
+ */
+int sim_bcast(uint8_t ksvc, uint16_t payload, uint64_t time);
+
+/**
+ * @brief Sets the handler of packets sent to peripherals
+ *
+ * @param io Handler, NULL discards the packets
+ */
+void sim_set_io(void (*io)(unsigned src, const void *pkt, size_t size));
+
+/**
+ * @brief Sets the handler of the trace records drained by the kernels
+ *
+ * @details Records are only written by kernels built with TRACE_ENABLE, as
+ * the host kernel is.
+ *
+ * @param trace Handler of each record {time, (task << 16) | event, arg0, arg1},
+ * NULL discards the records
+ */
+void sim_set_trace(void (*trace)(unsigned src, const uint32_t rec[4]));
+
+/**
+ * @brief Runs the simulation
+ *
+ * @details Stops when a PE halts, when the deadline is reached or when there
+ * are no more events. Events at the deadline are left to the next run.
+ *
+ * @param until Deadline in cycles
+ *
+ * @return uint64_t Time at the end of the run
+ */
+uint64_t sim_run(uint64_t until);
+
+/**
+ * @brief Gets the simulation time
+ *
+ * @return uint64_t Time in cycles
+ */
+uint64_t sim_get_time();
+
+/**
+ * @brief Gets the arrival time of the next packet to a PE
+ *
+ * @details Packets sent by kernel functions called directly are counted
+ *
+ * @param pe Sequential PE address
+ *
+ * @return uint64_t Arrival time in cycles, UINT64_MAX if none
+ */
+uint64_t sim_pending(unsigned pe);
+
+/**
+ * @brief Checks if a PE halted the simulation
+ *
+ * @return True if halted
+ */
+bool sim_halted();
@@ -96,7 +96,7 @@ int app_get_address(app_t *app, int task)
 
 void app_update(app_t *app, int task, int addr)
 {
-	if(app->task_location != NULL)
+	if(app->task_location != NULL && (task & 0x00FF) < app->task_cnt)
 		app->task_location[task & 0x00FF] = addr;
 }
 
@@ -19,69 +19,268 @@
 
 #include <mmr.h>
 #include <hermes.h>
+#include <pool.h>
+#include <timer.h>
+#include <perf.h>
+#include <trace.h>
 
 static const size_t FLIT_SIZE = 4;
+static const uint64_t DMNI_DRAIN_MIN = 100;	//!< Minimum time between checks of a busy DMNI, in clock cycles
+
+dmni_out_t _dmni_queue[DMNI_SEND_QUEUE_SZ];	//!< Packets waiting for the DMNI, oldest at head
+unsigned _dmni_head = 0;
+unsigned _dmni_cnt = 0;
+dmni_out_t _dmni_sending = { .pkt = NULL };	//!< Packet programmed in the DMNI, released when it leaves
+timer_evt_t _dmni_evt;						//!< Checks the DMNI back while packets wait or one must be released
+bool _dmni_recv_bg = false;					//!< A receive started by dmni_recv_async may still be active
+
+/**
+ * @brief Checks if the DMNI is sending a packet
+ * 
+ * @return True if sending
+ */
+bool _dmni_send_active();
+
+/**
+ * @brief Checks if the packet in the DMNI must be released when it leaves
+ * 
+ * @details Its buffers are freed or its callback is called by _dmni_release
+ * 
+ * @return True if something waits for the packet to leave
+ */
+bool _dmni_release_pndg();
+
+/**
+ * @brief Busy-waits while a DMNI status bit is set
+ * 
+ * @details The cycles waited are accounted in the performance counters
+ * 
+ * @param status DMNI status bit
+ */
+void _dmni_wait(unsigned status);
+
+/**
+ * @brief Frees the memory of the packet that left the DMNI
+ */
+void _dmni_release();
+
+/**
+ * @brief Programs the DMNI to send a packet
+ * 
+ * @param out Pointer to the outbound packet
+ */
+void _dmni_program(dmni_out_t *out);
+
+/**
+ * @brief Drains the send queue when its timer event expires
+ * 
+ * @param arg Unused
+ */
+void _dmni_drain_evt(void *arg);
 
 size_t dmni_recv(void *dst, size_t size)
 {
 	if (size % FLIT_SIZE != 0)
 		return -EINVAL;
+
+	dmni_recv_wait();
 	
 	MMR_DMNI_HERMES_SIZE    = size/FLIT_SIZE;
 	MMR_DMNI_HERMES_ADDRESS = (unsigned)dst;
 
 	MMR_DMNI_IRQ_STATUS |= (1 << DMNI_STATUS_RECV_START);
-	while((MMR_DMNI_IRQ_STATUS & (1 << DMNI_STATUS_RECV_ACTIVE)));
+	_dmni_wait(DMNI_STATUS_RECV_ACTIVE);
 	return MMR_DMNI_HERMES_RECD_CNT;
 }
 
+int dmni_recv_async(void *dst, size_t size)
+{
+	if (size % FLIT_SIZE != 0)
+		return -EINVAL;
+
+	dmni_recv_wait();
+
+	MMR_DMNI_HERMES_SIZE    = size/FLIT_SIZE;
+	MMR_DMNI_HERMES_ADDRESS = (unsigned)dst;
+
+	MMR_DMNI_IRQ_STATUS |= (1 << DMNI_STATUS_RECV_START);
+	_dmni_recv_bg = true;
+
+	return 0;
+}
+
+void dmni_recv_wait()
+{
+	if (!_dmni_recv_bg)
+		return;
+
+	_dmni_wait(DMNI_STATUS_RECV_ACTIVE);
+	_dmni_recv_bg = false;
+}
+
+void dmni_init()
+{
+	timer_evt_init(&_dmni_evt, _dmni_drain_evt, NULL);
+}
+
 int dmni_send(void *pkt, size_t pkt_size, bool pkt_free, void *pld, size_t pld_size, bool pld_free)
 {
-	static bool free_last_pkt = false;
-	static void *outbound_pkt = NULL;
+	return dmni_send_stamped(pkt, pkt_size, pkt_free, pld, pld_size, pld_free, NULL);
+}
 
-	static bool free_last_pld = false;
-	static void *outbound_pld = NULL;
+int dmni_send_stamped(void *pkt, size_t pkt_size, bool pkt_free, void *pld, size_t pld_size, bool pld_free, uint32_t *stamp)
+{
+	dmni_out_t out = {
+		.pkt      = pkt,
+		.pld      = pld,
+		.stamp    = stamp,
+		.pkt_size = pkt_size,
+		.pld_size = pld_size,
+		.sent     = NULL,
+		.arg      = NULL,
+		.pkt_free = pkt_free,
+		.pld_free = pld_free
+	};
 
-	if ((((hermes_t*)pkt)->address == MMR_DMNI_INF_ADDRESS) && (((hermes_t*)pkt)->flags == 0)) {
-		printf("ERROR: Will not send to itself\n");
+	return dmni_send_out(&out);
+}
+
+int dmni_send_out(const dmni_out_t *out)
+{
+	if ((((hermes_t*)out->pkt)->address == MMR_DMNI_INF_ADDRESS) && (((hermes_t*)out->pkt)->flags == 0)) {
+		kerror("ERROR: Will not send to itself\n");
 		return -EINVAL;
 	}
 
-	if (pkt_size % FLIT_SIZE != 0 || pld_size % FLIT_SIZE != 0)
+	if (out->pkt_size % FLIT_SIZE != 0 || out->pld_size % FLIT_SIZE != 0)
 		return -EINVAL;
 
-	/* Wait for DMNI to be released */
-	while((MMR_DMNI_IRQ_STATUS & (1 << DMNI_STATUS_SEND_ACTIVE)));
+	if (_dmni_cnt == DMNI_SEND_QUEUE_SZ) {
+		/* Queue full: wait for the DMNI to take the oldest packet */
+		_dmni_wait(DMNI_STATUS_SEND_ACTIVE);
+		dmni_drain();
+	}
+
+	_dmni_queue[(_dmni_head + _dmni_cnt) % DMNI_SEND_QUEUE_SZ] = *out;
+	_dmni_cnt++;
+
+	dmni_drain();
+
+	return 0;
+}
+
+void dmni_drain()
+{
+	/* The last packet left the DMNI. Its callback may have started another one */
+	if (!_dmni_send_active())
+		_dmni_release();
+
+	if (_dmni_send_active() || _dmni_sending.pkt != NULL) {
+		/* Check back later if there is something waiting, even on an idle PE */
+		if ((_dmni_cnt != 0 || _dmni_release_pndg()) && !timer_is_set(&_dmni_evt))
+			timer_set(&_dmni_evt, timer_get_time() + DMNI_DRAIN_MIN);
+
+		return;
+	}
+
+	if (_dmni_cnt == 0) {
+		timer_cancel(&_dmni_evt);
+		return;
+	}
+
+	_dmni_sending = _dmni_queue[_dmni_head];
+	_dmni_head = (_dmni_head + 1) % DMNI_SEND_QUEUE_SZ;
+	_dmni_cnt--;
+
+	_dmni_program(&_dmni_sending);
+
+	if (_dmni_cnt == 0 && !_dmni_release_pndg()) {
+		timer_cancel(&_dmni_evt);
+		return;
+	}
+
+	/* The DMNI sends about one flit per cycle */
+	uint64_t flits = (_dmni_sending.pkt_size + _dmni_sending.pld_size) / FLIT_SIZE;
+	timer_set(&_dmni_evt, timer_get_time() + ((flits > DMNI_DRAIN_MIN) ? flits : DMNI_DRAIN_MIN));
+}
+
+void dmni_flush()
+{
+	while (_dmni_cnt != 0) {
+		_dmni_wait(DMNI_STATUS_SEND_ACTIVE);
+		dmni_drain();
+	}
+
+	_dmni_wait(DMNI_STATUS_SEND_ACTIVE);
+	_dmni_release();
+}
+
+bool _dmni_send_active()
+{
+	return (MMR_DMNI_IRQ_STATUS & (1 << DMNI_STATUS_SEND_ACTIVE));
+}
+
+bool _dmni_release_pndg()
+{
+	if (_dmni_sending.pkt == NULL)
+		return false;
+
+	return (_dmni_sending.sent != NULL || _dmni_sending.pkt_free || _dmni_sending.pld_free);
+}
+
+void _dmni_wait(unsigned status)
+{
+	if (!(MMR_DMNI_IRQ_STATUS & (1 << status)))
+		return;
+
+	uint64_t start = perf_cycles();
+	while (MMR_DMNI_IRQ_STATUS & (1 << status));
+	perf_dmni_wait(perf_cycles() - start);
+}
+
+void _dmni_release()
+{
+	if (_dmni_sending.pkt == NULL)
+		return;
+
+	if (_dmni_sending.pkt_free)
+		pool_free(_dmni_sending.pkt);
 
-	/* Memory management */
-	if (free_last_pkt)
-		free(outbound_pkt);
+	if (_dmni_sending.pld_free)
+		pool_free(_dmni_sending.pld);
 
-	if (free_last_pld)
-		free(outbound_pld);
+	_dmni_sending.pkt = NULL;
 
-	free_last_pkt = pkt_free;
-	outbound_pkt  = pkt;
+	if (_dmni_sending.sent != NULL)
+		_dmni_sending.sent(_dmni_sending.arg);
+}
 
-	free_last_pld = pld_free;
-	outbound_pld  = pld;
+void _dmni_program(dmni_out_t *out)
+{
+	if (out->stamp != NULL) {
+		/* Packets carry the lower 32 bits, latencies are computed wrap-safe */
+		*(out->stamp) = timer_get_time();
+	}
 
-	/* Program DMNI */
-	MMR_DMNI_HERMES_SIZE      = pkt_size/FLIT_SIZE;
-	MMR_DMNI_HERMES_ADDRESS   = (unsigned)pkt;
+	MMR_DMNI_HERMES_SIZE      = out->pkt_size/FLIT_SIZE;
+	MMR_DMNI_HERMES_ADDRESS   = (unsigned)out->pkt;
 
-	MMR_DMNI_HERMES_SIZE_2    = pld_size/FLIT_SIZE;
-	MMR_DMNI_HERMES_ADDRESS_2 = (unsigned)pld;
+	MMR_DMNI_HERMES_SIZE_2    = out->pld_size/FLIT_SIZE;
+	MMR_DMNI_HERMES_ADDRESS_2 = (unsigned)out->pld;
 
 	MMR_DMNI_IRQ_STATUS |= (1 << DMNI_STATUS_SEND_START);
+}
 
-	return 0;
+void _dmni_drain_evt(void *arg)
+{
+	dmni_drain();
 }
 
 void dmni_drop_payload(unsigned payload_size)
 {
 	// printf("Dropping payload - Size = %u\n", payload_size);
+	dmni_recv_wait();
+
 	MMR_DMNI_HERMES_SIZE    = payload_size;
 	MMR_DMNI_HERMES_ADDRESS = (unsigned)NULL;
 	
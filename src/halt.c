@@ -23,6 +23,7 @@
 #include <mmr.h>
 #include <kernel_pipe.h>
 #include <mpipe.h>
+#include <pool.h>
 
 #include <memphis/services.h>
 #include <memphis/messaging.h>
@@ -43,7 +44,7 @@ int halt_try()
 	}
 
 	/* Check if there are migrated tasks in the list and halt later */
-	if (!(tm_empty() && msg_pndg_empty()))
+	if (!tm_empty())
 		return -EAGAIN;
 	
 	/* Inform the mapper that this PE is ready to halt */
@@ -62,7 +63,7 @@ int halt_try()
 
 int halt_set(int task, int addr)
 {
-	_halter = malloc(sizeof(tl_t));
+	_halter = pool_alloc(sizeof(tl_t));
 	if (_halter == NULL)
 		return -ENOMEM;
 
@@ -72,6 +73,6 @@ int halt_set(int task, int addr)
 
 void halt_clear()
 {
-    free(_halter);
+    pool_free(_halter);
     _halter = NULL;
 }
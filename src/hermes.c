@@ -21,6 +21,8 @@
 #include <dmni.h>
 #include <task_allocation.h>
 #include <task_migration.h>
+#include <pool.h>
+#include <trace.h>
 
 #include <memphis/services.h>
 
@@ -61,7 +63,7 @@ void *hermes_recv_pkt(uint8_t service)
             expected = sizeof(tm_tcb_t);
             break;
         default:
-            printf("ERROR: unknown hermes service %x\n", service);
+            kerror("ERROR: unknown hermes service %x\n", service);
             break;
     }
     
@@ -70,7 +72,7 @@ void *hermes_recv_pkt(uint8_t service)
 
     // printf("Expected: %d\n", expected);
 
-    void *packet = malloc(expected);
+    void *packet = pool_alloc(expected);
     if (packet == NULL)
         return NULL;
 
@@ -79,7 +81,7 @@ void *hermes_recv_pkt(uint8_t service)
     // printf("Received: %d\n", received);
 
     if (received != expected) {
-        free(packet);
+        pool_free(packet);
         return NULL;
     }
 
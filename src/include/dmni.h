@@ -15,6 +15,31 @@
 
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
+
+#ifndef DMNI_SEND_QUEUE_SZ
+	#define DMNI_SEND_QUEUE_SZ 16	//!< Outbound packets waiting for the DMNI
+#endif
+
+/**
+ * @brief Outbound packet waiting for the DMNI
+ */
+typedef struct _dmni_out {
+	void *pkt;			//!< Packet (header) to send
+	void *pld;			//!< Payload to send, NULL if none
+	uint32_t *stamp;	//!< Word set to the send time when the DMNI is programmed, NULL if none
+	size_t pkt_size;	//!< Packet size in bytes
+	size_t pld_size;	//!< Payload size in bytes
+	void (*sent)(void *arg);	//!< Called when the packet leaves the DMNI, NULL if none
+	void *arg;			//!< Argument passed to sent
+	bool pkt_free;		//!< Free the packet after sent
+	bool pld_free;		//!< Free the payload after sent
+} dmni_out_t;
+
+/**
+ * @brief Initializes the DMNI send queue
+ */
+void dmni_init();
 
 /**
  * @brief Receive data from NoC and copy to memory.
@@ -27,9 +52,35 @@
  */
 size_t dmni_recv(void *dst, size_t size);
 
+/**
+ * @brief Starts receiving data from NoC without waiting for it to land
+ * 
+ * @details The next packet cannot reach the DMNI before this payload is
+ * received, so anything that arrives later is processed after the copy.
+ * Other receives wait for it to finish.
+ * 
+ * @param dst Address where the payload will be saved
+ * @param size Number of bytes to copy. Must be multiple of flit size.
+ * 
+ * @return int
+ *  0 success
+ * -EINVAL case size is not multiple of flit size.
+ */
+int dmni_recv_async(void *dst, size_t size);
+
+/**
+ * @brief Waits for the receive started by dmni_recv_async
+ */
+void dmni_recv_wait();
+
 /**
  * @brief Abstracts the DMNI programming for writing data to NoC and copy from memory.
  * 
+ * @details The packet is queued and the function returns at once. The queue
+ * is drained in order at every kernel entry and by a timer event while
+ * packets are waiting, so the packet and payload must stay valid until sent.
+ * If the queue is full, waits for the DMNI to start the oldest packet.
+ * 
  * @param pkt Pointer to the packet to send
  * @param pkt_size Size of the packet to send (in bytes)
  * @param pkt_free True if should free the packet after the message is sent
@@ -43,6 +94,54 @@ size_t dmni_recv(void *dst, size_t size);
  */
 int dmni_send(void *pkt, size_t pkt_size, bool pkt_free, void *pld, size_t pld_size, bool pld_free);
 
+/**
+ * @brief Queues a packet that carries its send time
+ * 
+ * @details Same as dmni_send, but the time the DMNI starts the packet is
+ * written to the stamp word, so the queue wait is not accounted as NoC latency.
+ * 
+ * @param pkt Pointer to the packet to send
+ * @param pkt_size Size of the packet to send (in bytes)
+ * @param pkt_free True if should free the packet after the message is sent
+ * @param pld Pointer to the payload to send, NULL if none
+ * @param pld_size Size of the payload to send in bytes, 0 if none
+ * @param pld_free True if should free the payload after the message is sent
+ * @param stamp Pointer to the word inside the packet to receive the time
+ * 
+ * @return int
+ *  0 on success
+ * -EINVAL if either pkt_size of pld_size not multiple of flit size.
+ */
+int dmni_send_stamped(void *pkt, size_t pkt_size, bool pkt_free, void *pld, size_t pld_size, bool pld_free, uint32_t *stamp);
+
+/**
+ * @brief Queues an outbound packet
+ * 
+ * @details The structure is copied, so it can be discarded after the call.
+ * The sent callback runs from the first queue drain after the packet leaves,
+ * which may be inside another send, so it must only touch state that nothing
+ * else references. It runs after the packet memory is freed.
+ * 
+ * @param out Pointer to the outbound packet description
+ * 
+ * @return int
+ *  0 on success
+ * -EINVAL if either pkt_size of pld_size not multiple of flit size.
+ */
+int dmni_send_out(const dmni_out_t *out);
+
+/**
+ * @brief Starts the next queued packet if the DMNI is free
+ */
+void dmni_drain();
+
+/**
+ * @brief Waits until all queued packets are sent
+ * 
+ * @details Used before releasing memory that a queued payload may point to
+ */
+void dmni_flush();
+
 /**
  * @brief Requests the DMNI to drop flits from a message payload.
  * 
@@ -54,7 +54,7 @@ bool llm_has_monitor(int mon_id);
  * @return true If monitored, updating last_monitored
  * @return false If should wait more time to monitor
  */
-void llm_rt(unsigned *last_monitored, int id, unsigned slack_time, unsigned remaining_exec_time);
+void llm_rt(uint64_t *last_monitored, int id, unsigned slack_time, unsigned remaining_exec_time);
 
 /**
  * @bried Monitor security contraints
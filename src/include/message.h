@@ -14,6 +14,7 @@
 #pragma once
 
 #include <hermes.h>
+#include <task_control.h>
 
 #include <mutils/list.h>
 
@@ -54,33 +55,88 @@ typedef struct _msg_dlv {
 } msg_dlv_t;
 
 /**
- * @brief Initializes the pending handshakes FIFO
+ * @brief Initializes the borrowed pipes list
  */
-void msg_pndg_init();
+void msg_init();
 
 /**
- * @brief Adds a handshake to pending messages
+ * @brief Lends a message in the producer page to a local consumer
  * 
- * @param hdshk Pointer to service packet
- *
- * @return list_entry_t* Pointer to entry
+ * @details The output pipe points to the producer buffer, so the message is
+ * copied only once, straight to the consumer page. The caller must block the
+ * producer until the message is consumed or materialized.
+ * 
+ * @param send_tcb Pointer to the producer TCB
+ * @param buf Pointer to the message (kernel address)
+ * @param size Size of the message
+ * @param receiver Consumer task ID
+ * 
+ * @return int
+ *  Number of bytes lent on success
+ * -ENOMEM: impossible to allocate memory
+ */
+int msg_borrow(tcb_t *send_tcb, void *buf, size_t size, int receiver);
+
+/**
+ * @brief Copies a lent message to kernel memory and releases its producer
+ * 
+ * @param send_tcb Pointer to the producer TCB
+ * 
+ * @return int
+ *  0 success (or nothing lent)
+ * -ENOMEM: impossible to allocate memory
+ */
+int msg_materialize(tcb_t *send_tcb);
+
+/**
+ * @brief Materializes all messages lent to a consumer
+ * 
+ * @details Called when the consumer blocks or leaves the PE, so no producer
+ * stays blocked on a consumer that is not reading.
+ * 
+ * @param receiver Consumer task ID
  */
-list_entry_t *msg_pndg_push_back(msg_hdshk_t *hdshk);
+void msg_materialize_to(int receiver);
 
 /**
- * @brief Removes the first element from the FIFO
+ * @brief Drops every lent message involving a task being removed
  * 
- * @return void* Pointer to packet
+ * @param tcb Pointer to the TCB being removed
  */
-msg_hdshk_t *msg_pndg_pop_front();
+void msg_borrow_clear(tcb_t *tcb);
 
 /**
- * @brief Checks if there are no more pending services
+ * @brief Releases an output pipe of a local producer after its message is consumed
+ * 
+ * @details Frees the pipe and releases the producer if it is blocked on it
+ * 
+ * @param send_tcb Pointer to the producer TCB
+ * @param opipe Pointer to the consumed pipe
+ */
+void msg_opipe_consumed(tcb_t *send_tcb, opipe_t *opipe);
+
+/**
+ * @brief Posts MESSAGE_REQUESTs for the pending remote DATA_AVs of a consumer
+ * 
+ * @details Requests are posted in DATA_AV order while the consumer inbound
+ * ring has free slots. Nothing is posted while the consumer waits to migrate.
+ * 
+ * @param recv_tcb Pointer to the consumer TCB
+ * 
+ * @return int
+ *  0 success
+ * -ENOMEM when unable to create outbound packet
+ */
+int msg_rxring_fill(tcb_t *recv_tcb);
+
+/**
+ * @brief Checks if a task has no message in flight to or held by its inbound ring
+ * 
+ * @param tcb Pointer to the TCB
  * 
- * @return true No more pending services
- * @return false Has pending services
+ * @return True if idle or without ring
  */
-bool msg_pndg_empty();
+bool msg_rxring_idle(tcb_t *tcb);
 
 /**
  * @brief Receives a DATA_AV
@@ -13,62 +13,75 @@
 
 #pragma once
 
+/* The host simulator defines MMR_REG to get the register addresses */
+#if defined(MAESTRO_HOST)
+	#include <mmr_host.h>
+
+	#define MMR_REG(addr)	(*mmr_host_reg(addr))	//!< Register of the simulated PE
+	#define MMR_MEM_BASE	mmr_host_mem()			//!< Host buffer holding the PE memory
+#elif !defined(MMR_REG)
+	#define MMR_REG(addr)	(*(volatile unsigned int*)(addr))
+	#define MMR_MEM_BASE	0x00000000U				//!< Physical address of the PE memory
+#endif
+
 /* RTC MMR */
-#define MMR_RTC_MTIME				(*(volatile unsigned int*)0x02000000U)
-#define MMR_RTC_MTIMEH				(*(volatile unsigned int*)0x02000004U)
-#define MMR_RTC_MTIMECMP			(*(volatile unsigned int*)0x02000008U)
-#define MMR_RTC_MTIMECMPH			(*(volatile unsigned int*)0x0200000CU)
+#define MMR_RTC_MTIME				MMR_REG(0x02000000U)
+#define MMR_RTC_MTIMEH				MMR_REG(0x02000004U)
+#define MMR_RTC_MTIMECMP			MMR_REG(0x02000008U)
+#define MMR_RTC_MTIMECMPH			MMR_REG(0x0200000CU)
 
 /* PLIC MMR */
-#define MMR_PLIC_IP					(*(volatile unsigned int*)0x04001000U)
-#define MMR_PLIC_IE					(*(volatile unsigned int*)0x04002000U)
-#define MMR_PLIC_ID					(*(volatile unsigned int*)0x04200004U)
+#define MMR_PLIC_IP					MMR_REG(0x04001000U)
+#define MMR_PLIC_IE					MMR_REG(0x04002000U)
+#define MMR_PLIC_ID					MMR_REG(0x04200004U)
 
 /* DMNI MMR */
-#define MMR_DMNI_IRQ_STATUS			(*(volatile unsigned int*)0x08000000U)
-#define MMR_DMNI_IRQ_IE				(*(volatile unsigned int*)0x08000004U)
-#define MMR_DMNI_IRQ_IP				(*(volatile unsigned int*)0x08000008U)
+#define MMR_DMNI_IRQ_STATUS			MMR_REG(0x08000000U)
+#define MMR_DMNI_IRQ_IE				MMR_REG(0x08000004U)
+#define MMR_DMNI_IRQ_IP				MMR_REG(0x08000008U)
 
-#define MMR_DMNI_INF_ADDRESS		(*(volatile unsigned int*)0x08000010U)
-#define MMR_DMNI_INF_MANYCORE_SZ	(*(volatile unsigned int*)0x08000014U)
-#define MMR_DMNI_INF_IMEM_PAGE_SZ	(*(volatile unsigned int*)0x08000018U)
-#define MMR_DMNI_INF_DMEM_PAGE_SZ	(*(volatile unsigned int*)0x0800001CU)
+#define MMR_DMNI_INF_ADDRESS		MMR_REG(0x08000010U)
+#define MMR_DMNI_INF_MANYCORE_SZ	MMR_REG(0x08000014U)
+#define MMR_DMNI_INF_IMEM_PAGE_SZ	MMR_REG(0x08000018U)
+#define MMR_DMNI_INF_DMEM_PAGE_SZ	MMR_REG(0x0800001CU)
 
-#define MMR_DMNI_HERMES_HEAD		(*(volatile unsigned int*)0x08000020U)
-#define MMR_DMNI_HERMES_RECD_CNT	(*(volatile unsigned int*)0x08000024U)
-#define MMR_DMNI_HERMES_TIMESTAMP	(*(volatile unsigned int*)0x08000028U)
+#define MMR_DMNI_HERMES_HEAD		MMR_REG(0x08000020U)
+#define MMR_DMNI_HERMES_RECD_CNT	MMR_REG(0x08000024U)
+#define MMR_DMNI_HERMES_TIMESTAMP	MMR_REG(0x08000028U)
 
-#define MMR_DMNI_HERMES_SIZE		(*(volatile unsigned int*)0x08000030U)
-#define MMR_DMNI_HERMES_SIZE_2		(*(volatile unsigned int*)0x08000034U)
-#define MMR_DMNI_HERMES_ADDRESS		(*(volatile unsigned int*)0x08000038U)
-#define MMR_DMNI_HERMES_ADDRESS_2	(*(volatile unsigned int*)0x0800003CU)
+#define MMR_DMNI_HERMES_SIZE		MMR_REG(0x08000030U)
+#define MMR_DMNI_HERMES_SIZE_2		MMR_REG(0x08000034U)
+#define MMR_DMNI_HERMES_ADDRESS		MMR_REG(0x08000038U)
+#define MMR_DMNI_HERMES_ADDRESS_2	MMR_REG(0x0800003CU)
 
-#define MMR_DMNI_BRLITE_KSVC		(*(volatile unsigned int*)0x08000040U)
-#define MMR_DMNI_BRLITE_PAYLOAD		(*(volatile unsigned int*)0x08000044U)
+#define MMR_DMNI_BRLITE_KSVC		MMR_REG(0x08000040U)
+#define MMR_DMNI_BRLITE_PAYLOAD		MMR_REG(0x08000044U)
 
-#define MMR_DMNI_MON_BASE			(*(volatile unsigned int*)0x08000050U)
-#define MMR_DMNI_MON_SEM_OC			(*(volatile unsigned int*)0x08000054U)
-#define MMR_DMNI_MON_SEM_AV			(*(volatile unsigned int*)0x08000058U)
-#define MMR_DMNI_MON_FLITS			(*(volatile unsigned int*)0x0800005CU)
+#define MMR_DMNI_MON_BASE			MMR_REG(0x08000050U)
+#define MMR_DMNI_MON_SEM_OC			MMR_REG(0x08000054U)
+#define MMR_DMNI_MON_SEM_AV			MMR_REG(0x08000058U)
+#define MMR_DMNI_MON_FLITS			MMR_REG(0x0800005CU)
 
 /* DEBUG MMR */
-#define MMR_DBG_PUTC				(*(volatile unsigned int*)0x80000000U)
-#define MMR_DBG_HALT				(*(volatile unsigned int*)0x80000004U)
-#define MMR_DBG_TERMINATE			(*(volatile unsigned int*)0x80000008U)
-#define MMR_DBG_SCHED_REPORT		(*(volatile unsigned int*)0x80000010U)
-#define MMR_DBG_ADD_PIPE			(*(volatile unsigned int*)0x80000020U)
-#define MMR_DBG_REM_PIPE			(*(volatile unsigned int*)0x80000024U)
-#define MMR_DBG_ADD_REQ				(*(volatile unsigned int*)0x80000030U)
-#define MMR_DBG_REM_REQ				(*(volatile unsigned int*)0x80000034U)
-#define MMR_DBG_ADD_DAV				(*(volatile unsigned int*)0x80000040U)
-#define MMR_DBG_REM_DAV				(*(volatile unsigned int*)0x80000044U)
-
-#define MMR_DBG_SAFE_SND_TIME		(*(volatile unsigned int*)0x80000050U)
-#define MMR_DBG_SAFE_INF_TIME		(*(volatile unsigned int*)0x80000054U)
-#define MMR_DBG_SAFE_EDGE			(*(volatile unsigned int*)0x80000058U)
-#define MMR_DBG_SAFE_INF_LAT		(*(volatile unsigned int*)0x8000005CU)
-#define MMR_DBG_SAFE_LAT_PRED		(*(volatile unsigned int*)0x80000060U)
-#define MMR_DBG_SAFE_LAT_MON		(*(volatile unsigned int*)0x80000064U)
+#define MMR_DBG_PUTC				MMR_REG(0x80000000U)
+#define MMR_DBG_HALT				MMR_REG(0x80000004U)
+#define MMR_DBG_TERMINATE			MMR_REG(0x80000008U)
+#define MMR_DBG_SCHED_REPORT		MMR_REG(0x80000010U)
+#define MMR_DBG_ADD_PIPE			MMR_REG(0x80000020U)
+#define MMR_DBG_REM_PIPE			MMR_REG(0x80000024U)
+#define MMR_DBG_ADD_REQ				MMR_REG(0x80000030U)
+#define MMR_DBG_REM_REQ				MMR_REG(0x80000034U)
+#define MMR_DBG_ADD_DAV				MMR_REG(0x80000040U)
+#define MMR_DBG_REM_DAV				MMR_REG(0x80000044U)
+
+#define MMR_DBG_SAFE_SND_TIME		MMR_REG(0x80000050U)
+#define MMR_DBG_SAFE_INF_TIME		MMR_REG(0x80000054U)
+#define MMR_DBG_SAFE_EDGE			MMR_REG(0x80000058U)
+#define MMR_DBG_SAFE_INF_LAT		MMR_REG(0x8000005CU)
+#define MMR_DBG_SAFE_LAT_PRED		MMR_REG(0x80000060U)
+#define MMR_DBG_SAFE_LAT_MON		MMR_REG(0x80000064U)
+
+#define MMR_DBG_TRACE				MMR_REG(0x80000070U)	//!< Only written with TRACE_ENABLE, see trace.h
 
 enum PLIC_IE {
 	PLIC_IE_NONE,
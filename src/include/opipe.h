@@ -14,14 +14,20 @@
 #pragma once
 
 #include <stddef.h>
+#include <stdbool.h>
 
 /**
  * @brief This structure stores a task message in kernel space (task -- kernel -> NoC)
+ * 
+ * @details A borrowed pipe points to the message in the producer page instead
+ * of a kernel copy. The producer must not run until the message is consumed
+ * or materialized.
  */
 typedef struct _opipe {
 	int receiver;
 	void *buf;
 	size_t size;
+	bool borrowed;
 } opipe_t;
 
 /**
@@ -36,6 +42,38 @@ typedef struct _opipe {
  */
 int opipe_push(opipe_t *opipe, void *msg, size_t size, int receiver);
 
+/**
+ * @brief Points the output pipe to a message without copying it
+ * 
+ * @param opipe Pointer to the output pipe structure
+ * @param msg Pointer to the message in the producer page (kernel address)
+ * @param size Size of the message
+ * @param receiver Target consumer task ID
+ * 
+ * @return int Number of bytes lent
+ */
+int opipe_borrow(opipe_t *opipe, void *msg, size_t size, int receiver);
+
+/**
+ * @brief Copies a borrowed message to kernel memory
+ * 
+ * @param opipe Pointer to the output pipe structure
+ * 
+ * @return int
+ *  0 success
+ * -ENOMEM: impossible to allocate memory
+ */
+int opipe_materialize(opipe_t *opipe);
+
+/**
+ * @brief Checks if the pipe points to the producer page
+ * 
+ * @param opipe Pointer to the output pipe structure
+ * 
+ * @return True if borrowed
+ */
+bool opipe_is_borrowed(opipe_t *opipe);
+
 /**
  * @brief Gets the buffer pointer to opipe
  * 
@@ -48,7 +86,7 @@ void *opipe_get_buf(opipe_t *opipe, size_t *size);
 /**
  * @brief Pops the pipe
  * 
- * @details This frees the message in buffer
+ * @details This frees the message in buffer, unless it is borrowed
  * 
  * @param opipe Pointer to the pipe
  */
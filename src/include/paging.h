@@ -9,20 +9,51 @@
  * @date August 2022
  *
  * @brief MAestro paging control
+ *
+ * @details The task memory is managed by a buddy allocator. Each task gets a
+ * power-of-two region aligned to its own size, so a task address is still
+ * composed by OR-ing the region offset, and the virtual memory mask of the
+ * task is its region size minus one.
  */
 
 #pragma once
 
+#include <stddef.h>
 #include <stdbool.h>
 
+#ifndef PAGE_MIN_SZ
+	#define PAGE_MIN_SZ 4096		//!< Smallest region. Power of two.
+#endif
+
+#ifndef PAGE_ORDERS
+	#define PAGE_ORDERS 12			//!< Number of region sizes, from PAGE_MIN_SZ doubling up
+#endif
+
+#ifndef PAGE_STACK_HEAP_SZ
+	#define PAGE_STACK_HEAP_SZ 16384	//!< Room for stack and heap added to the task image
+#endif
+
 /**
  * @brief Stores the state of a page 
+ *
+ * @details offset and size are read by the HAL on context restore
  */
 typedef struct _page {
     void *offset;
+    size_t size;
     bool free;
 } page_t;
 
+/**
+ * @brief Task memory counters
+ */
+typedef struct _page_stats {
+    size_t total;       //!< Memory managed for tasks in bytes
+    size_t free;        //!< Memory not assigned to any task in bytes
+    unsigned regions;   //!< Regions assigned to tasks
+    unsigned failures;  //!< Acquisitions without a free region large enough
+} page_stats_t;
+
 /**
  * @brief Initializes pages 
  * 
@@ -32,16 +63,33 @@ typedef struct _page {
  */
 int page_init();
 
+/**
+ * @brief Gets the region size that fits a task image
+ *
+ * @details The region is never smaller than the platform page size
+ * (MMR_DMNI_INF_IMEM_PAGE_SZ), so a task keeps at least the memory it had
+ * with fixed pages.
+ *
+ * @param image_size Size of the text, data and bss sections
+ *
+ * @return size_t Power-of-two region size, with room for stack and heap
+ */
+size_t page_fit(size_t image_size);
+
 /**
  * @brief Acquire a page
  * 
- * @return page_t* Pointer to a page
+ * @param size Minimum size of the region in bytes
+ *
+ * @return page_t* Pointer to a page, NULL if no free region is large enough
  */
-page_t *page_acquire();
+page_t *page_acquire(size_t size);
 
 /**
  * @brief Releases a page
  * 
+ * @details The region is merged with its free buddies
+ *
  * @param page Pointer to page
  */
 void page_release(page_t *page);
@@ -53,3 +101,34 @@ void page_release(page_t *page);
  * @return void* Offset of the page
  */
 void *page_get_offset(page_t *page);
+
+/**
+ * @brief Gets the size of a page
+ *
+ * @param page Pointer to page
+ * @return size_t Size of the region in bytes
+ */
+size_t page_get_size(page_t *page);
+
+/**
+ * @brief Gets the size of the largest free region
+ *
+ * @return size_t Size in bytes, 0 if the memory is full
+ */
+size_t page_get_largest();
+
+/**
+ * @brief Counts the free regions of a size
+ *
+ * @param size Region size in bytes
+ *
+ * @return unsigned Number of regions of the size that can still be acquired
+ */
+unsigned page_count_free(size_t size);
+
+/**
+ * @brief Gets the task memory counters
+ *
+ * @return const page_stats_t* Pointer to the counters
+ */
+const page_stats_t *page_get_stats();
@@ -0,0 +1,177 @@
+/**
+ * MAestro
+ * @file perf.h
+ *
+ * @author Angelo Elias Dalzotto (angelo.dalzotto@edu.pucrs.br)
+ * GAPH - Hardware Design Support Group (https://corfu.pucrs.br/)
+ * PUCRS - Pontifical Catholic University of Rio Grande do Sul (http://pucrs.br/)
+ *
+ * @date October 2026
+ *
+ * @brief Per-PE kernel performance counters.
+ *
+ * @details Cycles are read from the zicntr cycle counter, so the counters
+ * measure the core time and not the RTC. Syscalls and packets are counted in
+ * buckets indexed by their number modulo the bucket count. A management task
+ * reads and resets the counters with SYS_getperf.
+ * Kernels built with HAL_PROFILE also keep histograms of the HAL paths: the
+ * cycles from vector_entry to the dispatcher call, by entry path, and from the
+ * dispatcher return to mret, by exit path.
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <hal.h>
+
+#ifndef PERF_ENABLE
+	#define PERF_ENABLE 1			//!< Updates the counters
+#endif
+
+#ifndef PERF_SYSCALL_SLOTS
+	#define PERF_SYSCALL_SLOTS 64	//!< Syscall buckets, indexed by number modulo slots
+#endif
+
+#ifndef PERF_SERVICE_SLOTS
+	#define PERF_SERVICE_SLOTS 64	//!< Hermes service buckets, indexed by service modulo slots
+#endif
+
+#ifndef PERF_HIST_BUCKETS
+	#define PERF_HIST_BUCKETS 16	//!< Power-of-two buckets of the HAL histograms
+#endif
+
+/**
+ * @brief Interrupt causes, as decoded by the dispatcher
+ */
+typedef enum _perf_irq {
+	PERF_IRQ_BRLITE,	//!< Broadcast packet
+	PERF_IRQ_HERMES,	//!< Hermes packet
+	PERF_IRQ_TIMER,		//!< Timer
+	PERF_IRQ_MONITOR,	//!< Monitor data available, without other cause
+	PERF_IRQ_OTHER,		//!< None of the above
+	PERF_IRQ_CNT
+} perf_irq_t;
+
+/**
+ * @brief Per-cause interrupt counter
+ */
+typedef struct _perf_isr {
+	uint32_t entries;	//!< Dispatcher calls
+	uint32_t cycles;	//!< Cycles in the dispatcher, scheduler included
+} perf_isr_t;
+
+/**
+ * @brief Histogram of a HAL path
+ */
+typedef struct _perf_hist {
+	uint32_t count;							//!< Samples
+	uint32_t cycles;						//!< Sum of the samples
+	uint32_t max;							//!< Longest sample
+	uint32_t buckets[PERF_HIST_BUCKETS];	//!< Samples in [2^i, 2^(i+1)) cycles, the last one unbounded
+} perf_hist_t;
+
+/**
+ * @brief Kernel performance counters
+ *
+ * @details Layout read by the management task through SYS_getperf
+ */
+typedef struct _perf_stats {
+	uint64_t cycles;						//!< Cycles since the last reset
+	uint64_t instret;						//!< Instructions retired since the last reset
+	perf_isr_t isr[PERF_IRQ_CNT];			//!< Interrupts by cause
+	uint32_t sched_runs;					//!< Scheduler invocations
+	uint32_t sched_cycles;					//!< Cycles in the scheduler
+	uint32_t sched_overhead;				//!< Last scheduler overhead estimate, in RTC ticks
+	uint32_t syscalls[PERF_SYSCALL_SLOTS];	//!< Syscalls by number
+	uint32_t packets[PERF_SERVICE_SLOTS];	//!< Hermes packets received by service
+	uint32_t dmni_waits;					//!< Busy-waits for the DMNI
+	uint32_t dmni_wait_cycles;				//!< Cycles busy-waiting for the DMNI
+	uint32_t malloc_calls;					//!< Kernel heap allocations
+	uint32_t malloc_bytes;					//!< Bytes requested from the kernel heap
+	uint32_t malloc_failures;				//!< Allocations that returned NULL
+	uint32_t pool_overflows;				//!< Pool allocations whose size class was exhausted
+	uint32_t pool_heap;						//!< Overflows served by the kernel heap, no larger class free
+	perf_hist_t hal_latency[HAL_ENTRY_MAX];	//!< vector_entry to dispatcher call, by hal_entry_e
+	perf_hist_t hal_switch[HAL_EXIT_MAX];	//!< Dispatcher return to mret, by hal_exit_e
+} perf_stats_t;
+
+/**
+ * @brief Reads the 64-bit cycle counter
+ *
+ * @return uint64_t Cycle count
+ */
+uint64_t perf_cycles();
+
+/**
+ * @brief Accounts an interrupt
+ *
+ * @param cause Decoded cause
+ * @param cycles Cycles in the dispatcher
+ */
+void perf_isr(perf_irq_t cause, uint32_t cycles);
+
+/**
+ * @brief Accounts a scheduler invocation
+ *
+ * @param cycles Cycles in the scheduler
+ */
+void perf_sched(uint32_t cycles);
+
+/**
+ * @brief Stores the scheduler overhead estimate
+ *
+ * @param overhead Overhead in RTC ticks
+ */
+void perf_sched_overhead(uint32_t overhead);
+
+/**
+ * @brief Accounts a syscall
+ *
+ * @param number Syscall number
+ */
+void perf_syscall(unsigned number);
+
+/**
+ * @brief Accounts a received Hermes packet
+ *
+ * @param service Packet service
+ */
+void perf_packet(uint8_t service);
+
+/**
+ * @brief Accounts an allocation whose pool size class was exhausted
+ *
+ * @param heap True if no larger class was free and the heap was used
+ */
+void perf_pool_overflow(bool heap);
+
+/**
+ * @brief Accounts a DMNI busy-wait
+ *
+ * @param cycles Cycles waited
+ */
+void perf_dmni_wait(uint32_t cycles);
+
+/**
+ * @brief Accounts the HAL timestamps
+ *
+ * @details Called by the HAL when the dispatcher returns. The latency of the
+ * current trap is complete, and so is the switch of the previous one, which
+ * left the kernel through mret or idle.
+ */
+void perf_hal();
+
+/**
+ * @brief Copies the counters
+ *
+ * @param dst Pointer to the destination (kernel address)
+ */
+void perf_read(perf_stats_t *dst);
+
+/**
+ * @brief Clears the counters
+ */
+void perf_reset();
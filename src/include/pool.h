@@ -0,0 +1,69 @@
+/**
+ * MAestro
+ * @file pool.h
+ *
+ * @author Angelo Elias Dalzotto (angelo.dalzotto@edu.pucrs.br)
+ * GAPH - Hardware Design Support Group (https://corfu.pucrs.br/)
+ * PUCRS - Pontifical Catholic University of Rio Grande do Sul (http://pucrs.br/)
+ *
+ * @date October 2026
+ *
+ * @brief Fixed-size object pools for the kernel hot-path allocations.
+ *
+ * @details Objects are grouped in size classes, each one backed by a single
+ * block reserved at boot and sized from the number of task slots of the PE.
+ * Allocation and release are constant time and do not fragment the heap.
+ * Requests larger than the biggest class, or made when a class is exhausted,
+ * fall back to malloc, and pool_free releases both kinds of pointer.
+ * An exhausted class is counted in the pool_overflows and pool_heap counters
+ * of SYS_getperf, so an undersized reserve shows up at run time.
+ *
+ * Variable-size buffers are still allocated from the kernel heap:
+ *  - message payloads: opipe buffers, ipipe bounce buffers, inbound ring
+ *    slots, kernel messages received and deliveries forwarded to a migrated
+ *    consumer;
+ *  - migration images: encoded data and stack, handshake vectors, task
+ *    locations and the pre-copy section copy;
+ *  - per-task objects created at allocation: TCB, page, application, task
+ *    locations, text cache entries and allocation acks.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * @brief Pool of a size class
+ */
+typedef struct _pool {
+	size_t size;		//!< Object size in bytes
+	unsigned per_task;	//!< Objects reserved per task slot
+	char *base;			//!< First object of the pool
+	char *end;			//!< End of the pool block
+	void *free;			//!< Head of the free objects list
+} pool_t;
+
+/**
+ * @brief Reserves the memory of all pools
+ *
+ * @return int
+ *  0 success
+ * -ENOMEM: impossible to allocate memory
+ */
+int pool_init();
+
+/**
+ * @brief Allocates an object
+ *
+ * @param size Size of the object in bytes
+ *
+ * @return void* Pointer to the object, NULL if out of memory
+ */
+void *pool_alloc(size_t size);
+
+/**
+ * @brief Releases an object allocated by pool_alloc or malloc
+ *
+ * @param ptr Pointer to the object. Can be NULL.
+ */
+void pool_free(void *ptr);
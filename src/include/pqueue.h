@@ -0,0 +1,149 @@
+/**
+ * MAestro
+ * @file pqueue.h
+ *
+ * @author Angelo Elias Dalzotto (angelo.dalzotto@edu.pucrs.br)
+ * GAPH - Hardware Design Support Group (https://corfu.pucrs.br/)
+ * PUCRS - Pontifical Catholic University of Rio Grande do Sul (http://pucrs.br/)
+ *
+ * @date October 2026
+ *
+ * @brief Intrusive binary min-heap used by the kernel ordered queues.
+ *
+ * @details The nodes are embedded in the queued structure, so no memory is
+ * allocated when inserting or removing. Each node keeps its index inside the
+ * heap, allowing removal and key updates in O(log n).
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * @brief Node of a priority queue
+ */
+typedef struct _pqueue_node {
+	void *data;		//!< Pointer to the structure that embeds the node
+	uint64_t key;	//!< Ordering key. Lower keys are in front
+	int index;		//!< Position in the heap, -1 when not queued
+} pqueue_node_t;
+
+/**
+ * @brief Priority queue structure
+ */
+typedef struct _pqueue {
+	pqueue_node_t **heap;
+	size_t size;
+	size_t capacity;
+} pqueue_t;
+
+/**
+ * @brief Initializes a priority queue
+ *
+ * @param pq Pointer to the priority queue
+ * @param capacity Maximum number of nodes in the queue
+ *
+ * @return int
+ *  0 success
+ * -ENOMEM: impossible to allocate memory
+ */
+int pqueue_init(pqueue_t *pq, size_t capacity);
+
+/**
+ * @brief Initializes a node to be inserted in a priority queue
+ *
+ * @param node Pointer to the node
+ * @param data Pointer to the structure that embeds the node
+ */
+void pqueue_node_init(pqueue_node_t *node, void *data);
+
+/**
+ * @brief Checks if a node is inserted in a priority queue
+ *
+ * @param node Pointer to the node
+ *
+ * @return True if queued
+ */
+bool pqueue_is_queued(pqueue_node_t *node);
+
+/**
+ * @brief Inserts a node in the priority queue
+ *
+ * @param pq Pointer to the priority queue
+ * @param node Pointer to the node
+ * @param key Ordering key
+ *
+ * @return int
+ *  0 success
+ * -ENOMEM: queue is full
+ */
+int pqueue_push(pqueue_t *pq, pqueue_node_t *node, uint64_t key);
+
+/**
+ * @brief Removes a node from the priority queue
+ *
+ * @details Does nothing if the node is not queued
+ *
+ * @param pq Pointer to the priority queue
+ * @param node Pointer to the node
+ */
+void pqueue_remove(pqueue_t *pq, pqueue_node_t *node);
+
+/**
+ * @brief Changes the key of a queued node
+ *
+ * @param pq Pointer to the priority queue
+ * @param node Pointer to the node
+ * @param key New ordering key
+ */
+void pqueue_update(pqueue_t *pq, pqueue_node_t *node, uint64_t key);
+
+/**
+ * @brief Gets the data of the node with the lowest key
+ *
+ * @param pq Pointer to the priority queue
+ *
+ * @return void* Pointer to the data, NULL if empty
+ */
+void *pqueue_front(pqueue_t *pq);
+
+/**
+ * @brief Gets the lowest key in the queue
+ *
+ * @param pq Pointer to the priority queue. Must not be empty.
+ *
+ * @return uint64_t Key of the front node
+ */
+uint64_t pqueue_front_key(pqueue_t *pq);
+
+/**
+ * @brief Gets the highest key that is not above a limit
+ *
+ * @details Only the nodes with keys up to the limit are visited
+ *
+ * @param pq Pointer to the priority queue. Front key must not be above the limit.
+ * @param limit Highest key accepted
+ *
+ * @return uint64_t Highest key up to the limit
+ */
+uint64_t pqueue_last_key_until(pqueue_t *pq, uint64_t limit);
+
+/**
+ * @brief Checks if the priority queue is empty
+ *
+ * @param pq Pointer to the priority queue
+ *
+ * @return True if empty
+ */
+bool pqueue_empty(pqueue_t *pq);
+
+/**
+ * @brief Gets the number of queued nodes
+ *
+ * @param pq Pointer to the priority queue
+ *
+ * @return size_t Number of nodes
+ */
+size_t pqueue_size(pqueue_t *pq);
@@ -34,8 +34,9 @@ int rpc_bcast_dispatcher(bcast_t *packet);
  * 
  * @param message Pointer to the message
  * @param size Size of the message in bytes
+ * @param sender ID of the sender task, -1 if sent by a kernel
  * 
  * @return int
  * 1 if should schedule
  */
-int rpc_hermes_dispatcher(void *message, size_t size);
+int rpc_hermes_dispatcher(void *message, size_t size, int sender);
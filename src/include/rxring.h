@@ -0,0 +1,152 @@
+/**
+ * MAestro
+ * @file rxring.h
+ *
+ * @author Angelo Elias Dalzotto (angelo.dalzotto@edu.pucrs.br)
+ * GAPH - Hardware Design Support Group (https://corfu.pucrs.br/)
+ * PUCRS - Pontifical Catholic University of Rio Grande do Sul (http://pucrs.br/)
+ *
+ * @date October 2026
+ *
+ * @brief Inbound message ring provided by a task.
+ *
+ * @details The task registers an array of fixed-size slots in its own page.
+ * The kernel posts a MESSAGE_REQUEST for each remote DATA_AV while there are
+ * free slots, so the NoC latency overlaps with the task computation, and the
+ * deliveries are written straight to the slots. A readpipe then only copies
+ * the oldest delivered message to the task buffer.
+ * Messages larger than a slot are kept in kernel memory until read.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef RXRING_MAX_SLOTS
+	#define RXRING_MAX_SLOTS 8	//!< Maximum number of slots of an inbound ring
+#endif
+
+/**
+ * @brief State of a ring slot
+ */
+typedef enum _rxslot_state {
+	RXSLOT_FREE,
+	RXSLOT_POSTED,	//!< MESSAGE_REQUEST sent, waiting for the delivery
+	RXSLOT_FILLED	//!< Message delivered, waiting for a readpipe
+} rxslot_state_t;
+
+/**
+ * @brief Ring slot control
+ */
+typedef struct _rxslot {
+	void *kbuf;			//!< Kernel copy of a message larger than the slot, NULL if in the ring
+	unsigned seq;		//!< Posting order
+	uint16_t sender;	//!< Producer task ID
+	uint16_t size;		//!< Delivered message size
+	uint8_t state;		//!< rxslot_state_t
+} rxslot_t;
+
+/**
+ * @brief Inbound ring control
+ */
+typedef struct _rxring {
+	void *buf;			//!< First slot, in task address space
+	size_t slot_size;	//!< Size of each slot in bytes
+	unsigned slots;		//!< Number of slots
+	unsigned seq;		//!< Sequence number of the next posted slot
+	unsigned used;		//!< Number of slots posted or filled
+	rxslot_t slot[RXRING_MAX_SLOTS];
+} rxring_t;
+
+/**
+ * @brief Initializes an inbound ring
+ *
+ * @param rxring Pointer to the ring
+ * @param buf Pointer to the first slot (task address space)
+ * @param slot_size Size of each slot in bytes
+ * @param slots Number of slots
+ */
+void rxring_init(rxring_t *rxring, void *buf, size_t slot_size, unsigned slots);
+
+/**
+ * @brief Reserves a slot for a message request
+ *
+ * @param rxring Pointer to the ring
+ * @param sender Producer task ID
+ *
+ * @return int Slot index, -1 if the ring is full
+ */
+int rxring_post(rxring_t *rxring, uint16_t sender);
+
+/**
+ * @brief Finds the oldest slot waiting for a delivery from a producer
+ *
+ * @param rxring Pointer to the ring
+ * @param sender Producer task ID
+ *
+ * @return int Slot index, -1 if not found
+ */
+int rxring_find_posted(rxring_t *rxring, uint16_t sender);
+
+/**
+ * @brief Receives a message from the DMNI into a posted slot
+ *
+ * @param rxring Pointer to the ring
+ * @param index Slot index
+ * @param offset Task page offset
+ * @param size Size of the message
+ *
+ * @return int
+ *  Number of bytes received on success
+ * -ENOMEM: message larger than the slot and no memory to hold it (dropped)
+ */
+int rxring_receive(rxring_t *rxring, int index, void *offset, size_t size);
+
+/**
+ * @brief Finds the oldest delivered message
+ *
+ * @param rxring Pointer to the ring
+ *
+ * @return int Slot index, -1 if none
+ */
+int rxring_oldest_filled(rxring_t *rxring);
+
+/**
+ * @brief Copies a delivered message to the task buffer and frees its slot
+ *
+ * @param rxring Pointer to the ring
+ * @param index Slot index
+ * @param offset Task page offset
+ * @param dst Pointer to the destination buffer (kernel address)
+ * @param size Size of the destination buffer
+ *
+ * @return size_t Number of bytes copied. 0 if the buffer is too small, keeping the message.
+ */
+size_t rxring_pop(rxring_t *rxring, int index, void *offset, void *dst, size_t size);
+
+/**
+ * @brief Checks if there is a free slot
+ *
+ * @param rxring Pointer to the ring
+ *
+ * @return True if a message request can be posted
+ */
+bool rxring_has_free(rxring_t *rxring);
+
+/**
+ * @brief Checks if no slot is posted nor filled
+ *
+ * @param rxring Pointer to the ring
+ *
+ * @return True if idle
+ */
+bool rxring_is_idle(rxring_t *rxring);
+
+/**
+ * @brief Releases the kernel copies held by the ring
+ *
+ * @param rxring Pointer to the ring
+ */
+void rxring_clear(rxring_t *rxring);
@@ -23,6 +23,19 @@
 #include <memphis/monitor.h>
 
 #include "task_control.h"
+#include "perf.h"
+
+#ifndef SYS_gettick64
+	#define SYS_gettick64 4100
+#endif
+
+#ifndef SYS_setrxring
+	#define SYS_setrxring 4101
+#endif
+
+#ifndef SYS_getperf
+	#define SYS_getperf 4102
+#endif
 
 /**
  * @brief Decodes a syscall
@@ -98,6 +111,34 @@ int sys_readpipe(tcb_t *tcb, void *buf, size_t size, int prod_task, bool sync);
  */	
 unsigned int sys_get_tick();
 
+/**
+ * @brief Gets the full 64-bit tick count
+ * 
+ * @param tcb Pointer to the TCB
+ * @param tick Pointer to store the tick count
+ * 
+ * @return 0 if success, -EINVAL on invalid argument
+ */
+int sys_get_tick64(tcb_t *tcb, uint64_t *tick);
+
+/**
+ * @brief Registers an inbound ring for remote messages
+ * 
+ * @details Synchronous reads of remote messages are then requested ahead and
+ * delivered to the ring slots.
+ * 
+ * @param tcb Pointer to the TCB
+ * @param buf Pointer to the first slot, word aligned. NULL unregisters the ring.
+ * @param slot_size Size of each slot in bytes, multiple of 4
+ * @param slots Number of slots, up to RXRING_MAX_SLOTS
+ * 
+ * @return 0 if success
+ *         -EINVAL on invalid argument
+ *         -EBUSY if the current ring still has messages in flight or unread
+ *         -ENOMEM if out of memory
+ */
+int sys_setrxring(tcb_t *tcb, void *buf, size_t slot_size, unsigned slots);
+
 /**
  * @brief Configures a task real time
  * 
@@ -202,6 +243,20 @@ int sys_close(int file);
  */
 int sys_get_ctx(tcb_t *tcb, mctx_t *ctx);
 
+/**
+ * @brief Reads the kernel performance counters
+ * 
+ * @details Only management tasks can read the counters
+ * 
+ * @param tcb Pointer to the TCB
+ * @param stats Pointer to store the counters. NULL only resets them.
+ * @param reset Clears the counters after reading
+ * 
+ * @return int Size of the counters in bytes if success
+ *         -EACCES if not a management task
+ */
+int sys_get_perf(tcb_t *tcb, perf_stats_t *stats, bool reset);
+
 /**
  * @brief Ends the simulation
  * 
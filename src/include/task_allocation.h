@@ -15,6 +15,12 @@
 
 #include <hermes.h>
 
+#include <memphis/messaging.h>
+
+#ifndef TALLOC_BACKGROUND_DATA
+	#define TALLOC_BACKGROUND_DATA 1	//!< Receive .data of mapped tasks while TASK_ALLOCATED is handled
+#endif
+
 /**
  * Task allocation packet
  * 
@@ -26,6 +32,7 @@
  * task App+Task ID allocated
  * mapper_address Address of mapper task
  * mapper_task ID of the mapping task (App ID is 0)
+ * batch Number of tasks in the packet, 0 or 1 if only this one
  */
 typedef struct _talloc {
     hermes_t hermes;
@@ -42,12 +49,50 @@ typedef struct _talloc {
     uint16_t mapper_address;
     uint16_t task;
 
-    /* {pad16, pad8, mapper_task} */
+    /* {batch, pad8, mapper_task} */
     int8_t   mapper_task;
     uint8_t  pad8;
-    uint16_t pad16;
+    uint16_t batch;
 
-    /* Payload: binary with text+data+bss */
+    /* Payload: binary with text+data+bss, then {talloc_img_t, binary} of each remaining task */
 } talloc_t;
 
+/**
+ * Description of a task after the first in a batched allocation packet
+ * 
+ * entry_point Starting PC
+ * text_size Text section size in bytes
+ * data_size Data section size in bytes
+ * bss_size BSS section size in bytes
+ * task App+Task ID allocated
+ */
+typedef struct _talloc_img {
+    uint32_t entry_point;
+
+    uint32_t text_size;
+
+    uint32_t data_size;
+
+    uint32_t bss_size;
+
+    /* {pad16, task} */
+    uint16_t task;
+    uint16_t pad16;
+} talloc_img_t;
+
+/**
+ * Acknowledgement of a batched allocation, sent as TASK_ALLOCATED
+ * 
+ * info TASK_ALLOCATED with the first allocated task and the free slots in task_cnt
+ * count Number of tasks allocated
+ * tasks ID of each allocated task. Refused ones are answered with TASK_ABORTED.
+ */
+typedef struct _talloc_ack {
+    memphis_info_t info;
+
+    uint32_t count;
+
+    uint16_t tasks[];
+} talloc_ack_t;
+
 int talloc_alloc(talloc_t *alloc);
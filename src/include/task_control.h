@@ -25,6 +25,11 @@
 #include "task_scheduler.h"
 #include "ipipe.h"
 #include "opipe.h"
+#include "rxring.h"
+
+#ifndef TCB_OPIPE_SLOTS
+	#define TCB_OPIPE_SLOTS 4	//!< Outbound messages a task can have waiting for its consumers
+#endif
 
 /** @brief This structure stores information of the running tasks */
 typedef struct _tcb {
@@ -34,6 +39,7 @@ typedef struct _tcb {
 	
 	int id;					//!< TCB identifier
 	size_t text_size;		//!< Memory TEXT section size in bytes
+	uint64_t text_hash;		//!< Hash identifying the TEXT section, 0 if unknown
 	size_t data_size;		//!< Memory DATA section size in bytes
 	size_t bss_size;		//!< Memory BSS section size in bytes
 	int proc_to_migrate;	//!< Address of the processor to migrate
@@ -47,23 +53,34 @@ typedef struct _tcb {
 	app_t *app;				//!< Pointer to the app structure containing task location
 	sched_t *scheduler;	//!< Pointer to the scheduling control structure
 	ipipe_t *pipe_in;		//!< Pointer storage for inbound messages
-	opipe_t *pipe_out;		//!< Temporary buffer for outbound messages
+	opipe_t *pipe_out[TCB_OPIPE_SLOTS];	//!< Outbound messages, oldest first
+	unsigned pipe_out_cnt;	//!< Number of outbound messages
+	rxring_t *rxring;		//!< Inbound ring provided by the task, NULL if not used
 
 	bool called_exit;		//!< Flags that the task has exited
 } tcb_t;
 
 /**
  * @brief Initializes the TCB structures
+ * 
+ * @return int
+ *  0 success
+ * -ENOMEM: impossible to allocate memory
  */
-void tcb_init();
+int tcb_init();
 
 /**
- * @brief Pushes a TCB to the list
+ * @brief Inserts a TCB in the hash table
+ * 
+ * @details The TCB must already have its ID set by tcb_alloc
  * 
  * @param tcb Pointer to the TCB
- * @return list_entry_t* Pointer to the list entry
+ * 
+ * @return int
+ *  0 success
+ * -ENOMEM: table is full
  */
-list_entry_t *tcb_push_back(tcb_t *tcb);
+int tcb_push_back(tcb_t *tcb);
 
 /**
  * @brief Finds a TCB
@@ -81,16 +98,22 @@ tcb_t *tcb_find(int task);
  * @param text_size Size of the code section
  * @param data_size Size of the data section
  * @param bss_size Size of the BSS section
+ * @param page_size Size of the memory region of the task
  * @param mapper_task ID of the mapper task
  * @param mapper_addr Address of the mapper task
  * @param entry_point Starting execution address
+ * 
+ * @return int
+ *  0 success
+ * -ENOMEM: no free memory region large enough
  */
-void tcb_alloc(
+int tcb_alloc(
 	tcb_t *tcb, 
 	int id, 
 	size_t text_size, 
 	size_t data_size, 
 	size_t bss_size, 
+	size_t page_size, 
 	int mapper_task, 
 	int mapper_addr, 
 	void *entry_point
@@ -120,13 +143,54 @@ void tcb_abort_task(tcb_t *tcb);
 void tcb_remove(tcb_t *tcb);
 
 /**
- * @brief Gets the output pipe structure
+ * @brief Takes a task out of the TCB table and scheduler, keeping its memory
+ * 
+ * @details Used while the task image is still being sent. Can be followed by
+ * tcb_remove.
  * 
  * @param tcb Pointer to the TCB
+ */
+void tcb_detach(tcb_t *tcb);
+
+/**
+ * @brief Gets the oldest output pipe to a consumer
+ * 
+ * @param tcb Pointer to the TCB
+ * @param receiver Consumer task ID
  * 
  * @return opipe_t* Pointer to the PIPE. NULL if not present.
  */
-opipe_t *tcb_get_opipe(tcb_t *tcb);
+opipe_t *tcb_get_opipe(tcb_t *tcb, int receiver);
+
+/**
+ * @brief Gets an output pipe by its position
+ * 
+ * @details Pipes are ordered from the oldest to the newest
+ * 
+ * @param tcb Pointer to the TCB
+ * @param index Position of the pipe
+ * 
+ * @return opipe_t* Pointer to the PIPE. NULL if past the last one.
+ */
+opipe_t *tcb_get_opipe_at(tcb_t *tcb, unsigned index);
+
+/**
+ * @brief Checks if the task has outbound messages
+ * 
+ * @param tcb Pointer to the TCB
+ * 
+ * @return True if there is at least one output pipe
+ */
+bool tcb_has_opipe(tcb_t *tcb);
+
+/**
+ * @brief Gets the number of free output pipe slots
+ * 
+ * @param tcb Pointer to the TCB
+ * 
+ * @return unsigned Number of free slots
+ */
+unsigned tcb_get_opipe_free(tcb_t *tcb);
 
 /**
  * @brief Terminates a task after exit
@@ -164,20 +228,23 @@ bool tcb_need_migration(tcb_t *tcb);
 /**
  * @brief Creates an output pipe structure
  * 
+ * @details The pipe is placed after the existing ones
+ * 
  * @param tcb Pointer to the TCB
  * 
- * @return opipe_t* Pointer to the created pipe
+ * @return opipe_t* Pointer to the created pipe. NULL if all slots are in use or out of memory.
  */
 opipe_t *tcb_create_opipe(tcb_t *tcb);
 
 /**
- * @brief Destroys the output pipe
+ * @brief Destroys an output pipe
  * 
  * @details The message buffer is not freed here. Check DMNI functions.
  * 
  * @param tcb Pointer to the TCB
+ * @param opipe Pointer to the pipe
  */
-void tcb_destroy_opipe(tcb_t *tcb);
+void tcb_destroy_opipe(tcb_t *tcb, opipe_t *opipe);
 
 /**
  * @brief Gets the list of message requests
@@ -195,6 +262,17 @@ list_t *tcb_get_msgreqs(tcb_t *tcb);
  */
 list_t *tcb_get_davs(tcb_t *tcb);
 
+/**
+ * @brief Updates the address of a migrated task in the handshakes of all TCBs
+ * 
+ * @details Message requests and data available received from the task before
+ * it migrated point to its new address, so they no longer need forwarding.
+ * 
+ * @param task ID of the migrated task
+ * @param addr New address of the task
+ */
+void tcb_relocate(int task, int addr);
+
 /**
  * @brief Sends a task allocated message
  * 
@@ -213,6 +291,15 @@ bool tcb_send_allocated(tcb_t *tcb);
  */
 void *tcb_get_offset(tcb_t *tcb);
 
+/**
+ * @brief Gets the size of the memory region of a task
+ * 
+ * @param tcb Pointer to the TCB
+ * 
+ * @return size_t Region size in bytes
+ */
+size_t tcb_get_page_size(tcb_t *tcb);
+
 /**
  * @brief Gets the address to migrate to
  * 
@@ -274,6 +361,27 @@ unsigned *tcb_get_regs(tcb_t *tcb);
  */
 size_t tcb_get_text_size(tcb_t *tcb);
 
+/**
+ * @brief Gets the hash identifying the text section
+ * 
+ * @param tcb Pointer to the TCB
+ * 
+ * @return uint64_t Hash of the text, 0 if unknown
+ */
+uint64_t tcb_get_text_hash(tcb_t *tcb);
+
+/**
+ * @brief Identifies the text section of a task and registers it in the text cache
+ * 
+ * @param tcb Pointer to the TCB, with the text in its page
+ * @param hash Hash of the text
+ * 
+ * @return int
+ *  0 on success
+ * -ENOMEM if not enough memory
+ */
+int tcb_cache_text(tcb_t *tcb, uint64_t hash);
+
 /**
  * @brief Gets the size of the data section
  * 
@@ -377,6 +485,33 @@ ipipe_t *tcb_create_ipipe(tcb_t *tcb);
  */
 void tcb_destroy_ipipe(tcb_t *tcb);
 
+/**
+ * @brief Gets the inbound ring
+ * 
+ * @param tcb Pointer to the TCB
+ * 
+ * @return rxring_t* Pointer to the ring. NULL if not present.
+ */
+rxring_t *tcb_get_rxring(tcb_t *tcb);
+
+/**
+ * @brief Creates the inbound ring structure
+ * 
+ * @details Replaces the current ring, if any
+ * 
+ * @param tcb Pointer to the TCB
+ * 
+ * @return rxring_t* Pointer to the created ring
+ */
+rxring_t *tcb_create_rxring(tcb_t *tcb);
+
+/**
+ * @brief Destroys the inbound ring, freeing the messages it holds
+ * 
+ * @param tcb Pointer to the TCB
+ */
+void tcb_destroy_rxring(tcb_t *tcb);
+
 /**
  * @brief Gets the scheduler pointer
  * 
@@ -408,6 +543,16 @@ void tcb_set_ret(tcb_t *tcb, int ret);
  */
 size_t tcb_size();
 
+/**
+ * @brief Gets the number of tasks that can still be allocated in the PE
+ * 
+ * @details Reported to the mapper with TASK_ALLOCATED and TASK_TERMINATED in
+ * the task_cnt field, so it does not overcommit the PE.
+ * 
+ * @return unsigned Number of free task slots with a memory region available
+ */
+unsigned tcb_get_free_slots();
+
 /**
  * @brief Increments the program counter
  * 
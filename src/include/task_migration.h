@@ -17,6 +17,46 @@
 #include <task_control.h>
 #include <hermes.h>
 
+#include <memphis/messaging.h>
+
+#ifndef TM_COMPRESS
+	#define TM_COMPRESS 1	//!< Zero-run encoding of the data and stack images
+#endif
+
+#ifndef TM_PRECOPY
+	#define TM_PRECOPY 0	//!< Pre-copy large data sections while the task runs. Holds a kernel copy of the section.
+#endif
+
+#ifndef TM_PRECOPY_BLOCK
+	#define TM_PRECOPY_BLOCK 512	//!< Pre-copy block size in bytes, multiple of 4
+#endif
+
+#ifndef TM_PRECOPY_MIN_BLOCKS
+	#define TM_PRECOPY_MIN_BLOCKS 4	//!< Smaller data sections are migrated stopped
+#endif
+
+#ifndef TM_PRECOPY_ROUNDS
+	#define TM_PRECOPY_ROUNDS 4	//!< Maximum pre-copy rounds before stopping the task
+#endif
+
+#ifndef TM_PRECOPY_STOP_BLOCKS
+	#define TM_PRECOPY_STOP_BLOCKS 2	//!< Blocks written in a round that allow stopping the task
+#endif
+
+#ifndef TM_PRECOPY_RETRY
+	#define TM_PRECOPY_RETRY 10000	//!< Cycles to retry stopping a task that is waiting a delivery
+#endif
+
+/**
+ * @brief Kind of a MIGRATION_TEXT packet
+ */
+typedef enum _tm_text_kind {
+    TM_TEXT_FULL,   //!< Carries the text
+    TM_TEXT_PROBE,  //!< Asks the target to take the text from its cache
+    TM_TEXT_HIT,    //!< Answer: text found in the target cache
+    TM_TEXT_MISS    //!< Answer: text must be sent
+} tm_text_kind_t;
+
 typedef struct _tm_text {
     hermes_t hermes;
 
@@ -26,12 +66,19 @@ typedef struct _tm_text {
     uint16_t mapper_address;
     uint16_t task;
 
-    /* {pad16, pad8, mapper_task} */
+    /* {source, kind, mapper_task} */
     int8_t   mapper_task;
-    uint8_t  pad8;
-    uint16_t pad16;
+    uint8_t  kind;
+    uint16_t source;
+
+    /* Hash of the text, 0 if unknown */
+    uint32_t hash_low;
+    uint32_t hash_high;
 
-    /* Payload: binary with text */
+    /* Size of the task memory region */
+    uint32_t page_size;
+
+    /* Payload: binary with text (TM_TEXT_FULL only) */
 } tm_text_t;
 
 typedef struct _tm_data {
@@ -47,7 +94,15 @@ typedef struct _tm_data {
     uint16_t task;
     uint16_t pad16;
 
-    /* Payload: binary with data+bss+heap */
+    /* Part of the data+bss+heap section carried */
+    uint32_t offset;
+
+    uint32_t size;
+
+    /* Encoded payload size, 0 if not encoded */
+    uint32_t enc_size;
+
+    /* Payload: binary with the part of data+bss+heap, see zrle.h */
 } tm_data_t;
 
 typedef struct _tm_stack {
@@ -59,7 +114,10 @@ typedef struct _tm_stack {
     uint16_t task;
     uint16_t pad16;
 
-    /* Payload: binary with stack */
+    /* Encoded payload size, 0 if not encoded */
+    uint32_t enc_size;
+
+    /* Payload: binary with stack, see zrle.h */
 } tm_stack_t;
 
 typedef struct _tm_hdshk {
@@ -111,14 +169,55 @@ typedef struct _tm_tcb {
     uint16_t task;
     uint16_t source;
 
-    /* {pad8, waiting, received} */
+    /* {cancel, waiting, received}. Cancel carries no payload */
     uint16_t received;
     uint8_t  waiting;
-    uint8_t  pad8;
+    uint8_t  cancel;
+
+    /* Inbound ring, rx_slots = 0 if not used */
+    uint32_t rx_buf;
+
+    /* {rx_slots, rx_slot_size} */
+    uint16_t rx_slot_size;
+    uint16_t rx_slots;
+
+    /* Buffer of a consumer waiting a delivery, posted_size = 0 if none */
+    uint32_t posted_buf;
+
+    uint32_t posted_size;
 
     /* Payload: TCB registers */
 } tm_tcb_t;
 
+/**
+ * @brief Location update of a migrated task
+ * 
+ * @details Sent by the source PE as a kernel MESSAGE_DELIVERY with the
+ * TASK_MIGRATED service to every PE that holds the application location
+ * table. The receiver answers with the same packet and ack_addr = -1.
+ */
+typedef struct _tm_update {
+	memphis_task_migration_t info;	//!< {TASK_MIGRATED, task, new address}
+	int32_t ack_addr;				//!< PE waiting the acknowledgement, -1 if this is the acknowledgement
+} tm_update_t;
+
+/**
+ * @brief Outbound migration counters
+ */
+typedef struct _tm_stats {
+	unsigned migrations;	//!< Migrations completed
+	uint64_t kernel_time;	//!< Cycles spent inside tm_migrate
+	uint64_t stream_time;	//!< Cycles from tm_migrate until the last packet left
+	unsigned rt_misses;		//!< RT misses of the PE while migrations were streaming
+	uint64_t precopy_bytes;	//!< Data sent while the tasks were running
+	uint64_t stop_bytes;	//!< Data sent after the tasks stopped
+	uint64_t image_bytes;	//!< Data and stack bytes migrated
+	uint64_t wire_bytes;	//!< Data and stack payload bytes sent after encoding
+	unsigned text_hits;		//!< Texts found in the target cache
+	uint64_t text_saved;	//!< Text bytes not sent due to cache hits
+	unsigned updates;		//!< Location updates sent to other PEs
+} tm_stats_t;
+
 /**
  * @brief Initializes the task migration structures
  */
@@ -160,12 +259,17 @@ bool tm_empty();
 /**
  * @brief Migrates the code section of the task
  * 
+ * @details When the text is identified, only its hash is sent and the target
+ * answers if it has the text in its cache. The migration then continues with
+ * tm_start when the answer is received.
+ * 
  * @param tcb Pointer to the TCB
  * @param id ID of the TCB
  * @param addr Address of the TCB
  * 
  * @return
  *  0 on success
+ *  1 if waiting the target answer
  * -ENOMEM when unable to allocate memory for the migration packet
  */
 int tm_send_text(tcb_t *tcb, int id, int addr);
@@ -173,31 +277,99 @@ int tm_send_text(tcb_t *tcb, int id, int addr);
 /**
  * @brief Handles the code received from migration
  * 
+ * @details Also handles the probe of the target cache and its answer.
+ * 
  * @param packet Pointer to received packet
  * 
  * @return
- *  Text size on success
+ *  0 on success
+ *  1 if the scheduler should be called
  * -ENOMEM when unable to allocate memory for TCB
+ * -EINVAL when the task is not found
  */
 int tm_recv_text(tm_text_t *packet);
 
+/**
+ * @brief Continues a migration after the text is in the target
+ * 
+ * @details Starts the pre-copy or migrates the task if it can stop now.
+ * Otherwise, the task is migrated when it becomes ready.
+ * 
+ * @param tcb Pointer to the TCB
+ * 
+ * @return
+ *  0 if the task keeps running
+ *  1 if migrated
+ * -ENOMEM when unable to allocate memory
+ */
+int tm_start(tcb_t *tcb);
+
 /**
  * @brief Migrates a task dynamic memory
  * 
+ * @details All packets are queued in the DMNI and the task is detached. The
+ * TCB and page are released when the last packet leaves, so the migration is
+ * streamed while the other tasks run.
+ * 
+ * Every step that allocates runs before the task state is released. On
+ * failure the target drops the partial task and the task keeps running here.
+ * 
  * @param tcb Pointer to the TCB
  * 
  * @return 
+ *  1 if migrated
+ * -ENOMEM if not enough memory, the task is not migrated
  */
 int tm_migrate(tcb_t *tcb);
 
+/**
+ * @brief Starts streaming the data section of a task that keeps running
+ * 
+ * @details The data, bss and heap are sent in blocks from a kernel copy of
+ * the section. Rounds resend the blocks that differ from their copy until few
+ * blocks are written per round, then the task is migrated and only the blocks
+ * changed since their last copy are sent while it is stopped.
+ * 
+ * @param tcb Pointer to the TCB, with the text already sent
+ * 
+ * @return int
+ *  0 if the pre-copy started
+ * -ENOSPC if disabled or the data section is too small to be worth it
+ * -ENOMEM if not enough memory
+ */
+int tm_precopy(tcb_t *tcb);
+
+/**
+ * @brief Checks if a migrating task can be stopped and migrated now
+ * 
+ * @details Paths that migrate a task when it becomes ready to stop must wait
+ * for the text answer of the target and for the pre-copy, which migrates the
+ * task by itself.
+ * 
+ * @param tcb Pointer to the TCB
+ * 
+ * @return True if the text is in the target and no pre-copy round is running
+ */
+bool tm_can_stop(tcb_t *tcb);
+
+/**
+ * @brief Gets the outbound migration counters
+ * 
+ * @return const tm_stats_t* Pointer to the counters
+ */
+const tm_stats_t *tm_get_stats();
+
 /**
  * @brief Handles the data, bss and heap received from migration
  * 
+ * @details The section can arrive in several parts. Each one updates the
+ * section sizes.
+ * 
  * @param packet Pointer to received packet
  * 
  * @return
  *  Data+BSS+Heap size on success
- * -EINVAL when the task is not found
+ * -EINVAL when the task is not found or the part is malformed
  */
 int tm_recv_data(tm_data_t *packet);
 
@@ -208,7 +380,7 @@ int tm_recv_data(tm_data_t *packet);
  * 
  * @return
  *  Stack size on success
- * -EINVAL when the task is not found
+ * -EINVAL when the task is not found or the stack is malformed
  */
 int tm_recv_stack(tm_stack_t *packet);
 
@@ -248,12 +420,33 @@ int tm_recv_opipe(tm_opipe_t *packet);
  */
 int tm_recv_tl(tm_tl_t *packet);
 
+/**
+ * @brief Handles a location update of a migrated task
+ * 
+ * @details Updates the location table of the application and the forwarding
+ * entry of the task, if any, and acknowledges to the source PE. An
+ * acknowledgement retires the forwarding entry when all PEs have answered.
+ * 
+ * @param packet Pointer to the update packet
+ * 
+ * @return
+ *  0 on success
+ * -ENOMEM not enough memory to acknowledge
+ */
+int tm_recv_update(tm_update_t *packet);
+
 /**
  * @brief Handles the TCB received from migration with scheduler info
  * 
+ * @details A cancelled migration removes the task created by the text packet.
+ * A task whose data or stack did not arrive whole is aborted.
+ * 
  * @param packet Pointer to received packet
  *
  * @return
- * 
+ *  1 if the task was allocated
+ *  0 if the migration was cancelled or the task aborted
+ * -EINVAL if the task is not found
+ * -ENOMEM if not enough memory
  */
 int tm_recv_tcb(tm_tcb_t *packet);
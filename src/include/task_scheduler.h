@@ -31,6 +31,10 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
+
+#include "pqueue.h"
+#include "timer.h"
 
 /* Forward declaration */
 typedef struct _tcb tcb_t;
@@ -66,22 +70,31 @@ typedef struct _sched {
 	unsigned exec_time;			//!< Task execution time in clock cycles
 	unsigned period;			//!< Task period in clock cycles
 	int		 deadline;			//!< Task deadline in clock cycles, for BE task is set to -1
-	unsigned last_monitored;	//!< Last tick that the RT task was monitored
+	uint64_t last_monitored;	//!< Last tick that the RT task was monitored
 
-	unsigned ready_time;			//!< Time in clock cycles that task becomes ready
+	uint64_t ready_time;			//!< Time in clock cycles that task becomes ready
 	int		 remaining_exec_time;	//!< Task remaining execution time in clock cycles
 	unsigned slack_time;			//!< Task slack time in clock cycles
-	unsigned running_start_time;	//!< Task running start time in clock cycles
+	uint64_t running_start_time;	//!< Task running start time in clock cycles
 	unsigned utilization;			//!< Task CPU utilization in percentage
 
 	sched_status_t status;		//!< Task scheduling status
 	sched_wait_t waiting_msg;	//!< Signals when task is waiting a message from a producer task
+
+	pqueue_node_t ready_node;	//!< RT ready queue node, ordered by latest start time
+	timer_evt_t release_evt;	//!< RT end of period event
+	struct _sched *next;		//!< Next BE task in the round-robin ring, NULL if not ready
+	struct _sched *prev;		//!< Previous BE task in the round-robin ring, NULL if not ready
 } sched_t;
 
 /**
  * @brief Initializes the scheduler for the first time.
+ * 
+ * @return int
+ *  0 success
+ * -ENOMEM: impossible to allocate memory
  */
-void sched_init();
+int sched_init();
 
 /**
  * @brief Creates and inserts a scheduler into list
@@ -249,10 +262,8 @@ void sched_report_interruption();
 void sched_report(int id);
 
 /**
- * @brief Gets if the scheduler is enabled
+ * @brief Gets the number of RT jobs that missed their period
  * 
- * @details The scheduler is disabled when a single task is running
- * 
- * @return bool True if scheduler is enabled
-*/
-bool sched_enabled();
+ * @return unsigned Number of misses since boot
+ */
+unsigned sched_get_deadline_misses();
@@ -0,0 +1,89 @@
+/**
+ * MAestro
+ * @file text_cache.h
+ *
+ * @author Angelo Elias Dalzotto (angelo.dalzotto@edu.pucrs.br)
+ * GAPH - Hardware Design Support Group (https://corfu.pucrs.br/)
+ * PUCRS - Pontifical Catholic University of Rio Grande do Sul (http://pucrs.br/)
+ *
+ * @date October 2026
+ *
+ * @brief Per-PE cache of task binaries (.text) identified by content.
+ *
+ * @details Every task text is registered with a hash of its content and is
+ * found in the page of the task while it runs. When the last task holding a
+ * text leaves the PE, a kernel copy is kept while it fits TCACHE_BUDGET, the
+ * least recently used copies being dropped first.
+ */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifndef TCACHE_BUDGET
+	#define TCACHE_BUDGET 16384	//!< Bytes of text kept after their tasks leave the PE
+#endif
+
+/**
+ * @brief Text cache entry
+ */
+typedef struct _tcache_entry {
+	uint64_t hash;		//!< Content hash
+	size_t size;		//!< Text size in bytes, aligned
+	const void *text;	//!< Text in the owner page or in the kernel copy
+	void *owner;		//!< Task holding the text, NULL for a kernel copy
+} tcache_entry_t;
+
+/**
+ * @brief Initializes the text cache
+ */
+void tcache_init();
+
+/**
+ * @brief Computes the hash identifying a text
+ *
+ * @details 64-bit FNV-1a over the words of the text. Never 0.
+ *
+ * @param text Pointer to the text
+ * @param size Size of the text in bytes, aligned
+ *
+ * @return uint64_t Hash
+ */
+uint64_t tcache_hash(const void *text, size_t size);
+
+/**
+ * @brief Registers the text of a task
+ *
+ * @param owner Pointer to the task holding the text
+ * @param hash Content hash
+ * @param text Pointer to the text (kernel address)
+ * @param size Size of the text in bytes, aligned
+ *
+ * @return int
+ *  0 on success
+ * -ENOMEM if not enough memory
+ */
+int tcache_add(void *owner, uint64_t hash, const void *text, size_t size);
+
+/**
+ * @brief Unregisters the text of a task leaving the PE
+ *
+ * @details Must be called while the text is still in the task page, so it
+ * can be copied if no other task holds it.
+ *
+ * @param owner Pointer to the task
+ */
+void tcache_remove(void *owner);
+
+/**
+ * @brief Copies a cached text
+ *
+ * @param hash Content hash
+ * @param size Size of the text in bytes, aligned
+ * @param dst Pointer to the destination (kernel address)
+ *
+ * @return True if found and copied
+ */
+bool tcache_load(uint64_t hash, size_t size, void *dst);
@@ -0,0 +1,129 @@
+/**
+ * MAestro
+ * @file timer.h
+ *
+ * @author Angelo Elias Dalzotto (angelo.dalzotto@edu.pucrs.br)
+ * GAPH - Hardware Design Support Group (https://corfu.pucrs.br/)
+ * PUCRS - Pontifical Catholic University of Rio Grande do Sul (http://pucrs.br/)
+ *
+ * @date October 2026
+ *
+ * @brief Per-PE timer event queue.
+ *
+ * @details Events are kept ordered by expiration time, so only the expired
+ * events are touched and the RTC compare register is programmed straight from
+ * the queue head. All times are 64-bit, so they do not wrap around.
+ * The timer interrupt is disabled while there is no event nor slice to wait
+ * for, and events close to each other are served by a single interrupt.
+ */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pqueue.h"
+
+/**
+ * @brief Timer event
+ */
+typedef struct _timer_evt {
+	pqueue_node_t node;			//!< Event queue node, ordered by expiration time
+	void (*handler)(void *arg);	//!< Function called when the event expires
+	void *arg;					//!< Argument passed to the handler
+} timer_evt_t;
+
+/**
+ * @brief Reads the 64-bit RTC
+ *
+ * @details The upper word is read again to detect a carry from the lower word
+ * between the reads.
+ *
+ * @return uint64_t Current time in clock cycles
+ */
+uint64_t timer_get_time();
+
+/**
+ * @brief Initializes the timer event queue
+ *
+ * @return int
+ *  0 success
+ * -ENOMEM: impossible to allocate memory
+ */
+int timer_init();
+
+/**
+ * @brief Initializes a timer event
+ *
+ * @param evt Pointer to the event
+ * @param handler Function called when the event expires
+ * @param arg Argument passed to the handler
+ */
+void timer_evt_init(timer_evt_t *evt, void (*handler)(void *arg), void *arg);
+
+/**
+ * @brief Sets the expiration time of an event
+ *
+ * @details Inserts the event in the queue or moves it if already set
+ *
+ * @param evt Pointer to the event
+ * @param time Expiration time in clock cycles
+ *
+ * @return int
+ *  0 success
+ * -ENOMEM: event queue is full
+ */
+int timer_set(timer_evt_t *evt, uint64_t time);
+
+/**
+ * @brief Removes an event from the queue
+ *
+ * @details Does nothing if the event is not set
+ *
+ * @param evt Pointer to the event
+ */
+void timer_cancel(timer_evt_t *evt);
+
+/**
+ * @brief Checks if an event is set
+ *
+ * @param evt Pointer to the event
+ *
+ * @return True if set
+ */
+bool timer_is_set(timer_evt_t *evt);
+
+/**
+ * @brief Calls the handler of all events expired until a given time
+ *
+ * @details Each event is removed from the queue before its handler is called,
+ * so the handler is free to set it again.
+ *
+ * @param time Current time in clock cycles
+ */
+void timer_expire(uint64_t time);
+
+/**
+ * @brief Programs the timer interrupt
+ *
+ * @details The interrupt is set to the end of the slice or to the next event
+ * expiration, whichever comes first.
+ *
+ * @param slice Maximum time until the interrupt in clock cycles
+ */
+void timer_program(unsigned slice);
+
+/**
+ * @brief Programs the timer interrupt without a time slice
+ *
+ * @details The interrupt is set to the next event expiration. If there are no
+ * events, the timer interrupt is disabled.
+ */
+void timer_program_tickless();
+
+/**
+ * @brief Checks if the programmed timer interrupt time has passed
+ *
+ * @return True if expired
+ */
+bool timer_expired();
@@ -0,0 +1,102 @@
+/**
+ * MAestro
+ * @file trace.h
+ *
+ * @author Angelo Elias Dalzotto (angelo.dalzotto@edu.pucrs.br)
+ * GAPH - Hardware Design Support Group (https://corfu.pucrs.br/)
+ * PUCRS - Pontifical Catholic University of Rio Grande do Sul (http://pucrs.br/)
+ *
+ * @date October 2026
+ *
+ * @brief Binary event trace and compile-time print levels.
+ *
+ * @details Events are stored as fixed-size timestamped records in a ring, so
+ * hot paths do not spin on the debug console. The ring is drained through
+ * MMR_DBG_TRACE when it fills up and when the PE goes idle. The register is
+ * not implemented by every platform, so the ring is only compiled in with
+ * TRACE_ENABLE. Text prints are kept behind levels, so release builds can
+ * strip them.
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+
+#define TRACE_LVL_NONE	0	//!< No text prints
+#define TRACE_LVL_ERROR	1	//!< Only errors
+#define TRACE_LVL_INFO	2	//!< Task lifetime messages
+#define TRACE_LVL_DEBUG	3	//!< Per-packet messages
+
+#ifndef TRACE_PRINT_LEVEL
+	#define TRACE_PRINT_LEVEL TRACE_LVL_DEBUG	//!< Text prints compiled in
+#endif
+
+#ifndef TRACE_ENABLE
+	#define TRACE_ENABLE 0		//!< Records events in the trace ring. Needs a platform that implements MMR_DBG_TRACE.
+#endif
+
+#ifndef TRACE_RING_SZ
+	#define TRACE_RING_SZ 128	//!< Number of records in the trace ring
+#endif
+
+#define kerror(...)	do { if (TRACE_PRINT_LEVEL >= TRACE_LVL_ERROR) printf(__VA_ARGS__); } while (0)
+#define kinfo(...)	do { if (TRACE_PRINT_LEVEL >= TRACE_LVL_INFO)  printf(__VA_ARGS__); } while (0)
+#define kdebug(...)	do { if (TRACE_PRINT_LEVEL >= TRACE_LVL_DEBUG) printf(__VA_ARGS__); } while (0)
+
+/**
+ * @brief Traced events
+ */
+typedef enum _trace_evt {
+	TRACE_TASK_ALLOCATED,	//!< {offset, region size}
+	TRACE_TASK_REFUSED,		//!< {error, -}
+	TRACE_TASK_RELEASED,	//!< {-, -}
+	TRACE_TM_ORDER,			//!< {target, -}
+	TRACE_TM_TEXT_SENT,		//!< {target, size}, size 0 for a probe
+	TRACE_TM_TEXT_RECV,		//!< {size, cache hit}
+	TRACE_TM_PRECOPY,		//!< {target, size}
+	TRACE_TM_CONVERGED,		//!< {rounds, -}
+	TRACE_TM_DATA_SENT,		//!< {offset, encoded size}
+	TRACE_TM_DATA_RECV,		//!< {offset, encoded size}
+	TRACE_TM_STACK_SENT,	//!< {size, encoded size}
+	TRACE_TM_STACK_RECV,	//!< {size, encoded size}
+	TRACE_TM_HDSHK_SENT,	//!< {target, size}
+	TRACE_TM_HDSHK_RECV,	//!< {size, -}
+	TRACE_TM_PIPE_SENT,		//!< {target, size}
+	TRACE_TM_PIPE_RECV,		//!< {size, -}
+	TRACE_TM_TL_SENT,		//!< {target, task count}
+	TRACE_TM_TL_RECV,		//!< {task count, -}
+	TRACE_TM_TCB_SENT,		//!< {target, -}
+	TRACE_TM_TCB_RECV,		//!< {source, -}
+	TRACE_TM_MIGRATED,		//!< {target, -}
+	TRACE_TM_STREAMED,		//!< {cycles, RT misses}
+	TRACE_TM_RETIRED,		//!< {-, -}
+	TRACE_TM_CANCELLED		//!< {peer, error}
+} trace_evt_t;
+
+/**
+ * @brief Trace record, written to MMR_DBG_TRACE as 4 words
+ *
+ * @details Words: time, (task << 16) | evt, arg[0], arg[1]
+ */
+typedef struct _trace_rec {
+	uint32_t time;		//!< Lower word of the RTC
+	uint16_t evt;		//!< trace_evt_t
+	uint16_t task;		//!< Task ID, 0xFFFF if not related to a task
+	uint32_t arg[2];	//!< Event arguments
+} trace_rec_t;
+
+/**
+ * @brief Records an event
+ *
+ * @param evt Event
+ * @param task Task ID, -1 if not related to a task
+ * @param arg0 First argument
+ * @param arg1 Second argument
+ */
+void trace(trace_evt_t evt, int task, uint32_t arg0, uint32_t arg1);
+
+/**
+ * @brief Writes all records to the debug MMR and empties the ring
+ */
+void trace_drain();
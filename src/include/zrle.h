@@ -0,0 +1,47 @@
+/**
+ * MAestro
+ * @file zrle.h
+ *
+ * @author Angelo Elias Dalzotto (angelo.dalzotto@edu.pucrs.br)
+ * GAPH - Hardware Design Support Group (https://corfu.pucrs.br/)
+ * PUCRS - Pontifical Catholic University of Rio Grande do Sul (http://pucrs.br/)
+ *
+ * @date October 2026
+ *
+ * @brief Zero-run encoding of memory images.
+ *
+ * @details The image is handled in 32-bit words, the flit size. Each group
+ * starts with a header word {zeros, literals}: a run of zero words, not sent,
+ * followed by the literal words that come after the header. Stacks, bss and
+ * fresh heaps are mostly zeros and shrink to a few headers.
+ */
+
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * @brief Encodes an image
+ *
+ * @param src Pointer to the image
+ * @param size Size of the image in bytes, multiple of 4
+ * @param dst Pointer to the encoded buffer
+ * @param max Size of the encoded buffer in bytes
+ *
+ * @return size_t Encoded size in bytes, 0 if it does not fit max
+ */
+size_t zrle_encode(const void *src, size_t size, void *dst, size_t max);
+
+/**
+ * @brief Decodes an image
+ *
+ * @param src Pointer to the encoded buffer
+ * @param enc_size Encoded size in bytes
+ * @param dst Pointer to the image
+ * @param size Size of the image in bytes
+ *
+ * @return int
+ *  Decoded size in bytes on success
+ * -EINVAL if the encoded buffer overflows the image
+ */
+int zrle_decode(const void *src, size_t enc_size, void *dst, size_t size);
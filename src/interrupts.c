@@ -28,6 +28,9 @@
 #include <llm.h>
 #include <task_allocation.h>
 #include <mpipe.h>
+#include <pool.h>
+#include <trace.h>
+#include <perf.h>
 
 /** 
  * @brief Handles the packet coming from the NoC.
@@ -42,69 +45,58 @@ bool _isr_handle_pkt(uint8_t service, void* packet);
 tcb_t *isr_dispatcher(unsigned status)
 {
 	// printf("ISR called\n");
+	uint64_t entry = perf_cycles();
+	perf_irq_t cause = PERF_IRQ_OTHER;
+
 	sched_report_interruption();
 
 	if (sched_is_idle())
 		sched_update_slack_time();
 
+	/* Start the next queued packet if the DMNI finished the last one */
+	dmni_drain();
+
 	bool call_scheduler = false;
 	/* Check interrupt source */
 	if ((status & (1 << RISCV_IRQ_MEI)) && (MMR_DMNI_IRQ_IP & (1 << DMNI_IP_BRLITE))) {
 		// puts("BR");
+		cause = PERF_IRQ_BRLITE;
 		bcast_t bcast_packet;
 		bcast_read(&bcast_packet);
 		call_scheduler |= rpc_bcast_dispatcher(&bcast_packet);
 	} else if ((status & (1 << RISCV_IRQ_MEI)) && (MMR_DMNI_IRQ_IP & (1 << DMNI_IP_HERMES))) {
 		// puts("NOC");
+		cause = PERF_IRQ_HERMES;
+
+		/* The payload of a background receive comes before the next header */
+		dmni_recv_wait();
 
 		uint32_t head = MMR_DMNI_HERMES_HEAD;
 		uint8_t service = (head >> 16) & 0xFF;
+		perf_packet(service);
 		
 		void *packet = hermes_recv_pkt(service);
 		if (packet == NULL) {
-			printf("ERROR: Invalid packet handling %lx\n", head);
+			kerror("ERROR: Invalid packet handling %lx\n", head);
 			MMR_DBG_HALT = 1;
 			return NULL;
 		}
 
-		if(
-			(MMR_DMNI_IRQ_STATUS & (1 << DMNI_STATUS_SEND_ACTIVE)) && 
-			(service == DATA_AV || service == MESSAGE_REQUEST)
-		) {
-			if (msg_pndg_push_back(packet) == NULL) {
-				printf("ERROR: Invalid pndg insertion.\n");
-				free(packet);
-				return NULL;
-			}
-		} else {
-			int ret = _isr_handle_pkt(service, packet);
-			if (ret < 0) {
-				printf("ERROR: handle packet returned %d\n", ret);
-			}
-			call_scheduler = (ret == 1);
-			free(packet);
+		/* Handshakes only queue their answers, so they are not deferred while sending */
+		int ret = _isr_handle_pkt(service, packet);
+		if (ret < 0) {
+			kerror("ERROR: handle packet returned %d\n", ret);
 		}
-	} else if ((status & (1 << RISCV_IRQ_MEI)) && (MMR_DMNI_IRQ_IP & (1 << DMNI_IP_PENDING))) {
-		// puts("PEND");
-		/* Pending packet. Handle it */
-
-		msg_hdshk_t *packet = msg_pndg_pop_front();
-
-		if (packet == NULL) {
-			puts("FATAL: Pending interrupt but no packet.");
-			while(1);
-		}
-
-		call_scheduler = _isr_handle_pkt(packet->hermes.service, packet);
-
-		free(packet);
+		call_scheduler = (ret == 1);
+		pool_free(packet);
 	} else if ((status & (1 << RISCV_IRQ_MTI))) {
 		// printf("Sched %u\n", MMR_RTC_MTIME);
+		cause = PERF_IRQ_TIMER;
 
 		tcb_t *current = sched_get_current_tcb();
 
 		if(current != NULL && tcb_check_stack(current)){
-			printf(
+			kerror(
 				"Task id %d aborted due to stack overflow\n", 
 				tcb_get_id(current)
 			);
@@ -114,6 +106,9 @@ tcb_t *isr_dispatcher(unsigned status)
 	} 
 	
 	if ((status & (1 << RISCV_IRQ_MEI)) && (MMR_DMNI_IRQ_IP & (1 << DMNI_IP_MONITOR))) {
+		if (cause == PERF_IRQ_OTHER)
+			cause = PERF_IRQ_MONITOR;
+
 		int id = mpipe_owner();
 		if (id != -1) {
 			tcb_t *monitor = tcb_find(id);
@@ -144,6 +139,12 @@ tcb_t *isr_dispatcher(unsigned status)
 		}
 	}
 	
+	/* Nothing to run: a good time to empty the trace ring */
+	if (current == NULL)
+		trace_drain();
+
+	perf_isr(cause, perf_cycles() - entry);
+
 	// printf("Scheduled %p\n", current);
     /* Runs the scheduled task */
     return current;
@@ -20,6 +20,7 @@
 #include <task_control.h>
 #include <message.h>
 #include <task_migration.h>
+#include <pool.h>
 
 #include <memphis.h>
 #include <memphis/services.h>
@@ -70,7 +71,7 @@ void kpipe_remove(opipe_t *pending)
 	if(entry != NULL)
 		list_remove(&_kpipe, entry);
 
-	free(pending);
+	pool_free(pending);
 }
 
 bool _kpipe_find_fnc(void *data, void *cmpval)
@@ -131,7 +132,7 @@ int kpipe_add(void *buf, size_t size, int receiver, int target)
 
 int _kpipe_emplace_back(void *buf, size_t size, int receiver)
 {
-	opipe_t *opipe = malloc(sizeof(opipe_t));
+	opipe_t *opipe = pool_alloc(sizeof(opipe_t));
 
 	if(opipe == NULL)
 		return -ENOMEM;
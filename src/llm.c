@@ -20,6 +20,7 @@
 #include <broadcast.h>
 #include <kernel_pipe.h>
 #include <mpipe.h>
+#include <timer.h>
 
 #include <memphis.h>
 #include <memphis/monitor.h>
@@ -55,9 +56,9 @@ bool llm_has_monitor(int mon_id)
 	return (_observers[mon_id].addr != -1);
 }
 
-void llm_rt(unsigned *last_monitored, int id, unsigned slack_time, unsigned remaining_exec_time)
+void llm_rt(uint64_t *last_monitored, int id, unsigned slack_time, unsigned remaining_exec_time)
 {
-	unsigned now = MMR_RTC_MTIME;
+	uint64_t now = timer_get_time();
 
 	if (now - (*last_monitored) < MON_INTERVAL_QOS)
 		return;
@@ -18,27 +18,49 @@
 #include <application.h>
 #include <task_control.h>
 #include <task_scheduler.h>
+#include <timer.h>
+#include <dmni.h>
+#include <pool.h>
 #include <kernel_pipe.h>
 #include <mpipe.h>
 #include <message.h>
 #include <task_migration.h>
+#include <text_cache.h>
 #include <llm.h>
 
 int main()
 {
 	printf("Initializing PE %x\n", MMR_DMNI_INF_ADDRESS);
 
+	if (pool_init() != 0) {
+		puts("FATAL: could not allocate object pools");
+		while(true);
+	}
+
 	page_init();
 	app_init();
-	tcb_init();
-	sched_init();
+	if (tcb_init() != 0) {
+		puts("FATAL: could not allocate TCB table");
+		while(true);
+	}
+	if (timer_init() != 0) {
+		puts("FATAL: could not allocate timer queue");
+		while(true);
+	}
+	dmni_init();
+
+	if (sched_init() != 0) {
+		puts("FATAL: could not allocate scheduler queues");
+		while(true);
+	}
 	kpipe_init();
-	msg_pndg_init();
+	msg_init();
 	tm_init();
+	tcache_init();
 	llm_init();
 	mpipe_init();
 
-	MMR_DMNI_IRQ_IE = ((1 << DMNI_IE_PENDING) | (1 << DMNI_IE_BRLITE) | (1 << DMNI_IE_HERMES));
+	MMR_DMNI_IRQ_IE = ((1 << DMNI_IE_BRLITE) | (1 << DMNI_IE_HERMES));
 	MMR_PLIC_IE     = (1 << PLIC_IE_DMNI);
 
 	return 0;
@@ -25,13 +25,15 @@
 #include <rpc.h>
 #include <llm.h>
 #include <task_migration.h>
+#include <timer.h>
+#include <pool.h>
 
 #include <memphis.h>
 #include <memphis/services.h>
 #include <memphis/monitor.h>
 #include <memphis/messaging.h>
 
-list_t _msg_pndg;
+list_t _msg_borrowed;	//!< Producers with a message lent to a local consumer
 
 /**
  * @brief Forwards a DATA_AV/MESSAGE_REQUEST in case of migration
@@ -46,6 +48,18 @@ list_t _msg_pndg;
  */
 int _msg_forward_hdshk(msg_hdshk_t *hdshk, uint16_t task);
 
+/**
+ * @brief Forwards a MESSAGE_DELIVERY to a consumer that migrated waiting for it
+ * 
+ * @param dlv Pointer to packet to forward, with the payload still in the DMNI
+ * 
+ * @return int
+ *  0 on success
+ * -EINVAL: task not migrated (payload dropped)
+ * -ENOMEM: could not create outbound packet (payload dropped)
+ */
+int _msg_forward_delivery(msg_dlv_t *dlv);
+
 /**
  * @brief Updates the task location in case of migration
  * 
@@ -56,34 +70,177 @@ int _msg_forward_hdshk(msg_hdshk_t *hdshk, uint16_t task);
  */
 void _msg_update_tl(tcb_t *tcb, uint32_t source, int16_t task, int8_t src_app);
 
-void msg_pndg_init()
+/**
+ * @brief Removes a producer from the borrowed pipes list
+ * 
+ * @param send_tcb Pointer to the producer TCB
+ */
+void _msg_unborrow(tcb_t *send_tcb);
+
+/**
+ * @brief Gets the output pipe a producer has lent
+ * 
+ * @param send_tcb Pointer to the producer TCB
+ * 
+ * @return opipe_t* Pointer to the borrowed pipe, NULL if none
+ */
+opipe_t *_msg_get_borrowed(tcb_t *send_tcb);
+
+/**
+ * @brief Releases a producer blocked on its output pipes after one is freed
+ * 
+ * @details A producer that called exit is terminated when its last pipe is freed
+ * 
+ * @param send_tcb Pointer to the producer TCB
+ * 
+ * @return True if the producer was released or terminated
+ */
+bool _msg_release_producer(tcb_t *send_tcb);
+
+void msg_init()
 {
-    list_init(&_msg_pndg);
+    list_init(&_msg_borrowed);
 }
 
-list_entry_t *msg_pndg_push_back(msg_hdshk_t *hdshk)
+int msg_borrow(tcb_t *send_tcb, void *buf, size_t size, int receiver)
 {
-    list_entry_t *entry = list_push_back(&_msg_pndg, hdshk);
-	if (entry == NULL) 
-		return NULL;
+    opipe_t *opipe = tcb_create_opipe(send_tcb);
+    if (opipe == NULL)
+        return -ENOMEM;
+
+    if (list_push_back(&_msg_borrowed, send_tcb) == NULL) {
+        tcb_destroy_opipe(send_tcb, opipe);
+        return -ENOMEM;
+    }
 
-	MMR_DMNI_IRQ_IP |= (1 << DMNI_IP_PENDING);
-	return entry;
+    return opipe_borrow(opipe, buf, size, receiver);
 }
 
-msg_hdshk_t *msg_pndg_pop_front()
+int msg_materialize(tcb_t *send_tcb)
 {
-	msg_hdshk_t *ret = list_pop_front(&_msg_pndg);
+    opipe_t *opipe = _msg_get_borrowed(send_tcb);
+    if (opipe == NULL)
+        return 0;
 
-	if (list_empty(&_msg_pndg))
-		MMR_DMNI_IRQ_IP &= ~(1 << DMNI_IP_PENDING);
-    
-    return ret;
+    if (opipe_materialize(opipe) != 0)
+        return -ENOMEM;
+
+    _msg_unborrow(send_tcb);
+
+    /* The message no longer lives in the producer page */
+    _msg_release_producer(send_tcb);
+
+    return 0;
+}
+
+void msg_materialize_to(int receiver)
+{
+    list_entry_t *entry = list_front(&_msg_borrowed);
+    while (entry != NULL) {
+        list_entry_t *next = list_next(entry);
+        tcb_t *send_tcb = list_get_data(entry);
+
+        if (opipe_get_receiver(_msg_get_borrowed(send_tcb)) == receiver)
+            msg_materialize(send_tcb);
+
+        entry = next;
+    }
+}
+
+void msg_borrow_clear(tcb_t *tcb)
+{
+    _msg_unborrow(tcb);
+    msg_materialize_to(tcb_get_id(tcb));
+}
+
+void msg_opipe_consumed(tcb_t *send_tcb, opipe_t *opipe)
+{
+    if (opipe_is_borrowed(opipe))
+        _msg_unborrow(send_tcb);
+
+    opipe_pop(opipe);
+    tcb_destroy_opipe(send_tcb, opipe);
+
+    _msg_release_producer(send_tcb);
+}
+
+void _msg_unborrow(tcb_t *send_tcb)
+{
+    list_entry_t *entry = list_find(&_msg_borrowed, send_tcb, NULL);
+    if (entry != NULL)
+        list_remove(&_msg_borrowed, entry);
+}
+
+opipe_t *_msg_get_borrowed(tcb_t *send_tcb)
+{
+    opipe_t *opipe;
+    for (unsigned i = 0; (opipe = tcb_get_opipe_at(send_tcb, i)) != NULL; i++) {
+        if (opipe_is_borrowed(opipe))
+            return opipe;
+    }
+
+    return NULL;
+}
+
+bool _msg_release_producer(tcb_t *send_tcb)
+{
+    sched_t *sched = tcb_get_sched(send_tcb);
+    if (!sched_is_waiting_msgreq(sched))
+        return false;
+
+    if (!tcb_has_called_exit(send_tcb)) {
+        sched_release_wait(sched);
+        return true;
+    }
+
+    /* Exited producers wait until all of their messages are consumed */
+    if (tcb_has_opipe(send_tcb))
+        return false;
+
+    sched_release_wait(sched);
+    tcb_terminate(send_tcb);
+    return true;
+}
+
+int msg_rxring_fill(tcb_t *recv_tcb)
+{
+    rxring_t *rxring = tcb_get_rxring(recv_tcb);
+    if (rxring == NULL || tcb_need_migration(recv_tcb))
+        return 0;
+
+    const int receiver = tcb_get_id(recv_tcb);
+    list_t *davs = tcb_get_davs(recv_tcb);
+
+    list_entry_t *entry = list_front(davs);
+    while (entry != NULL && rxring_has_free(rxring)) {
+        list_entry_t *next = list_next(entry);
+        tl_t *dav = list_get_data(entry);
+
+        /* Local producers already skip the NoC */
+        uint32_t source = tl_get_addr(dav);
+        if (source != MMR_DMNI_INF_ADDRESS) {
+            int sender = tl_get_task(dav);
+
+            int ret = msg_send_hdshk(MMR_DMNI_INF_ADDRESS, source, sender, receiver, MESSAGE_REQUEST);
+            if (ret != 0)
+                return ret;
+
+            rxring_post(rxring, sender);
+
+            tl_remove(davs, dav);
+            MMR_DBG_REM_DAV = (sender << 16) | (receiver & 0xFFFF);
+        }
+
+        entry = next;
+    }
+
+    return 0;
 }
 
-bool msg_pndg_empty()
+bool msg_rxring_idle(tcb_t *tcb)
 {
-	return list_empty(&_msg_pndg);
+    rxring_t *rxring = tcb_get_rxring(tcb);
+    return (rxring == NULL || rxring_is_idle(rxring));
 }
 
 int msg_recv_data_av(msg_hdshk_t *hdshk)
@@ -114,6 +271,11 @@ int msg_recv_data_av(msg_hdshk_t *hdshk)
 
     MMR_DBG_ADD_DAV = (hdshk->sender << 16) | (hdshk->receiver & 0xFFFF);
 
+    /* Overlap the request with the consumer computation */
+    msg_rxring_fill(recv_tcb);
+    if (list_empty(davs))
+        return 0;
+
     /* If the consumer task is waiting for a DATA_AV, release it */
     sched_t *sched = tcb_get_sched(recv_tcb);
     if (sched_is_waiting_dav(sched)) {
@@ -162,7 +324,6 @@ int msg_recv_message_request(msg_hdshk_t *hdshk)
     _msg_update_tl(send_tcb, hdshk->source, hdshk->receiver, send_app);
 
     /* Task found. Now search for message. */
-	opipe_t *opipe = tcb_get_opipe(send_tcb);
     int receiver_id = hdshk->receiver;
     if (receiver_id == -1) {
         receiver_id = hdshk->source;
@@ -172,7 +333,8 @@ int msg_recv_message_request(msg_hdshk_t *hdshk)
             receiver_id |= MEMPHIS_KERNEL_MSG;
     }
 
-    if ((opipe == NULL) || (opipe_get_receiver(opipe) != receiver_id)) {
+	opipe_t *opipe = tcb_get_opipe(send_tcb, receiver_id);
+    if (opipe == NULL) {
         /* No message in producer's pipe to the consumer task */
 		/* Insert the message request in the producer's TCB */
 		// printf("Message not found. Inserting message request.\n");
@@ -208,14 +370,13 @@ int msg_recv_message_request(msg_hdshk_t *hdshk)
 			return result;
 
         MMR_DBG_REM_PIPE = (hdshk->sender << 16) | (hdshk->receiver & 0xFFFF);
-		opipe_pop(opipe);
-		tcb_destroy_opipe(send_tcb);
+		msg_opipe_consumed(send_tcb, opipe);
 
 		/* Release consumer task */
 		sched_t *sched = tcb_get_sched(recv_tcb);
 		sched_release_wait(sched);
 
-		if (tcb_need_migration(recv_tcb)) {
+		if (tcb_need_migration(recv_tcb) && tm_can_stop(recv_tcb)) {
 			tm_migrate(recv_tcb);
 			return 1;
 		}
@@ -223,21 +384,20 @@ int msg_recv_message_request(msg_hdshk_t *hdshk)
         return sched_is_idle();
     }
 
+	/* The delivery frees the payload, so it cannot point to the producer page */
+    if (msg_materialize(send_tcb) != 0)
+        return -ENOMEM;
+
 	/* Send through NoC */
     int ret = msg_send_message_delivery(opipe->buf, opipe->size, MMR_DMNI_INF_ADDRESS, hdshk->source, hdshk->sender, hdshk->receiver);
     if (ret < 0)
         return ret;
 
-    tcb_destroy_opipe(send_tcb);
+    tcb_destroy_opipe(send_tcb, opipe);
 
 	/* Release task for execution if it was blocking another send */
-	sched_t *sched = tcb_get_sched(send_tcb);
-	if (sched_is_waiting_msgreq(sched)) {
-		sched_release_wait(sched);
-		if (tcb_has_called_exit(send_tcb))
-			tcb_terminate(send_tcb);
+	if (_msg_release_producer(send_tcb))
         return sched_is_idle();
-	}
 
     return 0;
 }
@@ -255,7 +415,7 @@ int msg_recv_message_delivery(msg_dlv_t *dlv)
 		dmni_recv(rcvmsg, align_size);
 
 		/* Process the message like a syscall triggered from another PE */
-		int ret = rpc_hermes_dispatcher(rcvmsg, dlv->size);
+		int ret = rpc_hermes_dispatcher(rcvmsg, dlv->size, dlv->hdshk.sender);
 
 		free(rcvmsg);
 
@@ -263,14 +423,15 @@ int msg_recv_message_delivery(msg_dlv_t *dlv)
 	}
 
     tcb_t *recv_tcb = tcb_find(dlv->hdshk.receiver);
-    if (recv_tcb == NULL) {
-        /* @todo Create an exception and abort task? */
-        // printf("TASK NOT FOUND\n");
-        return -EINVAL;
-    } 
+    if (recv_tcb == NULL)   /* Consumer migrated while waiting? Forward. */
+        return _msg_forward_delivery(dlv);
+
+    /* Deliveries requested by the inbound ring come before the input pipe */
+    rxring_t *rxring = tcb_get_rxring(recv_tcb);
+    int slot = (rxring != NULL) ? rxring_find_posted(rxring, dlv->hdshk.sender) : -1;
 
     ipipe_t *ipipe = tcb_get_ipipe(recv_tcb);
-    if (ipipe == NULL) {
+    if (slot == -1 && ipipe == NULL) {
         /* @todo Create an exception and abort task? */
         // printf("IPIPE NOT FOUND\n");
 		return -EINVAL;
@@ -279,10 +440,14 @@ int msg_recv_message_delivery(msg_dlv_t *dlv)
     /* Update task location in case of migration */
     _msg_update_tl(recv_tcb, dlv->hdshk.source, dlv->hdshk.sender, recv_app);
 
-    int result = ipipe_receive(ipipe, tcb_get_offset(recv_tcb), dlv->size);
-    if (result != dlv->size) {
-        // printf("Returned %d from ipipe_receive\n", result);
-		dmni_drop_payload(dlv->size - result);
+    if (slot != -1) {
+        rxring_receive(rxring, slot, tcb_get_offset(recv_tcb), dlv->size);
+    } else {
+        int result = ipipe_receive(ipipe, tcb_get_offset(recv_tcb), dlv->size);
+        if (result != dlv->size) {
+            // printf("Returned %d from ipipe_receive\n", result);
+            dmni_drop_payload(dlv->size - result);
+        }
     }
 
     /* @todo Monitor only if message was not redirected from migration */
@@ -299,10 +464,12 @@ int msg_recv_message_delivery(msg_dlv_t *dlv)
         );
     }
 
+    /* A consumer reading from the ring waits for a DATA_AV */
     sched_t *sched = tcb_get_sched(recv_tcb);
-    sched_release_wait(sched);
+    if (slot == -1 || sched_is_waiting_dav(sched))
+        sched_release_wait(sched);
 
-    if (tcb_need_migration(recv_tcb)) {
+    if (tcb_need_migration(recv_tcb) && tm_can_stop(recv_tcb) && msg_rxring_idle(recv_tcb)) {
         tm_migrate(recv_tcb);
         return 1;
     }
@@ -313,7 +480,7 @@ int msg_recv_message_delivery(msg_dlv_t *dlv)
 int msg_send_hdshk(uint32_t source, uint32_t target, uint16_t sender, uint16_t receiver, uint8_t service)
 {
     // printf("* %x->%x %c\n", receiver, sender, (service == MESSAGE_REQUEST) ? 'R' : 'A');
-    msg_hdshk_t *hdshk = malloc(sizeof(msg_hdshk_t));
+    msg_hdshk_t *hdshk = pool_alloc(sizeof(msg_hdshk_t));
     if (hdshk == NULL)
         return -ENOMEM;
 
@@ -330,7 +497,7 @@ int msg_send_hdshk(uint32_t source, uint32_t target, uint16_t sender, uint16_t r
 int msg_send_message_delivery(void *pld, size_t size, uint32_t source, uint32_t target, uint16_t sender, uint16_t receiver)
 {
     // printf("* %x->%x D\n", sender, receiver);
-    msg_dlv_t *dlv = malloc(sizeof(msg_dlv_t));
+    msg_dlv_t *dlv = pool_alloc(sizeof(msg_dlv_t));
     if (dlv == NULL)
         return -ENOMEM;
 
@@ -344,11 +511,8 @@ int msg_send_message_delivery(void *pld, size_t size, uint32_t source, uint32_t
 
 	size_t align_size = (size + 3) & ~3;
 
-    /* Wait for DMNI release before inserting timestamp */
-    while((MMR_DMNI_IRQ_STATUS & (1 << DMNI_STATUS_SEND_ACTIVE)));
-    dlv->timestamp            = MMR_RTC_MTIME;
-
-	return dmni_send(dlv, sizeof(msg_dlv_t), true, pld, align_size, true);
+    /* Timestamp is inserted when the DMNI takes the packet */
+	return dmni_send_stamped(dlv, sizeof(msg_dlv_t), true, pld, align_size, true, &(dlv->timestamp));
 }
 
 int _msg_forward_hdshk(msg_hdshk_t *hdshk, uint16_t task)
@@ -362,6 +526,39 @@ int _msg_forward_hdshk(msg_hdshk_t *hdshk, uint16_t task)
     return msg_send_hdshk(hdshk->source, migrated_addr, hdshk->sender, hdshk->receiver, hdshk->hermes.service);
 }
 
+int _msg_forward_delivery(msg_dlv_t *dlv)
+{
+    size_t align_size = (dlv->size + 3) & ~3;
+
+    tl_t *mig = tm_find(dlv->hdshk.receiver);
+    if (mig == NULL) {
+        dmni_drop_payload(align_size >> 2);
+        return -EINVAL;
+    }
+
+    void *msg = malloc(align_size);
+    if (msg == NULL) {
+        dmni_drop_payload(align_size >> 2);
+        return -ENOMEM;
+    }
+
+    dmni_recv(msg, align_size);
+
+    /* Keeps the producer address, so the consumer updates its location */
+    int ret = msg_send_message_delivery(
+        msg, 
+        dlv->size, 
+        dlv->hdshk.source, 
+        tl_get_addr(mig), 
+        dlv->hdshk.sender, 
+        dlv->hdshk.receiver
+    );
+    if (ret < 0)
+        free(msg);
+
+    return ret;
+}
+
 void _msg_update_tl(tcb_t *tcb, uint32_t source, int16_t task, int8_t src_app)
 {
     int8_t task_app = (task >> 8);
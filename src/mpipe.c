@@ -7,6 +7,7 @@
 #include <mmr.h>
 #include <hermes.h>
 #include <dmni.h>
+#include <pool.h>
 
 #include <memphis/services.h>
 
@@ -85,7 +86,7 @@ int mpipe_write(void *buf, size_t size, int16_t addr)
     if (size % 4 != 0)
         return -EINVAL;
     
-    void *packet = malloc(sizeof(hermes_t) + size);
+    void *packet = pool_alloc(sizeof(hermes_t) + size);
     if (packet == NULL)
         return -ENOMEM;
 
@@ -15,6 +15,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 
 #include "mmr.h"
 #include "dmni.h"
@@ -30,6 +31,7 @@ int opipe_push(opipe_t *opipe, void *msg, size_t size, int receiver)
 
 	opipe->receiver = receiver;
 	opipe->size = size;
+	opipe->borrowed = false;
 	memcpy(opipe->buf, msg, size);
 
 	size_t padding_size = align_size - size;
@@ -40,6 +42,33 @@ int opipe_push(opipe_t *opipe, void *msg, size_t size, int receiver)
 	return size;
 }
 
+int opipe_borrow(opipe_t *opipe, void *msg, size_t size, int receiver)
+{
+	opipe->buf = msg;
+	opipe->size = size;
+	opipe->receiver = receiver;
+	opipe->borrowed = true;
+
+	return size;
+}
+
+int opipe_materialize(opipe_t *opipe)
+{
+	if(!opipe->borrowed)
+		return 0;
+
+	/* opipe_push reads the producer page before replacing buf */
+	if(opipe_push(opipe, opipe->buf, opipe->size, opipe->receiver) < 0)
+		return -ENOMEM;
+
+	return 0;
+}
+
+bool opipe_is_borrowed(opipe_t *opipe)
+{
+	return opipe->borrowed;
+}
+
 void *opipe_get_buf(opipe_t *opipe, size_t *size)
 {
 	if(size != NULL)
@@ -50,8 +79,11 @@ void *opipe_get_buf(opipe_t *opipe, size_t *size)
 
 void opipe_pop(opipe_t *opipe)
 {
-    free(opipe->buf);
+    if(!opipe->borrowed)
+        free(opipe->buf);
+
     opipe->buf = NULL;
+    opipe->borrowed = false;
 }
 
 int opipe_get_receiver(opipe_t *opipe)
@@ -83,6 +115,7 @@ int opipe_receive(opipe_t *opipe, size_t size, int cons_task)
 
 	opipe->receiver = cons_task;
 	opipe->size = size;
+	opipe->borrowed = false;
 
 	dmni_recv(opipe->buf, align_size);
 
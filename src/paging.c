@@ -5,7 +5,7 @@
  * @author Angelo Elias Dal Zotto (angelo.dalzotto@edu.pucrs.br)
  * GAPH - Hardware Design Support Group (https://corfu.pucrs.br/)
  * PUCRS - Pontifical Catholic University of Rio Grande do Sul (https://pucrs.br/)
- * 
+ *
  * @date August 2022
  *
  * @brief MAestro paging control
@@ -13,54 +13,297 @@
 
 #include <paging.h>
 
-#include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 #include <errno.h>
 
+#include <mutils/list.h>
+
 #include <mmr.h>
 
-page_t *_pages = NULL;
+#if PAGE_ORDERS > 32
+	#error "PAGE_ORDERS must fit the order bitmap"
+#endif
+
+list_t _page_free[PAGE_ORDERS];	//!< Free regions of each order. Order 0 is PAGE_MIN_SZ.
+uint32_t _page_orders = 0;		//!< Bit set for each order with a free region
+page_stats_t _page_stats = {0};
+
+/**
+ * @brief Gets the size of an order
+ *
+ * @param order Order of the region
+ *
+ * @return size_t Size in bytes
+ */
+size_t _page_order_size(unsigned order);
+
+/**
+ * @brief Gets the smallest order that fits a size
+ *
+ * @param size Size in bytes
+ *
+ * @return int Order, -1 if larger than the largest order
+ */
+int _page_order(size_t size);
+
+/**
+ * @brief Creates a free region and inserts it in the free list of its order
+ *
+ * @param offset Offset of the region
+ * @param order Order of the region
+ *
+ * @return page_t* Pointer to the page, NULL if not enough memory
+ */
+page_t *_page_emplace_free(void *offset, unsigned order);
+
+/**
+ * @brief Inserts a free region in the list of its order
+ *
+ * @param page Pointer to the page
+ * @param order Order of the region
+ *
+ * @return int
+ *  0 success
+ * -ENOMEM: impossible to allocate memory
+ */
+int _page_push_free(page_t *page, unsigned order);
+
+/**
+ * @brief Removes a free region from the list of its order
+ *
+ * @param order Order of the region
+ * @param entry List entry of the region
+ */
+void _page_take_free(unsigned order, list_entry_t *entry);
+
+/**
+ * @brief Compares a page offset
+ *
+ * @param data Pointer to the page
+ * @param cmpval Offset
+ *
+ * @return True if the page has the offset
+ */
+bool _page_find_fnc(void *data, void *cmpval);
 
 int page_init()
 {
-    /**
-     * @todo
-     * Initialize instruction and data pages
-     */
     const unsigned MAX_TASKS = (MMR_DMNI_INF_MANYCORE_SZ >> 16);
     const unsigned PAGE_SIZE = MMR_DMNI_INF_IMEM_PAGE_SZ;
 
-    _pages = malloc(MAX_TASKS*sizeof(page_t));
+    for (unsigned i = 0; i < PAGE_ORDERS; i++)
+        list_init(&_page_free[i]);
 
-    if (_pages == NULL)
-        return -ENOMEM;
+    /* The kernel is in the first page. The tasks share the remaining memory */
+    unsigned addr = (unsigned)MMR_MEM_BASE + PAGE_SIZE;
+    unsigned end  = (unsigned)MMR_MEM_BASE + PAGE_SIZE * (MAX_TASKS + 1);
+
+    /* Split in the largest aligned regions */
+    while (addr + PAGE_MIN_SZ <= end && (addr & (PAGE_MIN_SZ - 1)) == 0) {
+        unsigned order = PAGE_ORDERS - 1;
+        while (order > 0 && ((addr & (_page_order_size(order) - 1)) != 0 || addr + _page_order_size(order) > end))
+            order--;
 
-    for(int i = 0; i < MAX_TASKS; i++){
-        _pages[i].offset = (void*)(PAGE_SIZE * (i + 1));
-        _pages[i].free = true;
+        if (_page_emplace_free((void*)addr, order) == NULL)
+            return -ENOMEM;
+
+        addr += _page_order_size(order);
+        _page_stats.total += _page_order_size(order);
     }
 
+    _page_stats.free = _page_stats.total;
+
     return 0;
 }
 
-page_t *page_acquire()
+size_t page_fit(size_t image_size)
 {
-    const unsigned MAX_TASKS = (MMR_DMNI_INF_MANYCORE_SZ >> 16);
-    for(int i = 0; i < MAX_TASKS; i++){
-        if(_pages[i].free){
-            _pages[i].free = false;
-            return &(_pages[i]);
+    size_t need = image_size + PAGE_STACK_HEAP_SZ;
+
+    /* Never less than the fixed page tasks were sized for, as the image does not tell the stack and heap use */
+    size_t page = MMR_DMNI_INF_IMEM_PAGE_SZ;
+    if (need < page)
+        need = page;
+
+    size_t size = PAGE_MIN_SZ;
+    while (size < need && size < _page_order_size(PAGE_ORDERS - 1))
+        size <<= 1;
+
+    return size;
+}
+
+page_t *page_acquire(size_t size)
+{
+    int order = _page_order(size);
+    if (order < 0) {
+        _page_stats.failures++;
+        return NULL;
+    }
+
+    /* Smallest order with a free region that fits */
+    uint32_t avail = _page_orders >> order;
+    if (avail == 0) {
+        _page_stats.failures++;
+        return NULL;
+    }
+
+    unsigned from = order + __builtin_ctz(avail);
+
+    page_t *page = list_get_data(list_front(&_page_free[from]));
+    _page_take_free(from, list_front(&_page_free[from]));
+
+    /* Split, keeping the lower half and freeing the upper one */
+    while (from > order) {
+        from--;
+        page_t *buddy = _page_emplace_free(page->offset + _page_order_size(from), from);
+        if (buddy == NULL) {
+            /* No memory to track the buddy: hand the larger region */
+            from++;
+            break;
         }
     }
-    return NULL;
+
+    page->size = _page_order_size(from);
+    page->free = false;
+
+    _page_stats.free -= page->size;
+    _page_stats.regions++;
+
+    return page;
 }
 
 void page_release(page_t *page)
 {
+    _page_stats.free += page->size;
+    _page_stats.regions--;
+
+    int order = _page_order(page->size);
+
+    /* Merge with the buddy while it is free */
+    while (order < PAGE_ORDERS - 1) {
+        void *buddy_offset = (void*)((unsigned)page->offset ^ page->size);
+        list_entry_t *entry = list_find(&_page_free[order], buddy_offset, _page_find_fnc);
+        if (entry == NULL)
+            break;
+
+        page_t *buddy = list_get_data(entry);
+        _page_take_free(order, entry);
+
+        if (buddy->offset < page->offset)
+            page->offset = buddy->offset;
+
+        free(buddy);
+
+        order++;
+        page->size = _page_order_size(order);
+    }
+
     page->free = true;
+
+    if (_page_push_free(page, order) != 0) {
+        /* Region lost until reboot, but never handed twice */
+        _page_stats.total -= page->size;
+        _page_stats.free  -= page->size;
+        free(page);
+    }
 }
 
 void *page_get_offset(page_t *page)
 {
     return page->offset;
 }
+
+size_t page_get_size(page_t *page)
+{
+    return page->size;
+}
+
+size_t page_get_largest()
+{
+    if (_page_orders == 0)
+        return 0;
+
+    return _page_order_size(31 - __builtin_clz(_page_orders));
+}
+
+unsigned page_count_free(size_t size)
+{
+    int order = _page_order(size);
+    if (order < 0)
+        return 0;
+
+    /* Each free region of a higher order splits in 2^(difference) regions */
+    unsigned cnt = 0;
+    uint32_t avail = _page_orders >> order;
+    while (avail != 0) {
+        unsigned i = __builtin_ctz(avail);
+        avail &= (avail - 1);
+        cnt += list_get_size(&_page_free[order + i]) << i;
+    }
+
+    return cnt;
+}
+
+const page_stats_t *page_get_stats()
+{
+    return &_page_stats;
+}
+
+size_t _page_order_size(unsigned order)
+{
+    return ((size_t)PAGE_MIN_SZ) << order;
+}
+
+int _page_order(size_t size)
+{
+    for (unsigned i = 0; i < PAGE_ORDERS; i++) {
+        if (_page_order_size(i) >= size)
+            return i;
+    }
+
+    return -1;
+}
+
+page_t *_page_emplace_free(void *offset, unsigned order)
+{
+    page_t *page = malloc(sizeof(page_t));
+    if (page == NULL)
+        return NULL;
+
+    page->offset = offset;
+    page->size   = _page_order_size(order);
+    page->free   = true;
+
+    if (_page_push_free(page, order) != 0) {
+        free(page);
+        return NULL;
+    }
+
+    return page;
+}
+
+int _page_push_free(page_t *page, unsigned order)
+{
+    if (list_push_back(&_page_free[order], page) == NULL)
+        return -ENOMEM;
+
+    _page_orders |= (1 << order);
+
+    return 0;
+}
+
+void _page_take_free(unsigned order, list_entry_t *entry)
+{
+    list_remove(&_page_free[order], entry);
+
+    if (list_empty(&_page_free[order]))
+        _page_orders &= ~(1 << order);
+}
+
+bool _page_find_fnc(void *data, void *cmpval)
+{
+    page_t *page = (page_t*)data;
+
+    return (page->offset == cmpval);
+}
@@ -0,0 +1,213 @@
+/**
+ * MAestro
+ * @file perf.c
+ *
+ * @author Angelo Elias Dalzotto (angelo.dalzotto@edu.pucrs.br)
+ * GAPH - Hardware Design Support Group (https://corfu.pucrs.br/)
+ * PUCRS - Pontifical Catholic University of Rio Grande do Sul (http://pucrs.br/)
+ *
+ * @date October 2026
+ *
+ * @brief Per-PE kernel performance counters.
+ */
+
+#include <perf.h>
+
+#include <string.h>
+
+#include <mmr.h>
+
+perf_stats_t _perf_stats = {0};
+uint64_t _perf_cycles_base = 0;		//!< Cycle count at the last reset
+uint64_t _perf_instret_base = 0;	//!< Retired instructions at the last reset
+
+/* Written by the HAL at each trap. Nothing left the HAL before the first trap */
+uint32_t hal_prof_ts[HAL_PROF_MAX] = {[HAL_PROF_EXIT_PATH] = HAL_EXIT_MAX};
+
+/**
+ * @brief Reads the 64-bit retired instruction counter
+ *
+ * @return uint64_t Instruction count
+ */
+uint64_t _perf_instret();
+
+/**
+ * @brief Adds a sample to a histogram
+ *
+ * @param hist Pointer to the histogram
+ * @param cycles Sample in cycles
+ */
+void _perf_hist(perf_hist_t *hist, uint32_t cycles);
+
+void *__real_malloc(size_t size);
+
+/**
+ * @brief Counts the kernel heap allocations
+ *
+ * @details The linker redirects the malloc calls here with --wrap=malloc
+ *
+ * @param size Size in bytes
+ *
+ * @return void* Pointer returned by malloc
+ */
+void *__wrap_malloc(size_t size);
+
+uint64_t perf_cycles()
+{
+#ifdef MAESTRO_HOST
+	return mmr_host_cycles();
+#else
+	uint32_t high;
+	uint32_t low;
+	uint32_t check;
+
+	do {
+		__asm__ volatile("rdcycleh %0" : "=r"(high));
+		__asm__ volatile("rdcycle %0" : "=r"(low));
+		__asm__ volatile("rdcycleh %0" : "=r"(check));
+	} while (high != check);
+
+	return (((uint64_t)high) << 32) | low;
+#endif
+}
+
+void perf_isr(perf_irq_t cause, uint32_t cycles)
+{
+	if (!PERF_ENABLE)
+		return;
+
+	_perf_stats.isr[cause].entries++;
+	_perf_stats.isr[cause].cycles += cycles;
+}
+
+void perf_sched(uint32_t cycles)
+{
+	if (!PERF_ENABLE)
+		return;
+
+	_perf_stats.sched_runs++;
+	_perf_stats.sched_cycles += cycles;
+}
+
+void perf_sched_overhead(uint32_t overhead)
+{
+	_perf_stats.sched_overhead = overhead;
+}
+
+void perf_syscall(unsigned number)
+{
+	if (!PERF_ENABLE)
+		return;
+
+	_perf_stats.syscalls[number % PERF_SYSCALL_SLOTS]++;
+}
+
+void perf_packet(uint8_t service)
+{
+	if (!PERF_ENABLE)
+		return;
+
+	_perf_stats.packets[service % PERF_SERVICE_SLOTS]++;
+}
+
+void perf_pool_overflow(bool heap)
+{
+	if (!PERF_ENABLE)
+		return;
+
+	_perf_stats.pool_overflows++;
+	if (heap)
+		_perf_stats.pool_heap++;
+}
+
+void perf_dmni_wait(uint32_t cycles)
+{
+	if (!PERF_ENABLE)
+		return;
+
+	_perf_stats.dmni_waits++;
+	_perf_stats.dmni_wait_cycles += cycles;
+}
+
+void perf_hal()
+{
+	if (!PERF_ENABLE)
+		return;
+
+	/* Counter differences wrap correctly in 32 bits */
+	unsigned entry = hal_prof_ts[HAL_PROF_ENTRY_PATH];
+	if (entry < HAL_ENTRY_MAX)
+		_perf_hist(&_perf_stats.hal_latency[entry], hal_prof_ts[HAL_PROF_DISPATCH] - hal_prof_ts[HAL_PROF_ENTRY]);
+
+	unsigned exit = hal_prof_ts[HAL_PROF_EXIT_PATH];
+	if (exit < HAL_EXIT_MAX)
+		_perf_hist(&_perf_stats.hal_switch[exit], hal_prof_ts[HAL_PROF_LEAVE] - hal_prof_ts[HAL_PROF_EXIT]);
+}
+
+void perf_read(perf_stats_t *dst)
+{
+	_perf_stats.cycles  = perf_cycles() - _perf_cycles_base;
+	_perf_stats.instret = _perf_instret() - _perf_instret_base;
+
+	memcpy(dst, &_perf_stats, sizeof(perf_stats_t));
+}
+
+void perf_reset()
+{
+	/* The overhead is an estimate, not an event count */
+	uint32_t overhead = _perf_stats.sched_overhead;
+
+	memset(&_perf_stats, 0, sizeof(perf_stats_t));
+	_perf_stats.sched_overhead = overhead;
+
+	_perf_cycles_base  = perf_cycles();
+	_perf_instret_base = _perf_instret();
+}
+
+void _perf_hist(perf_hist_t *hist, uint32_t cycles)
+{
+	hist->count++;
+	hist->cycles += cycles;
+	if (cycles > hist->max)
+		hist->max = cycles;
+
+	unsigned bucket = (cycles == 0) ? 0 : (31 - __builtin_clz(cycles));
+	if (bucket >= PERF_HIST_BUCKETS)
+		bucket = PERF_HIST_BUCKETS - 1;
+
+	hist->buckets[bucket]++;
+}
+
+uint64_t _perf_instret()
+{
+#ifdef MAESTRO_HOST
+	/* Not counted by the host */
+	return 0;
+#else
+	uint32_t high;
+	uint32_t low;
+	uint32_t check;
+
+	do {
+		__asm__ volatile("rdinstreth %0" : "=r"(high));
+		__asm__ volatile("rdinstret %0" : "=r"(low));
+		__asm__ volatile("rdinstreth %0" : "=r"(check));
+	} while (high != check);
+
+	return (((uint64_t)high) << 32) | low;
+#endif
+}
+
+void *__wrap_malloc(size_t size)
+{
+	void *ptr = __real_malloc(size);
+
+	if (PERF_ENABLE) {
+		_perf_stats.malloc_calls++;
+		_perf_stats.malloc_bytes += size;
+		if (ptr == NULL)
+			_perf_stats.malloc_failures++;
+	}
+
+	return ptr;
+}
@@ -0,0 +1,111 @@
+/**
+ * MAestro
+ * @file pool.c
+ *
+ * @author Angelo Elias Dalzotto (angelo.dalzotto@edu.pucrs.br)
+ * GAPH - Hardware Design Support Group (https://corfu.pucrs.br/)
+ * PUCRS - Pontifical Catholic University of Rio Grande do Sul (http://pucrs.br/)
+ *
+ * @date October 2026
+ *
+ * @brief Fixed-size object pools for the kernel hot-path allocations.
+ */
+
+#include <pool.h>
+
+#include <stdlib.h>
+#include <errno.h>
+
+#include <mmr.h>
+#include <perf.h>
+
+/**
+ * Size classes, ordered by size. The reserved counts cover:
+ *  16: tl_t, tm_fwd_t, tm_update_t, msg_hdshk_t, opipe_t, ipipe_t
+ *  32: msg_dlv_t and small hermes packets
+ *  64: migration hermes packets
+ * 256: sched_t and the TCB migration packet
+ */
+pool_t _pools[] = {
+	{ .size =  16, .per_task = 16 },
+	{ .size =  32, .per_task =  4 },
+	{ .size =  64, .per_task =  2 },
+	{ .size = 256, .per_task =  2 }
+};
+
+static const size_t POOL_CNT = sizeof(_pools)/sizeof(_pools[0]);
+
+int pool_init()
+{
+	/* One extra slot accounts for the kernel own objects */
+	const unsigned SLOTS = (MMR_DMNI_INF_MANYCORE_SZ >> 16) + 1;
+
+	for (size_t i = 0; i < POOL_CNT; i++) {
+		pool_t *pool = &_pools[i];
+		size_t count = pool->per_task * SLOTS;
+
+		pool->base = malloc(count * pool->size);
+		if (pool->base == NULL)
+			return -ENOMEM;
+
+		pool->end  = pool->base + (count * pool->size);
+		pool->free = NULL;
+
+		/* Thread the free list through the objects */
+		for (size_t n = count; n > 0; n--) {
+			char *obj = pool->base + ((n - 1) * pool->size);
+			*(void**)obj = pool->free;
+			pool->free = obj;
+		}
+	}
+
+	return 0;
+}
+
+void *pool_alloc(size_t size)
+{
+	bool overflow = false;
+	for (size_t i = 0; i < POOL_CNT; i++) {
+		pool_t *pool = &_pools[i];
+
+		if (size > pool->size)
+			continue;
+
+		if (pool->free == NULL) {
+			/* The reserve sized at boot was not enough */
+			overflow = true;
+			continue;
+		}
+
+		if (overflow)
+			perf_pool_overflow(false);
+
+		void *obj = pool->free;
+		pool->free = *(void**)obj;
+		return obj;
+	}
+
+	if (overflow)
+		perf_pool_overflow(true);
+
+	return malloc(size);
+}
+
+void pool_free(void *ptr)
+{
+	if (ptr == NULL)
+		return;
+
+	for (size_t i = 0; i < POOL_CNT; i++) {
+		pool_t *pool = &_pools[i];
+
+		if ((char*)ptr < pool->base || (char*)ptr >= pool->end)
+			continue;
+
+		*(void**)ptr = pool->free;
+		pool->free = ptr;
+		return;
+	}
+
+	free(ptr);
+}
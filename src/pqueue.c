@@ -0,0 +1,218 @@
+/**
+ * MAestro
+ * @file pqueue.c
+ *
+ * @author Angelo Elias Dalzotto (angelo.dalzotto@edu.pucrs.br)
+ * GAPH - Hardware Design Support Group (https://corfu.pucrs.br/)
+ * PUCRS - Pontifical Catholic University of Rio Grande do Sul (http://pucrs.br/)
+ *
+ * @date October 2026
+ *
+ * @brief Intrusive binary min-heap used by the kernel ordered queues.
+ */
+
+#include <pqueue.h>
+
+#include <stdlib.h>
+#include <errno.h>
+
+/**
+ * @brief Compares two keys
+ *
+ * @param a First key
+ * @param b Second key
+ *
+ * @return True if a is before b
+ */
+bool _pqueue_less(uint64_t a, uint64_t b);
+
+/**
+ * @brief Places a node in a heap position
+ *
+ * @param pq Pointer to the priority queue
+ * @param node Pointer to the node
+ * @param index Position in the heap
+ */
+void _pqueue_place(pqueue_t *pq, pqueue_node_t *node, size_t index);
+
+/**
+ * @brief Moves a node towards the root until the heap property holds
+ *
+ * @param pq Pointer to the priority queue
+ * @param index Position of the node
+ */
+void _pqueue_sift_up(pqueue_t *pq, size_t index);
+
+/**
+ * @brief Moves a node towards the leaves until the heap property holds
+ *
+ * @param pq Pointer to the priority queue
+ * @param index Position of the node
+ */
+void _pqueue_sift_down(pqueue_t *pq, size_t index);
+
+/**
+ * @brief Searches a subtree for the highest key up to a limit
+ *
+ * @param pq Pointer to the priority queue
+ * @param index Root of the subtree
+ * @param limit Highest key accepted
+ * @param last Highest key found so far
+ *
+ * @return uint64_t Highest key found
+ */
+uint64_t _pqueue_last_until(pqueue_t *pq, size_t index, uint64_t limit, uint64_t last);
+
+int pqueue_init(pqueue_t *pq, size_t capacity)
+{
+	pq->size = 0;
+	pq->capacity = capacity;
+	pq->heap = malloc(capacity*sizeof(pqueue_node_t*));
+
+	if (pq->heap == NULL)
+		return -ENOMEM;
+
+	return 0;
+}
+
+void pqueue_node_init(pqueue_node_t *node, void *data)
+{
+	node->data = data;
+	node->key = 0;
+	node->index = -1;
+}
+
+bool pqueue_is_queued(pqueue_node_t *node)
+{
+	return (node->index != -1);
+}
+
+int pqueue_push(pqueue_t *pq, pqueue_node_t *node, uint64_t key)
+{
+	if (pq->size == pq->capacity)
+		return -ENOMEM;
+
+	node->key = key;
+	_pqueue_place(pq, node, pq->size++);
+	_pqueue_sift_up(pq, node->index);
+
+	return 0;
+}
+
+void pqueue_remove(pqueue_t *pq, pqueue_node_t *node)
+{
+	if (node->index == -1)
+		return;
+
+	size_t index = node->index;
+	node->index = -1;
+
+	pq->size--;
+	if (index == pq->size)
+		return;
+
+	/* Fill the hole with the last leaf and restore the heap */
+	_pqueue_place(pq, pq->heap[pq->size], index);
+	_pqueue_sift_up(pq, index);
+	_pqueue_sift_down(pq, index);
+}
+
+void pqueue_update(pqueue_t *pq, pqueue_node_t *node, uint64_t key)
+{
+	if (node->index == -1)
+		return;
+
+	node->key = key;
+	_pqueue_sift_up(pq, node->index);
+	_pqueue_sift_down(pq, node->index);
+}
+
+void *pqueue_front(pqueue_t *pq)
+{
+	if (pq->size == 0)
+		return NULL;
+
+	return pq->heap[0]->data;
+}
+
+uint64_t pqueue_front_key(pqueue_t *pq)
+{
+	return pq->heap[0]->key;
+}
+
+uint64_t pqueue_last_key_until(pqueue_t *pq, uint64_t limit)
+{
+	return _pqueue_last_until(pq, 0, limit, pq->heap[0]->key);
+}
+
+bool pqueue_empty(pqueue_t *pq)
+{
+	return (pq->size == 0);
+}
+
+size_t pqueue_size(pqueue_t *pq)
+{
+	return pq->size;
+}
+
+bool _pqueue_less(uint64_t a, uint64_t b)
+{
+	return (a < b);
+}
+
+void _pqueue_place(pqueue_t *pq, pqueue_node_t *node, size_t index)
+{
+	pq->heap[index] = node;
+	node->index = index;
+}
+
+void _pqueue_sift_up(pqueue_t *pq, size_t index)
+{
+	pqueue_node_t *node = pq->heap[index];
+
+	while (index > 0) {
+		size_t parent = (index - 1) >> 1;
+		if (!_pqueue_less(node->key, pq->heap[parent]->key))
+			break;
+
+		_pqueue_place(pq, pq->heap[parent], index);
+		index = parent;
+	}
+
+	_pqueue_place(pq, node, index);
+}
+
+void _pqueue_sift_down(pqueue_t *pq, size_t index)
+{
+	pqueue_node_t *node = pq->heap[index];
+
+	while (true) {
+		size_t child = (index << 1) + 1;
+		if (child >= pq->size)
+			break;
+
+		if (child + 1 < pq->size && _pqueue_less(pq->heap[child + 1]->key, pq->heap[child]->key))
+			child++;
+
+		if (!_pqueue_less(pq->heap[child]->key, node->key))
+			break;
+
+		_pqueue_place(pq, pq->heap[child], index);
+		index = child;
+	}
+
+	_pqueue_place(pq, node, index);
+}
+
+uint64_t _pqueue_last_until(pqueue_t *pq, size_t index, uint64_t limit, uint64_t last)
+{
+	/* Children are never lower than the parent, so the subtree is pruned */
+	if (index >= pq->size || pq->heap[index]->key > limit)
+		return last;
+
+	if (pq->heap[index]->key > last)
+		last = pq->heap[index]->key;
+
+	last = _pqueue_last_until(pq, (index << 1) + 1, limit, last);
+	return _pqueue_last_until(pq, (index << 1) + 2, limit, last);
+}
@@ -21,6 +21,9 @@
 #include <halt.h>
 #include <task_control.h>
 #include <task_migration.h>
+#include <timer.h>
+#include <dmni.h>
+#include <trace.h>
 
 #include <memphis/services.h>
 #include <memphis/messaging.h>
@@ -101,6 +104,25 @@ int _rpc_abort_task(memphis_info_t *packet);
  */
 int _rpc_task_migration(memphis_task_migration_t *packet);
 
+/**
+ * @brief Handles a location update of a migrated task
+ * @details Received by the PEs that hold the location table of the application
+ * and by the source processor, as the acknowledgement. TASK_MIGRATED is also
+ * the service a kernel sends to the mapper, so only kernel messages with the
+ * size of an update are accepted.
+ * 
+ * @param packet Pointer to packet
+ * @param size Size of the message in bytes
+ * @param sender ID of the sender task, -1 if sent by a kernel
+ * 
+ * @return 
+ * 	0 if scheduler should not be called
+ *  1 if the PE halted
+ * -ENOMEM if not enough memory
+ * -EINVAL if not a location update
+ */
+int _rpc_task_migrated(tm_update_t *packet, size_t size, int sender);
+
 int rpc_bcast_dispatcher(bcast_t *packet)
 {
 	// printf("Broadcast received %x\n", packet->service);
@@ -122,10 +144,10 @@ int rpc_bcast_dispatcher(bcast_t *packet)
 			ret = _rpc_halt_pe(id_field, packet->src_addr);
 			break;
 		default:
-			printf(
-				"ERROR: unknown broadcast %x at time %d\n", 
+			kerror(
+				"ERROR: unknown broadcast %x at time %u\n", 
 				packet->service, 
-				MMR_RTC_MTIME
+				(unsigned)timer_get_time()
 			);
 			break;
 	}
@@ -133,7 +155,7 @@ int rpc_bcast_dispatcher(bcast_t *packet)
 	return ret;
 }
 
-int rpc_hermes_dispatcher(void *message, size_t size)
+int rpc_hermes_dispatcher(void *message, size_t size, int sender)
 {
 	uint8_t service = (((uint32_t*)message)[0] >> 16) & 0xFF;
 
@@ -148,8 +170,11 @@ int rpc_hermes_dispatcher(void *message, size_t size)
 		case TASK_MIGRATION:
 			ret = _rpc_task_migration(message);
 			break;
+		case TASK_MIGRATED:
+			ret = _rpc_task_migrated(message, size, sender);
+			break;
 		default:
-			printf(
+			kerror(
 				"ERROR: Unknown service %x inside MESSAGE_DELIVERY\n", 
 				service
 			);
@@ -187,7 +212,7 @@ int _rpc_halt_pe(int task, int addr)
 	/* We can only halt when all resources are released */
 	/* This allow us to check for memory leaks! */
     int ret = halt_set(task, addr);
-	printf("*** Halt requested\n");
+	kinfo("*** Halt requested\n");
 
     if (ret < 0)
         return ret;
@@ -197,7 +222,7 @@ int _rpc_halt_pe(int task, int addr)
 
     halt_clear();
 
-	printf("Halt done!\n");
+	kinfo("Halt done!\n");
 
 	return 0;
 }
@@ -210,7 +235,11 @@ int _rpc_task_release(memphis_info_t *packet, int32_t *payload)
 	if (tcb == NULL)
 		return -EINVAL;
 
-	printf("-> TASK RELEASE received to task %d\n", tcb_get_id(tcb));
+	trace(TRACE_TASK_RELEASED, tcb_get_id(tcb), 0, 0);
+	kdebug("-> TASK RELEASE received to task %d\n", tcb_get_id(tcb));
+
+	/* A local mapper can release the task before its data has landed */
+	dmni_recv_wait();
 
 	/* Write task location */
 	app_t *app = tcb_get_app(tcb);
@@ -240,6 +269,9 @@ int _rpc_abort_task(memphis_info_t *packet)
 	if (tcb == NULL) {
 		/* Task already terminated or migrated from here */
 		tl_t *tl = tm_find(packet->task);
+		if (tl == NULL)
+			return -EINVAL;
+
 		int addr = tl_get_addr(tl);
 		if (addr == -1)
 			return -EINVAL;
@@ -247,7 +279,7 @@ int _rpc_abort_task(memphis_info_t *packet)
 		return 0;
 	}
 
-	printf("Task id %d aborted by application\n", packet->task);
+	kinfo("Task id %d aborted by application\n", packet->task);
 
 	int mig_addr = tcb_get_migrate_addr(tcb);
 	if (mig_addr != -1) {
@@ -265,13 +297,13 @@ int _rpc_task_migration(memphis_task_migration_t *packet)
 	tcb_t *task = tcb_find(packet->task);
 
 	if (task == NULL || tcb_has_called_exit(task)) {
-		printf("Tried to migrate task %x but it already terminated\n", packet->task);
+		kinfo("Tried to migrate task %x but it already terminated\n", packet->task);
 		return 0;
 	}
 
 	int old_addr = tcb_get_migrate_addr(task);
 	if (old_addr != -1) {
-		printf(
+		kerror(
 			"ERROR: task %x PE already assigned to %x when tried to assign %x\n", 
 			packet->task, 
 			old_addr, 
@@ -281,21 +313,38 @@ int _rpc_task_migration(memphis_task_migration_t *packet)
 		return 0;
 	}
 
-	printf("Trying to migrate task %d to address %d\n", packet->task, packet->address);
+	trace(TRACE_TM_ORDER, packet->task, packet->address, 0);
+	kdebug("Trying to migrate task %d to address %d\n", packet->task, packet->address);
 
 	tcb_set_migrate_addr(task, packet->address);
 
 	/* Send constant .text section */
 	int ret = tm_send_text(task, packet->task, packet->address);
-	printf("Text returned %d\n", ret);
-	if (ret != 0)
+	kdebug("Text returned %d\n", ret);
+	if (ret < 0)
 		return ret;
 
-	sched_t *sched = tcb_get_sched(task);
-	if (sched_is_waiting_delivery(sched)) {
-		printf("Task %d is waiting for message delivery, cannot migrate\n", packet->task);
+	/* Continued when the target answers if it has the text */
+	if (ret > 0)
 		return 0;
+
+	return tm_start(task);
+}
+
+int _rpc_task_migrated(tm_update_t *packet, size_t size, int sender)
+{
+	if (size != sizeof(tm_update_t) || (int8_t)(sender >> 8) != -1) {
+		kerror("ERROR: TASK_MIGRATED from %x with size %u is not a location update\n", sender, size);
+		return -EINVAL;
 	}
 
-	return tm_migrate(task);
+	int ret = tm_recv_update(packet);
+	if (ret < 0)
+		return ret;
+
+	/* The last forwarding entry can be retired by an acknowledgement */
+	if (!halt_pndg())
+		return 0;
+
+	return (halt_try() == 0);
 }
@@ -0,0 +1,151 @@
+/**
+ * MAestro
+ * @file rxring.c
+ *
+ * @author Angelo Elias Dalzotto (angelo.dalzotto@edu.pucrs.br)
+ * GAPH - Hardware Design Support Group (https://corfu.pucrs.br/)
+ * PUCRS - Pontifical Catholic University of Rio Grande do Sul (http://pucrs.br/)
+ *
+ * @date October 2026
+ *
+ * @brief Inbound message ring provided by a task.
+ */
+
+#include <rxring.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <dmni.h>
+
+void rxring_init(rxring_t *rxring, void *buf, size_t slot_size, unsigned slots)
+{
+	rxring->buf = buf;
+	rxring->slot_size = slot_size;
+	rxring->slots = slots;
+	rxring->seq = 0;
+	rxring->used = 0;
+
+	for (unsigned i = 0; i < RXRING_MAX_SLOTS; i++) {
+		rxring->slot[i].kbuf = NULL;
+		rxring->slot[i].state = RXSLOT_FREE;
+	}
+}
+
+int rxring_post(rxring_t *rxring, uint16_t sender)
+{
+	for (unsigned i = 0; i < rxring->slots; i++) {
+		rxslot_t *slot = &(rxring->slot[i]);
+		if (slot->state != RXSLOT_FREE)
+			continue;
+
+		slot->state = RXSLOT_POSTED;
+		slot->sender = sender;
+		slot->seq = rxring->seq++;
+		rxring->used++;
+		return i;
+	}
+
+	return -1;
+}
+
+int rxring_find_posted(rxring_t *rxring, uint16_t sender)
+{
+	int found = -1;
+
+	for (unsigned i = 0; i < rxring->slots; i++) {
+		rxslot_t *slot = &(rxring->slot[i]);
+		if (slot->state != RXSLOT_POSTED || slot->sender != sender)
+			continue;
+
+		/* Sequence numbers are compared by difference to survive wrap around */
+		if (found == -1 || (int)(slot->seq - rxring->slot[found].seq) < 0)
+			found = i;
+	}
+
+	return found;
+}
+
+int rxring_receive(rxring_t *rxring, int index, void *offset, size_t size)
+{
+	rxslot_t *slot = &(rxring->slot[index]);
+	size_t align_size = (size + 3) & ~3;
+
+	if (align_size <= rxring->slot_size) {
+		void *real_ptr = (void*)(((unsigned)rxring->buf + index*rxring->slot_size) | (unsigned)offset);
+		dmni_recv(real_ptr, align_size);
+	} else {
+		/* Does not fit the slot: hold it until the task reads it */
+		slot->kbuf = malloc(align_size);
+		if (slot->kbuf == NULL) {
+			dmni_drop_payload(align_size >> 2);
+			slot->state = RXSLOT_FREE;
+			rxring->used--;
+			return -ENOMEM;
+		}
+
+		dmni_recv(slot->kbuf, align_size);
+	}
+
+	slot->size = size;
+	slot->state = RXSLOT_FILLED;
+
+	return size;
+}
+
+int rxring_oldest_filled(rxring_t *rxring)
+{
+	int found = -1;
+
+	for (unsigned i = 0; i < rxring->slots; i++) {
+		rxslot_t *slot = &(rxring->slot[i]);
+		if (slot->state != RXSLOT_FILLED)
+			continue;
+
+		if (found == -1 || (int)(slot->seq - rxring->slot[found].seq) < 0)
+			found = i;
+	}
+
+	return found;
+}
+
+size_t rxring_pop(rxring_t *rxring, int index, void *offset, void *dst, size_t size)
+{
+	rxslot_t *slot = &(rxring->slot[index]);
+
+	if (size < slot->size)
+		return 0;
+
+	if (slot->kbuf != NULL) {
+		memcpy(dst, slot->kbuf, slot->size);
+		free(slot->kbuf);
+		slot->kbuf = NULL;
+	} else {
+		void *real_ptr = (void*)(((unsigned)rxring->buf + index*rxring->slot_size) | (unsigned)offset);
+		memcpy(dst, real_ptr, slot->size);
+	}
+
+	slot->state = RXSLOT_FREE;
+	rxring->used--;
+
+	return slot->size;
+}
+
+bool rxring_has_free(rxring_t *rxring)
+{
+	return (rxring->used < rxring->slots);
+}
+
+bool rxring_is_idle(rxring_t *rxring)
+{
+	return (rxring->used == 0);
+}
+
+void rxring_clear(rxring_t *rxring)
+{
+	for (unsigned i = 0; i < rxring->slots; i++) {
+		free(rxring->slot[i].kbuf);
+		rxring->slot[i].kbuf = NULL;
+	}
+}
@@ -29,6 +29,8 @@
 #include <message.h>
 #include <halt.h>
 #include <mpipe.h>
+#include <timer.h>
+#include <trace.h>
 
 #include <memphis/services.h>
 #include <memphis/messaging.h>
@@ -55,8 +57,13 @@ tcb_t *sys_syscall(
 
 	tcb_t *current = sched_get_current_tcb();
 
+	/* Start the next queued packet if the DMNI finished the last one */
+	dmni_drain();
+
+	perf_syscall(number);
+
 	if (tcb_check_stack(current)) {
-		printf(
+		kerror(
 			"Task id %d aborted due to stack overflow\n", 
 			tcb_get_id(current)
 		);
@@ -76,6 +83,12 @@ tcb_t *sys_syscall(
 			case SYS_gettick:
 				ret = sys_get_tick();
 				break;
+			case SYS_gettick64:
+				ret = sys_get_tick64(current, (uint64_t*)arg1);
+				break;
+			case SYS_setrxring:
+				ret = sys_setrxring(current, (void*)arg1, arg2, arg3);
+				break;
 			case SYS_realtime:
 				ret = sys_realtime(current, arg1, arg2, arg3);
 				break;
@@ -88,6 +101,9 @@ tcb_t *sys_syscall(
 			case SYS_getctx:
 				ret = sys_get_ctx(current, (mctx_t*)arg1);
 				break;
+			case SYS_getperf:
+				ret = sys_get_perf(current, (perf_stats_t*)arg1, arg2);
+				break;
 			case SYS_halt:
 				ret = sys_end_simulation(current);
 				break;
@@ -116,7 +132,7 @@ tcb_t *sys_syscall(
 				ret = sys_mkfifo(current, arg1, arg2);
 				break;
 			default:
-				printf("ERROR: Unknown syscall %d\n", number);
+				kerror("ERROR: Unknown syscall %d\n", number);
 				ret = 0;
 				break;
 		}
@@ -125,13 +141,25 @@ tcb_t *sys_syscall(
 	if (!task_terminated) {
 		// printf("Setting return value %d\n", ret);
 		tcb_set_ret(current, ret);
+
+		/* A blocked task does not read: give back the buffers lent to it */
+		if (sched_get_waiting_msg(tcb_get_sched(current)) != SCHED_WAIT_NO)
+			msg_materialize_to(tcb_get_id(current));
 	}
 
 	/* Return from ecall */
 	tcb_inc_pc(current, 4);
 
+	/* Migration postponed while the inbound ring had messages */
+	if (!task_terminated && tcb_get_rxring(current) != NULL && tcb_need_migration(current) && tm_can_stop(current)) {
+		if (msg_rxring_idle(current)) {
+			tm_migrate(current);
+			schedule_after_syscall = true;
+		}
+	}
+
 	/* Schedule if timer has passed */
-	schedule_after_syscall |= (sched_enabled() && MMR_RTC_MTIMECMP >= MMR_RTC_MTIME);
+	schedule_after_syscall |= timer_expired();
 	if (schedule_after_syscall) {
 		sched_run();
 		// printf("Scheduled %d\n", tcb_get_id(current));
@@ -146,7 +174,7 @@ int sys_exit(tcb_t *tcb, int status)
 {
 	schedule_after_syscall = true;
 
-	if(tcb_get_opipe(tcb) != NULL){
+	if(tcb_has_opipe(tcb)){
 		/* Don't erase task with message in pipe */
 		tcb_set_called_exit(tcb);
 		sched_t *sched = tcb_get_sched(tcb);
@@ -154,7 +182,7 @@ int sys_exit(tcb_t *tcb, int status)
 		return -EAGAIN;
 	}
 
-	printf("Task id %d terminated with status %d\n", tcb_get_id(tcb), status);
+	kinfo("Task id %d terminated with status %d\n", tcb_get_id(tcb), status);
 
 	tcb_terminate(tcb);
 	task_terminated = true;
@@ -203,7 +231,7 @@ int sys_writepipe(tcb_t *tcb, void *buf, size_t size, int receiver, bool sync)
 
 	if ((receiver == -1) && (target == MMR_DMNI_INF_ADDRESS)) {
 		/* Kernel can bypass the message request */
-		schedule_after_syscall = rpc_hermes_dispatcher(buf, size);
+		schedule_after_syscall = rpc_hermes_dispatcher(buf, size, sender);
 		return size;
 	}
 
@@ -211,6 +239,13 @@ int sys_writepipe(tcb_t *tcb, void *buf, size_t size, int receiver, bool sync)
 	list_t *msgreqs = tcb_get_msgreqs(tcb);
 	tl_t   *request = tl_find(msgreqs, receiver != -1 ? receiver : target);
 
+	if ((request != NULL) && (tl_get_addr(request) == MMR_DMNI_INF_ADDRESS) && tcb_find(receiver) == NULL) {
+		/* Consumer migrated while waiting the delivery: redirect its request */
+		tl_t *mig = tm_find(receiver);
+		if (mig != NULL)
+			tl_set(request, receiver, tl_get_addr(mig));
+	}
+
 	if ((request != NULL) && (tl_get_addr(request) == MMR_DMNI_INF_ADDRESS)) {
 		/* Request with local receiver: no need to buffer the transfer */
 		tcb_t *recv_tcb = tcb_find(receiver);
@@ -247,7 +282,7 @@ int sys_writepipe(tcb_t *tcb, void *buf, size_t size, int receiver, bool sync)
 		return size;		
 	}
 
-	if (tcb_get_opipe(tcb) != NULL) {
+	if (tcb_get_opipe_free(tcb) == 0) {
 		/* Pipe full: wait for a message request to release the pipe */
 		// printf("**** pipe is full\n");
 		sched_t *sched = tcb_get_sched(tcb);
@@ -257,13 +292,64 @@ int sys_writepipe(tcb_t *tcb, void *buf, size_t size, int receiver, bool sync)
 		return -EAGAIN;
 	}
 
-	if (request != NULL || (sync && (target != MMR_DMNI_INF_ADDRESS))) {
-		/* Needs to send packet through NoC to complete*/
-		if ((MMR_DMNI_IRQ_STATUS & (1 << DMNI_STATUS_SEND_ACTIVE))) {
-			/* Deadlock avoidance: avoid sending a packet when the DMNI is busy */
+	if (request == NULL && target == MMR_DMNI_INF_ADDRESS) {
+		/* Local consumer: the message is copied only once, straight to its page */
+		tcb_t *recv_tcb = tcb_find(receiver);
+		if (recv_tcb == NULL)
+			return -EINVAL;
+
+		sched_t *recv_sched = tcb_get_sched(recv_tcb);
+		ipipe_t *posted     = tcb_get_ipipe(recv_tcb);
+		if (sync && posted != NULL && sched_is_waiting_dav(recv_sched) && tcb_get_opipe(tcb, receiver) == NULL) {
+			/* Consumer posted its buffer while waiting for the DATA_AV */
+			int result = ipipe_transfer(posted, tcb_get_offset(recv_tcb), buf, size);
+			if (result == size) {
+				sched_release_wait(recv_sched);
+				return size;
+			}
+		}
+
+		/* Lend the producer buffer only when it would block on the next write anyway */
+		bool lend = (tcb_get_opipe_free(tcb) == 1);
+
+		int result;
+		if (lend) {
+			result = msg_borrow(tcb, buf, size, receiver);
+		} else {
+			opipe_t *opipe = tcb_create_opipe(tcb);
+			if (opipe == NULL)
+				return -ENOMEM;
+
+			result = opipe_push(opipe, buf, size, receiver);
+		}
+
+		if (result != size)
+			return -ENOMEM;
+
+		MMR_DBG_ADD_PIPE = ((sender << 16) | (receiver & 0xFFFF));
+
+		if (sync) {
+			/* Insert DATA_AV to the consumer TCB */
+			list_t *davs = tcb_get_davs(recv_tcb);
+			tl_t   *dav  = tl_emplace_back(davs, sender, MMR_DMNI_INF_ADDRESS);
+			if (dav == NULL)
+				return -ENOMEM;
+
+			MMR_DBG_ADD_DAV = (sender << 16) | (receiver & 0xFFFF);
+
+			/* If consumer waiting for a DATA_AV, release the task */
+			if (sched_is_waiting_dav(recv_sched))
+				sched_release_wait(recv_sched);
+		}
+
+		if (lend) {
+			/* The write is complete, but the producer cannot touch its buffer yet */
+			sched_t *sched = tcb_get_sched(tcb);
+			sched_set_wait_msgreq(sched);
 			schedule_after_syscall = true;
-			return -EAGAIN;
 		}
+
+		return result;
 	}
 
 	/* Bufferize the message to transfer through NoC */
@@ -284,36 +370,16 @@ int sys_writepipe(tcb_t *tcb, void *buf, size_t size, int receiver, bool sync)
 		int req_addr = tl_get_addr(request);
 		msg_send_message_delivery(opipe->buf, opipe->size, MMR_DMNI_INF_ADDRESS, req_addr, sender, receiver);
 
-		tcb_destroy_opipe(tcb);
+		tcb_destroy_opipe(tcb, opipe);
 		MMR_DBG_REM_PIPE = ((sender << 16) | (receiver & 0xFFFF));
 		
 		/* Remove the message request from buffer */
 		tl_remove(msgreqs, request);
 		MMR_DBG_REM_REQ = (sender << 16) | (receiver & 0xFFFF);
 	} else if (sync) {
-		if (target == MMR_DMNI_INF_ADDRESS) {
-			/* Insert a DATA_AV to consumer table */
-			tcb_t *recv_tcb = tcb_find(receiver);
-			if (recv_tcb == NULL)
-				return -EINVAL;
-
-			/* Insert DATA_AV to the consumer TCB */
-			list_t *davs = tcb_get_davs(recv_tcb);
-			tl_t   *dav  = tl_emplace_back(davs, sender, MMR_DMNI_INF_ADDRESS);
-			if (dav == NULL)
-				return -ENOMEM;
-			
-			MMR_DBG_ADD_DAV = (sender << 16) | (receiver & 0xFFFF);
-			
-			/* If consumer waiting for a DATA_AV, release the task */
-			sched_t *sched = tcb_get_sched(recv_tcb);
-			if (sched_is_waiting_dav(sched))
-				sched_release_wait(sched);
-		} else {
-			/* Send DATA_AV to consumer PE */
-			// printf("Target = %x\n", target);
-			msg_send_hdshk(MMR_DMNI_INF_ADDRESS, target, sender, receiver, DATA_AV);
-		}
+		/* Send DATA_AV to consumer PE */
+		// printf("Target = %x\n", target);
+		msg_send_hdshk(MMR_DMNI_INF_ADDRESS, target, sender, receiver, DATA_AV);
 	}
 
 	return result;
@@ -332,8 +398,8 @@ int sys_readpipe(tcb_t *tcb, void *buf, size_t size, int sender, bool sync)
 			return ret;
 		}
 
-		/* This should never happen, but is here just in case */
-		return -EAGAIN;
+		/* Buffer posted for a local producer that did not write to it */
+		tcb_destroy_ipipe(tcb);
 	}
 
 	if (buf == NULL) {
@@ -345,8 +411,33 @@ int sys_readpipe(tcb_t *tcb, void *buf, size_t size, int sender, bool sync)
 
 	uint32_t source;
 	if (sync) {
+		rxring_t *rxring = tcb_get_rxring(tcb);
+		int slot = (rxring != NULL) ? rxring_oldest_filled(rxring) : -1;
+		if (slot != -1) {
+			/* Message already delivered to the inbound ring */
+			buf = (void*)((unsigned)buf | (unsigned)tcb_get_offset(tcb));
+
+			int result = rxring_pop(rxring, slot, tcb_get_offset(tcb), buf, size);
+			if (result <= 0)
+				return -EBADMSG;
+
+			/* Request the next pending message to the freed slot */
+			msg_rxring_fill(tcb);
+
+			return result;
+		}
+
 		list_t *davs = tcb_get_davs(tcb);
 		tl_t   *dav  = list_get_data(list_front(davs));
+		if (rxring != NULL) {
+			/* Remote DATA_AVs are served through the ring */
+			list_entry_t *entry = list_front(davs);
+			while (entry != NULL && tl_get_addr(list_get_data(entry)) != MMR_DMNI_INF_ADDRESS)
+				entry = list_next(entry);
+
+			dav = list_get_data(entry);
+		}
+
 		if (dav == NULL) {
 			if (receiver == mpipe_owner() && mpipe_trywait() == 0) {
 				buf = (void*)((unsigned)buf | (unsigned)tcb_get_offset(tcb));
@@ -359,6 +450,11 @@ int sys_readpipe(tcb_t *tcb, void *buf, size_t size, int sender, bool sync)
 				return ret;
 			}
 
+			/* Post the buffer so a local producer can write straight to it */
+			ipipe = tcb_create_ipipe(tcb);
+			if (ipipe != NULL)
+				ipipe_set(ipipe, buf, size);
+
 			/* Block task and wait for DATA_AV packet */
 			sched_t *sched = tcb_get_sched(tcb);
 			sched_set_wait_dav(sched);
@@ -424,10 +520,10 @@ int sys_readpipe(tcb_t *tcb, void *buf, size_t size, int sender, bool sync)
 	if (source == MMR_DMNI_INF_ADDRESS) {
 		if (send_tcb == NULL)
 			return -EBADMSG;
-		opipe = tcb_get_opipe(send_tcb);
+		opipe = tcb_get_opipe(send_tcb, receiver != -1 ? receiver : ((source & MEMPHIS_FORCE_PORT) ? source : (source | MEMPHIS_KERNEL_MSG)));
 	}
 
-	if (opipe != NULL && opipe_get_receiver(opipe) == (receiver != -1 ? receiver : ((source & MEMPHIS_FORCE_PORT) ? source : (source | MEMPHIS_KERNEL_MSG)))) {
+	if (opipe != NULL) {
 		/* Message was found in pipe, writes to the consumer page address (local producer) */
 		buf = (void*)((unsigned)buf | (unsigned)tcb_get_offset(tcb));
 
@@ -436,17 +532,8 @@ int sys_readpipe(tcb_t *tcb, void *buf, size_t size, int sender, bool sync)
 		if (result <= 0)
 			return -EBADMSG;
 
-		opipe_pop(opipe);
 		MMR_DBG_REM_PIPE = (sender << 16) | (receiver & 0xFFFF);
-		tcb_destroy_opipe(send_tcb);
-
-		sched_t *sched = tcb_get_sched(send_tcb);
-
-		if(sched_is_waiting_msgreq(sched)){
-			sched_release_wait(sched);
-			if(tcb_has_called_exit(send_tcb))
-				tcb_terminate(send_tcb);
-		}
+		msg_opipe_consumed(send_tcb, opipe);
 
 		return result;
 	}
@@ -482,7 +569,45 @@ int sys_readpipe(tcb_t *tcb, void *buf, size_t size, int sender, bool sync)
 
 unsigned int sys_get_tick()	
 {	
-	return MMR_RTC_MTIME;	
+	return timer_get_time();	
+}
+
+int sys_get_tick64(tcb_t *tcb, uint64_t *tick)
+{
+	if (tick == NULL)
+		return -EINVAL;
+
+	uint64_t *real_ptr = (uint64_t*)((unsigned)tcb_get_offset(tcb) | (unsigned)tick);
+	*real_ptr = timer_get_time();
+
+	return 0;
+}
+
+int sys_setrxring(tcb_t *tcb, void *buf, size_t slot_size, unsigned slots)
+{
+	if (!msg_rxring_idle(tcb))
+		return -EBUSY;
+
+	if (buf == NULL) {
+		tcb_destroy_rxring(tcb);
+		return 0;
+	}
+
+	if (slots == 0 || slots > RXRING_MAX_SLOTS)
+		return -EINVAL;
+
+	/* Deliveries are written to the slots in whole words */
+	if (slot_size == 0 || (slot_size & 3) != 0 || ((unsigned)buf & 3) != 0)
+		return -EINVAL;
+
+	rxring_t *rxring = tcb_create_rxring(tcb);
+	if (rxring == NULL)
+		return -ENOMEM;
+
+	rxring_init(rxring, buf, slot_size, slots);
+
+	/* Request the messages that were already available */
+	return msg_rxring_fill(tcb);
 }
 
 int sys_realtime(tcb_t *tcb, unsigned period, int deadline, unsigned exec_time)
@@ -543,8 +668,7 @@ int sys_brk(tcb_t *tcb, void *addr)
 	unsigned sp = tcb_get_sp(tcb);
 
 	if((unsigned)addr > sp){
-		fprintf(
-			stderr, 
+		kerror(
 			"Heap and stack collision in task %d\n", 
 			tcb_get_id(tcb)
 		);
@@ -564,7 +688,7 @@ int sys_write(tcb_t *tcb, int file, char *buf, int nbytes)
 		return -EBADF;
 
 	if(buf == NULL){
-		printf("ERROR: buffer is null\n");
+		kerror("ERROR: buffer is null\n");
 		return -EINVAL;
 	}
 
@@ -593,7 +717,7 @@ int sys_write(tcb_t *tcb, int file, char *buf, int nbytes)
 int sys_fstat(tcb_t *tcb, int file, struct stat *st)
 {
 	if(st == NULL){
-		printf("ERROR: st is null");
+		kerror("ERROR: st is null\n");
 		return false;
 	}
 
@@ -624,6 +748,22 @@ int sys_get_ctx(tcb_t *tcb, mctx_t *ctx)
 	return 0;
 }
 
+int sys_get_perf(tcb_t *tcb, perf_stats_t *stats, bool reset)
+{
+	if (tcb_get_id(tcb) >> 8 != 0)
+		return -EACCES;
+
+	if (stats != NULL) {
+		perf_stats_t *real_ptr = (perf_stats_t*)((unsigned)tcb_get_offset(tcb) | (unsigned)stats);
+		perf_read(real_ptr);
+	}
+
+	if (reset)
+		perf_reset();
+
+	return sizeof(perf_stats_t);
+}
+
 int sys_end_simulation(tcb_t *tcb)
 {
 	if(tcb_get_id(tcb) >> 8 != 0)
@@ -20,53 +20,156 @@
 #include <task_control.h>
 #include <dmni.h>
 #include <mmr.h>
+#include <timer.h>
+#include <text_cache.h>
+#include <paging.h>
+#include <kernel_pipe.h>
+#include <trace.h>
+
+#include <memphis/services.h>
+#include <memphis/messaging.h>
+
+/**
+ * @brief Refuses a task allocation
+ * 
+ * @details Drops the task binary from the DMNI and answers the mapper with
+ * TASK_ABORTED, so it can place the task elsewhere.
+ * 
+ * @param alloc Pointer to the allocation packet
+ * @param error Reason of the refusal
+ * 
+ * @return int The error, to return to the caller
+ */
+int _talloc_refuse(talloc_t *alloc, int error);
+
+/**
+ * @brief Allocates a task and receives its binary
+ * 
+ * @param alloc Pointer to the allocation information
+ * @param tcb Pointer to store the allocated TCB
+ * 
+ * @return int
+ *  0 success
+ * -ENOMEM: refused, binary dropped and mapper answered
+ */
+int _talloc_task(talloc_t *alloc, tcb_t **tcb);
+
+/**
+ * @brief Releases a task that came directly from the Injector
+ * 
+ * @param tcb Pointer to the TCB
+ * 
+ * @return int
+ *  0 should not call scheduler
+ *  1 should call scheduler
+ * -ENOMEM: could not allocate the scheduler
+ */
+int _talloc_release(tcb_t *tcb);
+
+/**
+ * @brief Allocates all tasks of a batched allocation packet
+ * 
+ * @details The payload has the binary of the task in the packet header,
+ * followed by a talloc_img_t and the binary of each remaining task. The
+ * mapper receives one TASK_ALLOCATED listing the allocated tasks.
+ * 
+ * @param alloc Pointer to the allocation packet
+ * 
+ * @return int
+ *  0 should not call scheduler
+ *  1 should call scheduler
+ * -ENOMEM: could not allocate the acknowledgement
+ */
+int _talloc_batch(talloc_t *alloc);
+
+/**
+ * @brief Receives the description of the next task of a batch
+ * 
+ * @param task Pointer to the allocation information to update
+ */
+void _talloc_next(talloc_t *task);
 
 int talloc_alloc(talloc_t *alloc)
 {
-    tcb_t *tcb = malloc(sizeof(tcb_t));
-    if (tcb == NULL)
-        return -ENOMEM;
-
-    list_entry_t *entry = tcb_push_back(tcb);
-    if (entry == NULL) {
-        free(tcb);
-        return -ENOMEM;
+	if (alloc->batch > 1)
+		return _talloc_batch(alloc);
+
+	tcb_t *tcb;
+	int ret = _talloc_task(alloc, &tcb);
+	if (ret != 0)
+		return ret;
+
+    if ((int8_t)(alloc->mapper_task) == -1) {
+        /* Task came from Injector directly. Release immediately */
+		return _talloc_release(tcb);
     }
 
-    /* Initializes the TCB */
-	tcb_alloc(
-		tcb, 
+    /* Sends task allocated to mapper */
+    return tcb_send_allocated(tcb);
+}
+
+int _talloc_task(talloc_t *alloc, tcb_t **tcb)
+{
+    *tcb = malloc(sizeof(tcb_t));
+    if (*tcb == NULL)
+        return _talloc_refuse(alloc, -ENOMEM);
+
+    /* Initializes the TCB, with a region sized from the task image */
+	int ret = tcb_alloc(
+		*tcb, 
 		alloc->task, 
 		alloc->text_size, 
 		alloc->data_size, 
 		alloc->bss_size, 
+		page_fit(alloc->text_size + alloc->data_size + alloc->bss_size),
 		alloc->mapper_task, 
 		alloc->mapper_address,
 		(void*)(alloc->entry_point)
 	);
 
+	if (ret != 0) {
+		free(*tcb);
+		return _talloc_refuse(alloc, ret);
+	}
+
+	ret = tcb_push_back(*tcb);
+	if (ret != 0) {
+		tcb_remove(*tcb);
+		return _talloc_refuse(alloc, ret);
+	}
+
 	// printf("Text size: %u\n", alloc->text_size);
 	// printf("Data size: %u\n", alloc->data_size);
 	// printf("BSS size:  %u\n", alloc->bss_size);
 
     /* Obtain the program code */
-	size_t text_recv = dmni_recv(tcb_get_offset(tcb), ((alloc->text_size + 3) & ~3));
-	if (text_recv < 0)
-		return text_recv;
+	dmni_recv(tcb_get_offset(*tcb), ((alloc->text_size + 3) & ~3));
 
 	/* Obtain program data */
-	size_t data_recv = dmni_recv((void*)(0x01000000 | (unsigned)(tcb_get_offset(tcb))), ((alloc->data_size + 3) & ~3));
-	if (data_recv < 0)
-		return data_recv;
+	void *data = (void*)(0x01000000 | (unsigned)(tcb_get_offset(*tcb)));
+	size_t data_size = ((alloc->data_size + 3) & ~3);
+	if (TALLOC_BACKGROUND_DATA && (int8_t)(alloc->mapper_task) != -1) {
+		/**
+		 * The task only runs after TASK_RELEASE, which arrives after the data.
+		 * The data lands while the mapper handles TASK_ALLOCATED.
+		 */
+		dmni_recv_async(data, data_size);
+	} else {
+		dmni_recv(data, data_size);
+	}
 
 	// printf("Received %d bytes of text and %d bytes of data\n", text_recv, data_recv);
 
-	printf(
-		"Task id %d allocated at %d with entry point %lx and offset %p\n", 
+	/* Migrations of the same binary to this PE can skip the text. Optional if out of memory */
+	tcb_cache_text(*tcb, tcache_hash(tcb_get_offset(*tcb), ((alloc->text_size + 3) & ~3)));
+
+	trace(TRACE_TASK_ALLOCATED, alloc->task, (unsigned)tcb_get_offset(*tcb), tcb_get_page_size(*tcb));
+	kinfo(
+		"Task id %d allocated at %u with entry point %lx and offset %p\n", 
 		alloc->task, 
-		MMR_RTC_MTIME, 
+		(unsigned)timer_get_time(), 
 		alloc->entry_point,
-		tcb_get_offset(tcb)
+		tcb_get_offset(*tcb)
 	);
 
 	// printf(
@@ -75,20 +178,119 @@ int talloc_alloc(talloc_t *alloc)
 	// 	alloc->mapper_address
 	// );
 
-    if ((int8_t)(alloc->mapper_task) == -1) {
-		// printf("Releasing now!\n");
-        /* Task came from Injector directly. Release immediately */
-		sched_t *sched = tcb_get_sched(tcb);
+	return 0;
+}
+
+int _talloc_release(tcb_t *tcb)
+{
+	sched_t *sched = tcb_get_sched(tcb);
 
-		if(sched == NULL)
-			sched = sched_emplace_back(tcb);
+	if(sched == NULL)
+		sched = sched_emplace_back(tcb);
 
-		if (sched == NULL)
+	if (sched == NULL)
+		return -ENOMEM;
+
+	return sched_is_idle();
+}
+
+int _talloc_batch(talloc_t *alloc)
+{
+	bool injector = ((int8_t)(alloc->mapper_task) == -1);
+
+	size_t ack_size = sizeof(talloc_ack_t) + alloc->batch*sizeof(uint16_t);
+	talloc_ack_t *ack = NULL;
+	if (!injector) {
+		ack = malloc(ack_size);
+		if (ack == NULL) {
+			/* Refuse the whole batch */
+			talloc_t task = *alloc;
+			for (unsigned i = 0; i < alloc->batch; i++) {
+				if (i > 0)
+					_talloc_next(&task);
+
+				_talloc_refuse(&task, -ENOMEM);
+			}
 			return -ENOMEM;
+		}
 
-		return sched_is_idle();
-    }
+		ack->count = 0;
+	}
 
-    /* Sends task allocated to mapper */
-    return tcb_send_allocated(tcb);
+	int ret = 0;
+	talloc_t task = *alloc;
+	for (unsigned i = 0; i < alloc->batch; i++) {
+		if (i > 0)
+			_talloc_next(&task);
+
+		tcb_t *tcb;
+		if (_talloc_task(&task, &tcb) != 0)
+			continue;
+
+		if (injector) {
+			if (_talloc_release(tcb) == 1)
+				ret = 1;
+		} else {
+			ack->tasks[ack->count++] = task.task;
+		}
+	}
+
+	if (injector)
+		return ret;
+
+	kdebug("Batch of %u tasks allocated with %u refused\n", alloc->batch, alloc->batch - ack->count);
+
+	if (ack->count != 0) {
+		/* One acknowledgement for the whole batch */
+		ack->info.service  = TASK_ALLOCATED;
+		ack->info.task     = ack->tasks[0];
+		ack->info.task_cnt = tcb_get_free_slots();
+		ret = kpipe_add(
+			ack, 
+			sizeof(talloc_ack_t) + ack->count*sizeof(uint16_t), 
+			alloc->mapper_task, 
+			alloc->mapper_address
+		);
+	}
+
+	free(ack);
+
+	return ret;
+}
+
+int _talloc_refuse(talloc_t *alloc, int error)
+{
+	dmni_drop_payload((((alloc->text_size + 3) & ~3) + ((alloc->data_size + 3) & ~3)) >> 2);
+
+	trace(TRACE_TASK_REFUSED, alloc->task, error, 0);
+	kerror("Task id %d refused with error %d\n", alloc->task, error);
+
+	/* Task came from Injector directly, there is no mapper to answer */
+	if ((int8_t)(alloc->mapper_task) == -1)
+		return error;
+
+	memphis_info_t task_aborted;
+	task_aborted.service  = TASK_ABORTED;
+	task_aborted.task     = alloc->task;
+	task_aborted.task_cnt = tcb_get_free_slots();
+	kpipe_add(
+		&task_aborted, 
+		sizeof(task_aborted), 
+		alloc->mapper_task, 
+		alloc->mapper_address
+	);
+
+	return error;
+}
+
+void _talloc_next(talloc_t *task)
+{
+	talloc_img_t img;
+	dmni_recv(&img, sizeof(talloc_img_t));
+
+	task->entry_point = img.entry_point;
+	task->text_size   = img.text_size;
+	task->data_size   = img.data_size;
+	task->bss_size    = img.bss_size;
+	task->task        = img.task;
 }
@@ -21,65 +21,120 @@
 #include <mmr.h>
 #include <llm.h>
 #include <kernel_pipe.h>
+#include <pool.h>
+#include <message.h>
+#include <dmni.h>
+#include <text_cache.h>
+#include <trace.h>
 
 #include <memphis/services.h>
 #include <memphis/messaging.h>
 
-list_t _tcbs;
+tcb_t **_tcbs = NULL;	//!< Open-addressed hash table of TCBs indexed by task ID
+size_t _tcb_mask = 0;	//!< Hash table capacity minus one
+size_t _tcb_cnt = 0;	//!< Number of TCBs in the hash table
 
-void tcb_init()
+/**
+ * @brief Gets the home slot of a task ID in the hash table
+ * 
+ * @param task ID of the task
+ * 
+ * @return size_t Index of the slot
+ */
+size_t _tcb_hash(int task);
+
+/**
+ * @brief Updates the address of a task in a handshake list
+ * 
+ * @param list Pointer to the list of tl_t
+ * @param task ID of the task
+ * @param addr New address of the task
+ * 
+ * @return True if an entry was updated
+ */
+bool _tcb_relocate_list(list_t *list, int task, int addr);
+
+int tcb_init()
 {
-	list_init(&_tcbs);
+	const unsigned MAX_TASKS = (MMR_DMNI_INF_MANYCORE_SZ >> 16);
+
+	/* Power of 2 with at most half of the slots occupied */
+	size_t capacity = 1;
+	while (capacity < (MAX_TASKS << 1))
+		capacity <<= 1;
+
+	_tcbs = calloc(capacity, sizeof(tcb_t*));
+	if (_tcbs == NULL)
+		return -ENOMEM;
+
+	_tcb_mask = capacity - 1;
+
+	return 0;
 }
 
-list_entry_t *tcb_push_back(tcb_t *tcb)
+size_t _tcb_hash(int task)
 {
-	return list_push_back(&_tcbs, tcb);
+	/* Fibonacci hashing spreads the {app, task} pairs */
+	return (((unsigned)task * 0x9E3779B1U) >> 16) & _tcb_mask;
 }
 
-bool _tcb_find_fnc(void *data, void *cmpval)
+int tcb_push_back(tcb_t *tcb)
 {
-    tcb_t *tcb = (tcb_t*)data;
-    int task = *((int*)cmpval);
+	if (_tcb_cnt == _tcb_mask)
+		return -ENOMEM;
+
+	size_t index = _tcb_hash(tcb->id);
+	while (_tcbs[index] != NULL)
+		index = (index + 1) & _tcb_mask;
 
-    return (tcb->id == task);
+	_tcbs[index] = tcb;
+	_tcb_cnt++;
+
+	return 0;
 }
 
 tcb_t *tcb_find(int task)
 {
-	list_entry_t *entry = list_find(&_tcbs, &task, _tcb_find_fnc);
+	size_t index = _tcb_hash(task);
+
+	while (_tcbs[index] != NULL) {
+		if (_tcbs[index]->id == task)
+			return _tcbs[index];
 
-    if(entry == NULL)
-        return NULL;
+		index = (index + 1) & _tcb_mask;
+	}
 
-    return list_get_data(entry);
+	return NULL;
 }
 
-void tcb_alloc(
+int tcb_alloc(
 	tcb_t *tcb, 
 	int id, 
 	size_t text_size, 
 	size_t data_size, 
 	size_t bss_size, 
+	size_t page_size, 
 	int mapper_task, 
 	int mapper_addr, 
 	void *entry_point
 )
 {
-	memset(tcb->registers, 0, HAL_MAX_REGISTERS * sizeof(int));
-
-	tcb->registers[HAL_REG_SP] = MMR_DATA_BASE | (MMR_DMNI_INF_DMEM_PAGE_SZ - (sizeof(int) << 1));
-	tcb->pc = entry_point;
-
-	tcb->page = page_acquire();
+	tcb->page = page_acquire(page_size);
 
 	if(tcb->page == NULL){
-		puts("FATAL: no free pages found");
-		while(true);
+		kerror("ERROR: no free region of %u bytes for task %d\n", page_size, id);
+		return -ENOMEM;
 	}
 
+	memset(tcb->registers, 0, HAL_MAX_REGISTERS * sizeof(int));
+
+	/* Stack starts at the top of the task region */
+	tcb->registers[HAL_REG_SP] = MMR_DATA_BASE | (page_get_size(tcb->page) - (sizeof(int) << 1));
+	tcb->pc = entry_point;
+
 	tcb->id = id;
 	tcb->text_size = text_size;
+	tcb->text_hash = 0;
 	tcb->data_size = data_size;
 	tcb->bss_size = bss_size;
 	tcb->proc_to_migrate = -1;
@@ -109,7 +164,8 @@ void tcb_alloc(
 	tcb->scheduler = NULL;
 
 	tcb->pipe_in = NULL;
-	tcb->pipe_out = NULL;
+	tcb->pipe_out_cnt = 0;
+	tcb->rxring = NULL;
 
 	tcb->called_exit = false;
 
@@ -122,6 +178,8 @@ void tcb_alloc(
 	// char *argv = (0x01000000 | MMR_DMNI_INF_DMEM_PAGE_SZ) + page_get_offset(tcb->page) - 8;
 	// *argc = 0;
 	// *argv = NULL;
+
+	return 0;
 }
 
 bool tcb_check_stack(tcb_t *tcb)
@@ -152,47 +210,129 @@ void tcb_abort_task(tcb_t *tcb)
 	tcb_remove(tcb);
 }
 
+/**
+ * @brief Removes a TCB from the hash table
+ * 
+ * @details Entries after the hole are shifted back, so lookups never need
+ * tombstones.
+ * 
+ * @param tcb Pointer to the TCB
+ */
+void _tcb_erase(tcb_t *tcb)
+{
+	size_t hole = _tcb_hash(tcb->id);
+	while (_tcbs[hole] != tcb) {
+		if (_tcbs[hole] == NULL)
+			return;
+
+		hole = (hole + 1) & _tcb_mask;
+	}
+
+	size_t index = hole;
+	while (true) {
+		index = (index + 1) & _tcb_mask;
+		if (_tcbs[index] == NULL)
+			break;
+
+		/* Entries whose home slot is not after the hole can move into it */
+		size_t home = _tcb_hash(_tcbs[index]->id);
+		if (((index - home) & _tcb_mask) >= ((index - hole) & _tcb_mask)) {
+			_tcbs[hole] = _tcbs[index];
+			hole = index;
+		}
+	}
+
+	_tcbs[hole] = NULL;
+	_tcb_cnt--;
+}
+
+void tcb_detach(tcb_t *tcb)
+{
+	/* No message may keep pointing to or waiting for this task */
+	msg_borrow_clear(tcb);
+
+	sched_remove(tcb->scheduler);
+	tcb->scheduler = NULL;
+
+	_tcb_erase(tcb);
+}
+
 void tcb_remove(tcb_t *tcb)
 {
+	/* Queued migration packets may point to the task page, TCB or app */
+	if (tcb_need_migration(tcb))
+		dmni_flush();
+
+	/* The task data may still be landing in the page */
+	dmni_recv_wait();
+
+	tcb_detach(tcb);
+
+	/* The text may be kept for the next task with the same binary */
+	tcache_remove(tcb);
+
 	app_derefer(tcb->app);
 
 	page_release(tcb->page);
 
-	sched_remove(tcb->scheduler);
-
-	list_entry_t *entry = list_find(&_tcbs, tcb, NULL);
-	if(entry != NULL)
-		list_remove(&_tcbs, entry);
+	tcb_destroy_rxring(tcb);
 
 	MMR_DBG_TERMINATE = tcb->id;
 
 	free(tcb);
 }
 
-opipe_t *tcb_get_opipe(tcb_t *tcb)
+opipe_t *tcb_get_opipe(tcb_t *tcb, int receiver)
 {
-	return tcb->pipe_out;
+	for (unsigned i = 0; i < tcb->pipe_out_cnt; i++) {
+		if (opipe_get_receiver(tcb->pipe_out[i]) == receiver)
+			return tcb->pipe_out[i];
+	}
+
+	return NULL;
 }
 
-bool _tcb_send_terminated(tcb_t *tcb)
+opipe_t *tcb_get_opipe_at(tcb_t *tcb, unsigned index)
+{
+	if (index >= tcb->pipe_out_cnt)
+		return NULL;
+
+	return tcb->pipe_out[index];
+}
+
+bool tcb_has_opipe(tcb_t *tcb)
+{
+	return (tcb->pipe_out_cnt != 0);
+}
+
+unsigned tcb_get_opipe_free(tcb_t *tcb)
+{
+	return TCB_OPIPE_SLOTS - tcb->pipe_out_cnt;
+}
+
+bool _tcb_send_terminated(int id, tl_t *mapper)
 {
 	memphis_info_t task_terminated;
-	task_terminated.service = TASK_TERMINATED;
-	task_terminated.task    = tcb->id;
+	task_terminated.service  = TASK_TERMINATED;
+	task_terminated.task     = id;
+	task_terminated.task_cnt = tcb_get_free_slots();
 	return kpipe_add(
 		&task_terminated, 
 		sizeof(task_terminated),
-		tl_get_task(&(tcb->mapper)), 
-		tl_get_addr(&(tcb->mapper))
+		tl_get_task(mapper), 
+		tl_get_addr(mapper)
 	);
 }
 
 void tcb_terminate(tcb_t *tcb)
 {
-	/* Send TASK_TERMINATED */
-	_tcb_send_terminated(tcb);
+	int id = tcb->id;
+	tl_t mapper = tcb->mapper;
 
 	tcb_remove(tcb);
+
+	/* Send TASK_TERMINATED, counting the slot released by the task */
+	_tcb_send_terminated(id, &mapper);
 }
 
 app_t *tcb_get_app(tcb_t *tcb)
@@ -212,14 +352,32 @@ bool tcb_need_migration(tcb_t *tcb)
 
 opipe_t *tcb_create_opipe(tcb_t *tcb)
 {
-	tcb->pipe_out = malloc(sizeof(opipe_t));
-	return tcb->pipe_out;
+	if (tcb->pipe_out_cnt == TCB_OPIPE_SLOTS)
+		return NULL;
+
+	opipe_t *opipe = pool_alloc(sizeof(opipe_t));
+	if (opipe == NULL)
+		return NULL;
+
+	tcb->pipe_out[tcb->pipe_out_cnt++] = opipe;
+	return opipe;
 }
 
-void tcb_destroy_opipe(tcb_t *tcb)
+void tcb_destroy_opipe(tcb_t *tcb, opipe_t *opipe)
 {
-	free(tcb->pipe_out);
-	tcb->pipe_out = NULL;
+	unsigned i = 0;
+	while (i < tcb->pipe_out_cnt && tcb->pipe_out[i] != opipe)
+		i++;
+
+	if (i == tcb->pipe_out_cnt)
+		return;
+
+	/* Keep the remaining pipes in production order */
+	tcb->pipe_out_cnt--;
+	for (; i < tcb->pipe_out_cnt; i++)
+		tcb->pipe_out[i] = tcb->pipe_out[i + 1];
+
+	pool_free(opipe);
 	/* Note: the actual message is not freed here. Check DMNI */
 }
 
@@ -233,11 +391,45 @@ list_t *tcb_get_davs(tcb_t *tcb)
 	return &(tcb->data_avs);
 }
 
+void tcb_relocate(int task, int addr)
+{
+	for (size_t i = 0; i <= _tcb_mask; i++) {
+		tcb_t *tcb = _tcbs[i];
+		if (tcb == NULL)
+			continue;
+
+		_tcb_relocate_list(&(tcb->message_requests), task, addr);
+
+		/* A DATA_AV that became remote is requested through the ring */
+		if (_tcb_relocate_list(&(tcb->data_avs), task, addr))
+			msg_rxring_fill(tcb);
+	}
+}
+
+bool _tcb_relocate_list(list_t *list, int task, int addr)
+{
+	bool updated = false;
+
+	list_entry_t *entry = list_front(list);
+	while (entry != NULL) {
+		tl_t *tl = list_get_data(entry);
+		if (tl_get_task(tl) == task && tl_get_addr(tl) != addr) {
+			tl_set(tl, task, addr);
+			updated = true;
+		}
+
+		entry = list_next(entry);
+	}
+
+	return updated;
+}
+
 bool tcb_send_allocated(tcb_t *tcb)
 {
 	memphis_info_t task_allocated;
-	task_allocated.service = TASK_ALLOCATED;
-	task_allocated.task    = tcb->id;
+	task_allocated.service  = TASK_ALLOCATED;
+	task_allocated.task     = tcb->id;
+	task_allocated.task_cnt = tcb_get_free_slots();
 	return kpipe_add(
 		&task_allocated, 
 		sizeof(task_allocated),
@@ -251,6 +443,11 @@ void *tcb_get_offset(tcb_t *tcb)
 	return page_get_offset(tcb->page);
 }
 
+size_t tcb_get_page_size(tcb_t *tcb)
+{
+	return page_get_size(tcb->page);
+}
+
 int tcb_get_migrate_addr(tcb_t *tcb)
 {
 	return tcb->proc_to_migrate;
@@ -286,6 +483,18 @@ size_t tcb_get_text_size(tcb_t *tcb)
 	return tcb->text_size;
 }
 
+uint64_t tcb_get_text_hash(tcb_t *tcb)
+{
+	return tcb->text_hash;
+}
+
+int tcb_cache_text(tcb_t *tcb, uint64_t hash)
+{
+	tcb->text_hash = hash;
+
+	return tcache_add(tcb, hash, tcb_get_offset(tcb), (tcb->text_size + 3) & ~3);
+}
+
 size_t tcb_get_data_size(tcb_t *tcb)
 {
 	return tcb->data_size;
@@ -338,7 +547,7 @@ void tcb_set_sched(tcb_t *tcb, sched_t *sched)
 
 ipipe_t *tcb_create_ipipe(tcb_t *tcb)
 {
-	tcb->pipe_in = malloc(sizeof(ipipe_t));
+	tcb->pipe_in = pool_alloc(sizeof(ipipe_t));
 
 	if(tcb->pipe_in == NULL)
 		return NULL;
@@ -349,10 +558,33 @@ ipipe_t *tcb_create_ipipe(tcb_t *tcb)
 
 void tcb_destroy_ipipe(tcb_t *tcb)
 {
-	free(tcb->pipe_in);
+	pool_free(tcb->pipe_in);
 	tcb->pipe_in = NULL;
 }
 
+rxring_t *tcb_get_rxring(tcb_t *tcb)
+{
+	return tcb->rxring;
+}
+
+rxring_t *tcb_create_rxring(tcb_t *tcb)
+{
+	tcb_destroy_rxring(tcb);
+
+	tcb->rxring = malloc(sizeof(rxring_t));
+	return tcb->rxring;
+}
+
+void tcb_destroy_rxring(tcb_t *tcb)
+{
+	if (tcb->rxring == NULL)
+		return;
+
+	rxring_clear(tcb->rxring);
+	free(tcb->rxring);
+	tcb->rxring = NULL;
+}
+
 sched_t *tcb_get_sched(tcb_t *tcb)
 {
 	return tcb->scheduler;
@@ -370,7 +602,19 @@ void tcb_set_ret(tcb_t *tcb, int ret)
 
 size_t tcb_size()
 {
-	return list_get_size(&_tcbs);
+	return _tcb_cnt;
+}
+
+unsigned tcb_get_free_slots()
+{
+	const unsigned MAX_TASKS = (MMR_DMNI_INF_MANYCORE_SZ >> 16);
+
+	unsigned slots = (_tcb_cnt < MAX_TASKS) ? (MAX_TASKS - _tcb_cnt) : 0;
+
+	/* Bounded by the memory left for the smallest task */
+	unsigned regions = page_count_free(page_fit(0));
+
+	return (regions < slots) ? regions : slots;
 }
 
 void tcb_inc_pc(tcb_t *tcb, unsigned inc)
@@ -20,6 +20,7 @@
 
 #include "dmni.h"
 #include "broadcast.h"
+#include "pool.h"
 
 bool _tl_find_fnc(void *data, void* cmpval)
 {
@@ -50,12 +51,12 @@ void tl_remove(list_t *list, tl_t *tl)
 	
 	list_remove(list, entry);
 
-	free(tl);
+	pool_free(tl);
 }
 
 tl_t *tl_emplace_back(list_t *list, int task, int addr)
 {
-	tl_t *tl = malloc(sizeof(tl_t));
+	tl_t *tl = pool_alloc(sizeof(tl_t));
 	
 	if(tl == NULL)
 		return NULL;
@@ -64,7 +65,7 @@ tl_t *tl_emplace_back(list_t *list, int task, int addr)
 	tl->addr = addr;
 
 	if(list_push_back(list, tl) == NULL){
-		free(tl);
+		pool_free(tl);
 		return NULL;
 	}
 
@@ -15,6 +15,7 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <errno.h>
 
 #include <memphis.h>
@@ -26,17 +27,93 @@
 #include <mmr.h>
 #include <kernel_pipe.h>
 #include <message.h>
+#include <timer.h>
+#include <pool.h>
+#include <text_cache.h>
+#include <zrle.h>
+#include <trace.h>
 
 list_t _tms;
+list_t _tm_probes;	//!< Migrations waiting the text answer of the target {task, target}
+list_t _tm_broken;	//!< Migrating tasks whose image did not arrive whole, aborted with the TCB {task, -}
+tm_stats_t _tm_stats = {0};
+
+/**
+ * @brief Migration whose TCB packet is still in the DMNI send queue
+ */
+typedef struct _tm_out {
+	tcb_t *tcb;			//!< Detached TCB, released when the last packet leaves
+	uint64_t start;		//!< Time the migration started
+	unsigned misses;	//!< RT misses of the PE when the migration started
+} tm_out_t;
+
+/**
+ * @brief Forwarding entry of a task migrated from this PE
+ */
+typedef struct _tm_fwd {
+	tl_t tl;			//!< Migrated task and its new address. Must be the first member.
+	unsigned pending;	//!< Location updates not acknowledged yet
+	bool lazy;			//!< An update could not be sent, so the entry is kept
+} tm_fwd_t;
+
+/**
+ * @brief Data section pre-copy of a running task
+ */
+typedef struct _tm_pre {
+	tcb_t *tcb;			//!< Task being pre-copied
+	int id;				//!< ID of the task, to check it still exists
+	int addr;			//!< Target address
+	timer_evt_t evt;	//!< Stops the task when the rounds converge
+	unsigned round;		//!< Current round
+	unsigned next;		//!< Next block checked in the round
+	unsigned dirty;		//!< Blocks sent in the round
+	unsigned cap;		//!< Blocks held by the copy. Blocks of a grown heap are sent stopped.
+	bool inflight;		//!< A block is in the DMNI send queue
+	bool converged;		//!< Rounds finished, waiting to stop the task
+	void *copy;			//!< Last copy sent of each block, read by the DMNI
+	uint16_t len[];		//!< Bytes sent of each block, 0 if not sent
+} tm_pre_t;
+
+list_t _tm_pres;
 
 /**
  * @brief Creates and stores a task migration information
  * 
+ * @details An entry left by an older migration of the same task is reused.
+ * 
  * @param task ID of the migrated task
  * @param addr Address where the task has migrated
- * @return tl_t* Pointer to the task location structure created
+ * @return tm_fwd_t* Pointer to the forwarding entry
+ */
+tm_fwd_t *_tm_emplace_back(int task, int addr);
+
+/**
+ * @brief Sends a location update packet
+ * 
+ * @param task ID of the migrated task
+ * @param addr New address of the task
+ * @param target Address of the PE to update
+ * @param ack_addr Address to acknowledge to, -1 if the packet is the acknowledgement
+ * 
+ * @return
+ *  0 on success
+ * -ENOMEM if not enough memory
+ */
+int _tm_send_update(int task, int addr, int target, int ack_addr);
+
+/**
+ * @brief Pushes the new location of a migrated task to the PEs of its application
+ * 
+ * @details Each PE in the location table, the target included, receives one
+ * update. Each PE points its handshakes with the task to the new address before
+ * acknowledging, and the NoC keeps the order of the packets between two PEs.
+ * So the forwarding entry is retired when all of them have acknowledged, as no
+ * message to the task can reach this PE anymore.
+ * 
+ * @param app Pointer to the application
+ * @param task ID of the migrated task
  */
-tl_t *_tm_emplace_back(int task, int addr);
+void _tm_announce(app_t *app, int task);
 
 /**
  * @brief Finds a task migration entry by application ID
@@ -77,6 +154,9 @@ int _tm_send_stack(tcb_t *tcb, int id, int addr);
 /**
  * @brief Migrates a message API handshake (DATA_AV + MESSAGE_REQUEST)
  * 
+ * @details A copy is sent. The lists are released by tm_migrate once the
+ * migration cannot fail anymore.
+ * 
  * @param tcb Pointer to the TCB
  * @param id ID of the task
  * @param addr Address to migrate
@@ -88,7 +168,10 @@ int _tm_send_stack(tcb_t *tcb, int id, int addr);
 int _tm_send_hdshk(tcb_t *tcb, int id, int addr);
 
 /**
- * @brief Migrates the output pipe
+ * @brief Migrates the output pipes
+ * 
+ * @details All packets are allocated before the first pipe is released, so
+ * either every pipe is sent or none.
  * 
  * @param tcb Pointer to the TCB
  * @param id ID of the task
@@ -116,236 +199,1171 @@ int _tm_send_tl(tcb_t *tcb, int id, int addr);
 /**
  * @brief Migrates the TCB (and scheduler)
  * 
- * @param tcb Pointer to the TCB
+ * @details The TCB is the last packet of the migration. The send queue is
+ * FIFO, so when it leaves the DMNI all the task memory has left too.
+ * 
+ * @param mig Pointer to the outgoing migration
+ * @param packet TCB packet reserved when the migration started
  * @param id ID of the migrating task
  * @param addr Target address
  * 
  * @return
  * 	0 on success
+ * -EINVAL if the packet is not accepted by the DMNI
+ */
+int _tm_send_tcb(tm_out_t *mig, tm_tcb_t *packet, int id, int addr);
+
+/**
+ * @brief Cancels a migration that failed to send a part of the task
+ * 
+ * @details The reserved TCB packet tells the target to drop the partial
+ * task. The task keeps running in this PE and the forwarding entry is removed.
+ * 
+ * @param mig Pointer to the outgoing migration
+ * @param packet TCB packet reserved when the migration started
+ * @param addr Target address
+ * @param err Error that failed the migration
+ * 
+ * @return int The error
+ */
+int _tm_cancel(tm_out_t *mig, tm_tcb_t *packet, int addr, int err);
+
+/**
+ * @brief Tells the target to drop the TCB created for a migrating task
+ * 
+ * @param packet TCB packet to send, freed by the DMNI
+ * @param id ID of the task
+ * @param addr Target address
+ */
+void _tm_send_cancel(tm_tcb_t *packet, int id, int addr);
+
+/**
+ * @brief Completes a migration when its last packet has left the DMNI
+ * 
+ * @param arg Pointer to the outgoing migration
+ */
+void _tm_sent(void *arg);
+
+/**
+ * @brief Sends a text packet
+ * 
+ * @param tcb Pointer to the TCB
+ * @param id ID of the task
+ * @param addr Target address
+ * @param kind TM_TEXT_FULL or TM_TEXT_PROBE
+ * 
+ * @return
+ *  0 on success
+ * -ENOMEM if not enough memory
+ */
+int _tm_send_text_kind(tcb_t *tcb, int id, int addr, tm_text_kind_t kind);
+
+/**
+ * @brief Creates the TCB of a task migrating to this PE
+ * 
+ * @param packet Pointer to the text packet
+ * 
+ * @return tcb_t* Pointer to the TCB, NULL if not enough memory
+ */
+tcb_t *_tm_text_tcb(tm_text_t *packet);
+
+/**
+ * @brief Sends the answer to a text probe
+ * 
+ * @param packet Pointer to the probe packet
+ * @param kind TM_TEXT_HIT or TM_TEXT_MISS
+ * 
+ * @return
+ *  0 on success
  * -ENOMEM if not enough memory
  */
-int _tm_send_tcb(tcb_t *tcb, int id, int addr);
+int _tm_text_answer(tm_text_t *packet, tm_text_kind_t kind);
+
+/**
+ * @brief Handles the answer of the target to a text probe
+ * 
+ * @details If the full text cannot be sent after a miss, the migration is
+ * cancelled and the target drops the TCB created by the probe.
+ * 
+ * @param packet Pointer to the answer packet
+ * 
+ * @return
+ *  0 if the task keeps running
+ *  1 if migrated
+ * -ENOMEM if not enough memory, the migration is cancelled
+ */
+int _tm_text_answered(tm_text_t *packet);
+
+/**
+ * @brief Gets the data, bss and heap size of a task
+ * 
+ * @param tcb Pointer to the TCB
+ * @param heap_size Pointer to store the heap size, can be NULL
+ * 
+ * @return size_t Aligned size of the section
+ */
+size_t _tm_data_size(tcb_t *tcb, size_t *heap_size);
+
+/**
+ * @brief Sends a part of the data section
+ * 
+ * @param tcb Pointer to the TCB
+ * @param id ID of the task
+ * @param addr Target address
+ * @param offset Offset of the part in the section
+ * @param pld Pointer to the part, a kernel copy if the task is running
+ * @param size Size of the part
+ * @param pre Pre-copy notified when the part is sent, NULL if stopped
+ * 
+ * @return
+ *  0 on success
+ * -ENOMEM if not enough memory
+ */
+int _tm_send_data_part(tcb_t *tcb, int id, int addr, size_t offset, void *pld, size_t size, tm_pre_t *pre);
+
+/**
+ * @brief Encodes an image to be sent
+ * 
+ * @details Only used if it saves at least 1/8 of the image.
+ * 
+ * @param image Pointer to the image
+ * @param size Size of the image
+ * @param enc_size Pointer to store the encoded size, 0 if not encoded
+ * 
+ * @return void* Encoded buffer to be freed after sent, NULL if not encoded
+ */
+void *_tm_encode(const void *image, size_t size, uint32_t *enc_size);
+
+/**
+ * @brief Receives an image, encoded or not
+ * 
+ * @details An encoded image is received group by group straight into the
+ * destination, so no buffer is allocated.
+ * 
+ * @param dst Pointer to the image
+ * @param size Size of the image
+ * @param enc_size Encoded size, 0 if not encoded
+ * 
+ * @return int
+ *  Size of the image on success
+ * -EINVAL if the payload is malformed or short (rest of the payload dropped)
+ */
+int _tm_recv_image(void *dst, size_t size, size_t enc_size);
+
+/**
+ * @brief Marks a migrating task whose image did not arrive whole
+ * 
+ * @details The task is aborted when its TCB arrives, so it never runs with a
+ * corrupted page.
+ * 
+ * @param task ID of the task
+ * @param err Error receiving the image
+ * 
+ * @return int The error
+ */
+int _tm_broken_image(int task, int err);
+
+/**
+ * @brief Releases the message state rebuilt for a task that will not run
+ * 
+ * @param tcb Pointer to the TCB
+ */
+void _tm_drop_state(tcb_t *tcb);
+
+/**
+ * @brief Checks if a data block differs from its last copy sent
+ * 
+ * @param pre Pointer to the pre-copy
+ * @param section Pointer to the data section of the task
+ * @param i Index of the block
+ * @param size Current size of the block
+ * 
+ * @return True if the block must be sent again
+ */
+bool _tm_block_dirty(tm_pre_t *pre, void *section, unsigned i, size_t size);
+
+/**
+ * @brief Sends the next changed block of the pre-copy
+ * 
+ * @details Only one block is in the DMNI queue at a time, so the task keeps
+ * running and a single block copy is held by the kernel.
+ * 
+ * @param pre Pointer to the pre-copy
+ */
+void _tm_pre_step(tm_pre_t *pre);
+
+/**
+ * @brief Continues the pre-copy when its block leaves the DMNI
+ * 
+ * @param arg Pointer to the pre-copy
+ */
+void _tm_pre_sent(void *arg);
+
+/**
+ * @brief Migrates the task when the pre-copy converges
+ * 
+ * @param arg Pointer to the pre-copy
+ */
+void _tm_pre_stop(void *arg);
+
+/**
+ * @brief Checks if the pre-copied task is still waiting to migrate
+ * 
+ * @param pre Pointer to the pre-copy
+ * 
+ * @return True if the task was not terminated, aborted or migrated
+ */
+bool _tm_pre_alive(tm_pre_t *pre);
+
+/**
+ * @brief Removes a pre-copy from the list and releases it
+ * 
+ * @details A pre-copy with a block in the DMNI send queue is released by the
+ * block callback.
+ * 
+ * @param pre Pointer to the pre-copy
+ */
+void _tm_pre_remove(tm_pre_t *pre);
+
+/**
+ * @brief Finds the pre-copy of a task
+ * 
+ * @param tcb Pointer to the TCB
+ * 
+ * @return tm_pre_t* Pointer to the pre-copy, NULL if none
+ */
+tm_pre_t *_tm_pre_find(tcb_t *tcb);
+
+/**
+ * @brief Compares a pre-copy with a TCB
+ * 
+ * @param data Pointer to the pre-copy
+ * @param cmpval Pointer to the TCB
+ * 
+ * @return True if the pre-copy is of the TCB
+ */
+bool _tm_pre_find_fnc(void *data, void *cmpval);
 
 void tm_init()
 {
 	list_init(&_tms);
+	list_init(&_tm_pres);
+	list_init(&_tm_probes);
+	list_init(&_tm_broken);
 }
 
 tl_t *tm_find(int task)
 {
-	return tl_find(&_tms, task);
+	return tl_find(&_tms, task);
+}
+
+int tm_abort_task(int id, int addr)
+{
+	/* Send it like a MESSAGE_DELIVERY */
+	memphis_info_t *abort_task = pool_alloc(sizeof(memphis_info_t));
+	if (abort_task == NULL)
+		return -ENOMEM;
+
+	abort_task->service = ABORT_TASK;
+	abort_task->task    = id;
+
+	return msg_send_message_delivery(
+		abort_task, 
+		sizeof(memphis_info_t), 
+		MMR_DMNI_INF_ADDRESS, 
+		(MEMPHIS_KERNEL_MSG | addr), 
+		-1, 
+		-1
+	);
+}
+
+void tm_clear_app(int id)
+{
+	list_entry_t *entry = list_find(&_tms, &id, _tm_find_app_fnc);
+	while(entry != NULL){
+		tl_t *tl = list_get_data(entry);
+		// printf("************* Removed task %d from migration\n", tl->task);
+		list_remove(&_tms, entry);
+		pool_free(tl);
+		entry = list_find(&_tms, &id, _tm_find_app_fnc);
+	}
+}
+
+bool tm_empty()
+{
+	return list_empty(&_tms);
+}
+
+tm_fwd_t *_tm_emplace_back(int task, int addr)
+{
+	tm_fwd_t *fwd = (tm_fwd_t*)tm_find(task);
+
+	if (fwd == NULL) {
+		fwd = pool_alloc(sizeof(tm_fwd_t));
+
+		if (fwd == NULL)
+			return NULL;
+
+		list_entry_t *entry = list_push_back(&_tms, fwd);
+
+		if(entry == NULL){
+			pool_free(fwd);
+			return NULL;
+		}
+	}
+
+	tl_set(&(fwd->tl), task, addr);
+	fwd->pending = 0;
+	fwd->lazy    = false;
+
+	return fwd;
+}
+
+int _tm_send_update(int task, int addr, int target, int ack_addr)
+{
+	/* Send it like a MESSAGE_DELIVERY */
+	tm_update_t *update = pool_alloc(sizeof(tm_update_t));
+	if (update == NULL)
+		return -ENOMEM;
+
+	update->info.service = TASK_MIGRATED;
+	update->info.task    = task;
+	update->info.address = addr;
+	update->ack_addr     = ack_addr;
+
+	return msg_send_message_delivery(
+		update, 
+		sizeof(tm_update_t), 
+		MMR_DMNI_INF_ADDRESS, 
+		(MEMPHIS_KERNEL_MSG | target), 
+		-1, 
+		-1
+	);
+}
+
+void _tm_announce(app_t *app, int task)
+{
+	tm_fwd_t *fwd = (tm_fwd_t*)tm_find(task);
+	if (fwd == NULL)
+		return;
+
+	int addr = tl_get_addr(&(fwd->tl));
+	size_t task_cnt = app_get_task_cnt(app);
+	int *locations = app_get_locations(app);
+
+	for (size_t i = 0; i < task_cnt; i++) {
+		int peer = locations[i];
+		if (peer == -1 || peer == MMR_DMNI_INF_ADDRESS)
+			continue;
+
+		/* One update per PE */
+		bool repeated = false;
+		for (size_t j = 0; j < i && !repeated; j++)
+			repeated = (locations[j] == peer);
+
+		if (repeated)
+			continue;
+
+		if (_tm_send_update(task, addr, peer, MMR_DMNI_INF_ADDRESS) == 0)
+			fwd->pending++;
+		else
+			fwd->lazy = true;
+	}
+
+	_tm_stats.updates += fwd->pending;
+
+	if (fwd->pending == 0 && !fwd->lazy)
+		tl_remove(&_tms, &(fwd->tl));
+}
+
+int tm_recv_update(tm_update_t *packet)
+{
+	int task = packet->info.task;
+	int addr = packet->info.address;
+
+	tm_fwd_t *fwd = (tm_fwd_t*)tm_find(task);
+
+	if (packet->ack_addr == -1) {
+		/* Acknowledgement of an update sent by this PE. Ignore if outdated. */
+		if (fwd == NULL || tl_get_addr(&(fwd->tl)) != addr || fwd->pending == 0)
+			return 0;
+
+		fwd->pending--;
+		if (fwd->pending == 0 && !fwd->lazy) {
+			trace(TRACE_TM_RETIRED, task, 0, 0);
+			kdebug("Forwarding of task %d retired\n", task);
+			tl_remove(&_tms, &(fwd->tl));
+		}
+
+		return 0;
+	}
+
+	app_t *app = app_find((task >> 8) & 0xFF);
+	if (app != NULL)
+		app_update(app, task, addr);
+
+	/* No handshake held here may point to the old address after the ack */
+	tcb_relocate(task, addr);
+
+	/* Forward straight to the new address if the task was here before */
+	if (fwd != NULL && tcb_find(task) == NULL)
+		tl_set(&(fwd->tl), task, addr);
+
+	return _tm_send_update(task, addr, packet->ack_addr, -1);
+}
+
+bool _tm_find_app_fnc(void *data, void* cmpval)
+{
+	tl_t *tl = (tl_t*)data;
+	int app_id = *((int*)cmpval);
+
+	return (((tl->task >> 8) & 0xFF) == app_id);
+}
+
+int tm_send_text(tcb_t *tcb, int id, int addr)
+{
+	if (tcb_get_text_hash(tcb) != 0) {
+		/* Ask the target before sending the text */
+		tl_t *probe = tl_emplace_back(&_tm_probes, id, addr);
+		if (probe != NULL) {
+			trace(TRACE_TM_TEXT_SENT, id, addr, 0);
+			kdebug("Probing text of task %d at address %x\n", id, addr);
+
+			int ret = _tm_send_text_kind(tcb, id, addr, TM_TEXT_PROBE);
+			if (ret != 0) {
+				tl_remove(&_tm_probes, probe);
+				return ret;
+			}
+
+			return 1;
+		}
+	}
+
+	return _tm_send_text_kind(tcb, id, addr, TM_TEXT_FULL);
+}
+
+int _tm_send_text_kind(tcb_t *tcb, int id, int addr, tm_text_kind_t kind)
+{
+	tm_text_t *packet = pool_alloc(sizeof(tm_text_t));
+	if (packet == NULL)
+		return -ENOMEM;
+
+	tl_t *mapper = tcb_get_mapper(tcb);
+	size_t text_size = tcb_get_text_size(tcb);
+	uint64_t hash = tcb_get_text_hash(tcb);
+
+	packet->hermes.flags   = 0;
+    packet->hermes.service = MIGRATION_TEXT;
+    packet->hermes.address = addr;
+    packet->size           = text_size; 
+    packet->mapper_address = tl_get_addr(mapper);
+    packet->task           = id;
+    packet->mapper_task    = tl_get_task(mapper);
+	packet->kind           = kind;
+	packet->source         = MMR_DMNI_INF_ADDRESS;
+	packet->hash_low       = hash & UINT32_MAX;
+	packet->hash_high      = hash >> 32;
+	packet->page_size      = tcb_get_page_size(tcb);
+
+	if (kind == TM_TEXT_PROBE)
+		return dmni_send(packet, sizeof(tm_text_t), true, NULL, 0, false);
+
+	/* Align */
+	text_size = (text_size + 3) & ~3;
+
+	void *offset = tcb_get_offset(tcb);
+	
+	trace(TRACE_TM_TEXT_SENT, id, addr, text_size);
+	kdebug("Sending text of task %d to address %x with size %d\n", id, addr, text_size);
+
+    return dmni_send(packet, sizeof(tm_text_t), true, offset, text_size, false);
+}
+
+int tm_recv_text(tm_text_t *packet)
+{
+	if (packet->kind == TM_TEXT_HIT || packet->kind == TM_TEXT_MISS)
+		return _tm_text_answered(packet);
+
+	uint64_t hash = (((uint64_t)packet->hash_high) << 32) | packet->hash_low;
+	uint32_t text_size = (packet->size + 3) & ~3;
+
+	/* The full text after a miss goes to the TCB created by the probe */
+	tcb_t *tcb = (packet->kind == TM_TEXT_FULL) ? tcb_find(packet->task) : NULL;
+	if (tcb == NULL) {
+		tcb = _tm_text_tcb(packet);
+		if (tcb == NULL) {
+			if (packet->kind == TM_TEXT_FULL)
+				dmni_drop_payload(text_size >> 2);
+
+			return -ENOMEM;
+		}
+	}
+
+	void *offset = tcb_get_offset(tcb);
+
+	if (packet->kind == TM_TEXT_PROBE) {
+		bool hit = tcache_load(hash, text_size, offset);
+		trace(TRACE_TM_TEXT_RECV, packet->task, text_size, hit);
+		kdebug("Text of task %d %s in cache\n", packet->task, hit ? "found" : "not found");
+
+		if (hit)
+			tcb_cache_text(tcb, hash);
+
+		return _tm_text_answer(packet, hit ? TM_TEXT_HIT : TM_TEXT_MISS);
+	}
+
+	/* Obtain the program code */
+    int ret = dmni_recv(offset, text_size);
+	if (ret < 0)
+		return ret;
+
+	trace(TRACE_TM_TEXT_RECV, packet->task, text_size, false);
+	kdebug("Received text of task %d with size %lu\n", packet->task, text_size);
+
+	if (hash != 0)
+		tcb_cache_text(tcb, hash);
+
+	return 0;
+}
+
+tcb_t *_tm_text_tcb(tm_text_t *packet)
+{
+	tcb_t *tcb = malloc(sizeof(tcb_t));
+
+	if (tcb == NULL)
+		return NULL;
+
+	/* Initializes the TCB. The region size keeps the stack addresses valid */
+	int ret = tcb_alloc(tcb, packet->task, packet->size, 0, 0, packet->page_size, packet->mapper_task, packet->mapper_address, 0);
+	if (ret != 0) {
+		free(tcb);
+		return NULL;
+	}
+
+	ret = tcb_push_back(tcb);
+	if (ret != 0) {
+		tcb_remove(tcb);
+		return NULL;
+	}
+
+	return tcb;
+}
+
+int _tm_text_answer(tm_text_t *packet, tm_text_kind_t kind)
+{
+	tm_text_t *answer = pool_alloc(sizeof(tm_text_t));
+	if (answer == NULL)
+		return -ENOMEM;
+
+	answer->hermes.flags   = 0;
+	answer->hermes.service = MIGRATION_TEXT;
+	answer->hermes.address = packet->source;
+	answer->size           = packet->size;
+	answer->task           = packet->task;
+	answer->kind           = kind;
+	answer->source         = MMR_DMNI_INF_ADDRESS;
+
+	return dmni_send(answer, sizeof(tm_text_t), true, NULL, 0, false);
+}
+
+int _tm_text_answered(tm_text_t *packet)
+{
+	tl_t *probe = tl_find(&_tm_probes, packet->task);
+	if (probe == NULL)
+		return 0;
+
+	int addr = tl_get_addr(probe);
+	tl_remove(&_tm_probes, probe);
+
+	/* Terminated or aborted while waiting */
+	tcb_t *tcb = tcb_find(packet->task);
+	if (tcb == NULL || tcb_get_migrate_addr(tcb) != addr)
+		return 0;
+
+	if (packet->kind == TM_TEXT_MISS) {
+		/* Reserved first, so the TCB created by the probe can always be dropped */
+		tm_tcb_t *cancel = pool_alloc(sizeof(tm_tcb_t));
+		int ret = (cancel != NULL) ? _tm_send_text_kind(tcb, packet->task, addr, TM_TEXT_FULL) : -ENOMEM;
+		if (ret != 0) {
+			/* The target has no code for the task, so it must never receive it */
+			tcb_set_migrate_addr(tcb, -1);
+
+			if (cancel != NULL)
+				_tm_send_cancel(cancel, packet->task, addr);
+
+			trace(TRACE_TM_CANCELLED, packet->task, addr, -ret);
+			kerror("Text of task %d not sent to address %x: migration cancelled\n", packet->task, addr);
+			return ret;
+		}
+
+		pool_free(cancel);
+	} else {
+		_tm_stats.text_hits++;
+		_tm_stats.text_saved += (tcb_get_text_size(tcb) + 3) & ~3;
+	}
+
+	return tm_start(tcb);
+}
+
+int tm_start(tcb_t *tcb)
+{
+	int id = tcb_get_id(tcb);
+
+	/* Large tasks keep running while the data is sent, see tm_precopy */
+	if (tm_precopy(tcb) == 0)
+		return 0;
+
+	if (!msg_rxring_idle(tcb)) {
+		/* Retried when the ring drains, see sys_syscall */
+		kinfo("Task %d has messages in its inbound ring, cannot migrate\n", id);
+		return 0;
+	}
+
+	return tm_migrate(tcb);
+}
+
+int tm_migrate(tcb_t *tcb)
+{
+	kdebug("Migrating now\n");
+	uint64_t start = timer_get_time();
+
+	/* Get target address */
+	int addr = tcb_get_migrate_addr(tcb);
+	int id   = tcb_get_id(tcb);
+
+	tm_out_t *mig = pool_alloc(sizeof(tm_out_t));
+	if (mig == NULL)
+		return -ENOMEM;
+
+	mig->tcb    = tcb;
+	mig->start  = start;
+	mig->misses = sched_get_deadline_misses();
+
+	/* The last packet is reserved first: it also cancels a failed migration */
+	tm_tcb_t *packet = pool_alloc(sizeof(tm_tcb_t));
+	if (packet == NULL) {
+		pool_free(mig);
+		return -ENOMEM;
+	}
+
+	tm_fwd_t *fwd = _tm_emplace_back(id, addr);
+	if (fwd == NULL) {
+		pool_free(packet);
+		pool_free(mig);
+		return -ENOMEM;
+	}
+
+	/* Parts sent before the pipes leave the task state untouched */
+
+    /* Send data, bss and heap */
+    int ret = _tm_send_data(tcb, id, addr);
+	if (ret != 0)
+		return _tm_cancel(mig, packet, addr, ret);
+
+    /* Send stack */
+	ret = _tm_send_stack(tcb, id, addr);
+	if (ret != 0)
+		return _tm_cancel(mig, packet, addr, ret);
+
+	/* Send task location array */
+	ret = _tm_send_tl(tcb, id, addr);
+	if (ret != 0)
+		return _tm_cancel(mig, packet, addr, ret);
+
+	/* Send data available + message request fifo */
+	ret = _tm_send_hdshk(tcb, id, addr);
+	if (ret != 0)
+		return _tm_cancel(mig, packet, addr, ret);
+
+	/* Send pipes, all or none */
+	ret = _tm_send_opipe(tcb, id, addr);
+	if (ret != 0)
+		return _tm_cancel(mig, packet, addr, ret);
+
+	/* Send TCB and scheduler info. Cannot fail for lack of memory. */
+	_tm_send_tcb(mig, packet, id, addr);
+
+	/* The target holds the handshakes now */
+	list_t *davs = tcb_get_davs(tcb);
+	while (!list_empty(davs))
+		pool_free(list_pop_front(davs));
+
+	list_t *reqs = tcb_get_msgreqs(tcb);
+	while (!list_empty(reqs))
+		pool_free(list_pop_front(reqs));
+	
+	/* Code (.text) is in another function */
+	trace(TRACE_TM_MIGRATED, id, addr, 0);
+	kinfo(
+		"Task id %d migrated at time %u to processor %x\n", 
+		id, 
+		(unsigned)timer_get_time(), 
+		addr
+	);
+	
+	/* Update task location of tasks of the same app running locally */
+	app_update(tcb_get_app(tcb), id, addr);
+
+	/**
+	 * The task stops here, but its page and TCB are still being streamed.
+	 * They are released by _tm_sent, while other tasks run.
+	 */
+	tcb_detach(tcb);
+
+	/* Local handshakes with the task go straight to the target */
+	tcb_relocate(id, addr);
+
+	_tm_stats.kernel_time += timer_get_time() - start;
+	return 1;
+}
+
+void _tm_sent(void *arg)
+{
+	tm_out_t *mig = arg;
+	tcb_t *tcb = mig->tcb;
+
+	uint64_t stream_time = timer_get_time() - mig->start;
+	unsigned misses = sched_get_deadline_misses() - mig->misses;
+
+	_tm_stats.migrations++;
+	_tm_stats.stream_time += stream_time;
+	_tm_stats.rt_misses += misses;
+
+	trace(TRACE_TM_STREAMED, tcb_get_id(tcb), stream_time, misses);
+	kdebug(
+		"Task id %d streamed in %u cycles with %u RT misses\n", 
+		tcb_get_id(tcb), 
+		(unsigned)stream_time, 
+		misses
+	);
+
+	/* Peers stop sending to this PE, so the forwarding can be retired */
+	_tm_announce(tcb_get_app(tcb), tcb_get_id(tcb));
+
+	/* Nothing of the task is left in the send queue */
+	tcb_set_migrate_addr(tcb, -1);
+	tcb_remove(tcb);
+
+	pool_free(mig);
+}
+
+int _tm_cancel(tm_out_t *mig, tm_tcb_t *packet, int addr, int err)
+{
+	tcb_t *tcb = mig->tcb;
+	int id = tcb_get_id(tcb);
+
+	_tm_send_cancel(packet, id, addr);
+
+	/* Queued parts may point to the task page and app: let them leave */
+	dmni_flush();
+
+	tm_fwd_t *fwd = (tm_fwd_t*)tm_find(id);
+	if (fwd != NULL)
+		tl_remove(&_tms, &(fwd->tl));
+
+	tcb_set_migrate_addr(tcb, -1);
+	pool_free(mig);
+
+	trace(TRACE_TM_CANCELLED, id, addr, -err);
+	kerror("Migration of task %d to address %x failed with %d\n", id, addr, err);
+
+	return err;
+}
+
+void _tm_send_cancel(tm_tcb_t *packet, int id, int addr)
+{
+	packet->hermes.flags   = 0;
+	packet->hermes.service = MIGRATION_TCB;
+	packet->hermes.address = addr;
+	packet->task           = id;
+	packet->source         = MMR_DMNI_INF_ADDRESS;
+	packet->cancel         = true;
+
+	dmni_send(packet, sizeof(tm_tcb_t), true, NULL, 0, false);
+}
+
+const tm_stats_t *tm_get_stats()
+{
+	return &_tm_stats;
 }
 
-int tm_abort_task(int id, int addr)
+size_t _tm_data_size(tcb_t *tcb, size_t *heap_size)
 {
-	/* Send it like a MESSAGE_DELIVERY */
-	memphis_info_t *abort_task = malloc(sizeof(memphis_info_t));
-	if (abort_task == NULL)
-		return -ENOMEM;
+	size_t data_size  = tcb_get_data_size(tcb);
+	size_t bss_size   = tcb_get_bss_size(tcb);
 
-	abort_task->service = ABORT_TASK;
-	abort_task->task    = id;
+    /* Get the heap size */
+	void *heap_start = (void*)(MMR_DATA_BASE + data_size + bss_size);
+    void *heap_end   = tcb_get_heap_end(tcb);
+    size_t heap      = (heap_end - heap_start);
 
-	return msg_send_message_delivery(
-		abort_task, 
-		sizeof(memphis_info_t), 
-		MMR_DMNI_INF_ADDRESS, 
-		(MEMPHIS_KERNEL_MSG | addr), 
-		-1, 
-		-1
-	);
+	if (heap_size != NULL)
+		*heap_size = heap;
+
+	return ((data_size + bss_size + heap) + 3) & ~3;
 }
 
-void tm_clear_app(int id)
+int _tm_send_data_part(tcb_t *tcb, int id, int addr, size_t offset, void *pld, size_t size, tm_pre_t *pre)
 {
-	list_entry_t *entry = list_find(&_tms, &id, _tm_find_app_fnc);
-	while(entry != NULL){
-		tl_t *tl = list_get_data(entry);
-		// printf("************* Removed task %d from migration\n", tl->task);
-		list_remove(&_tms, entry);
-		free(tl);
-		entry = list_find(&_tms, &id, _tm_find_app_fnc);
+	size_t heap_size;
+	_tm_data_size(tcb, &heap_size);
+
+    tm_data_t *packet = pool_alloc(sizeof(tm_data_t));
+    if (packet == NULL)
+        return -ENOMEM;
+
+    packet->hermes.flags   = 0;
+    packet->hermes.service = MIGRATION_DATA;
+    packet->hermes.address = addr;
+    packet->data_size      = tcb_get_data_size(tcb);
+    packet->bss_size       = tcb_get_bss_size(tcb);
+    packet->heap_size      = heap_size;
+    packet->task           = id;
+	packet->offset         = offset;
+	packet->size           = size;
+
+	void *buf = _tm_encode(pld, size, &(packet->enc_size));
+
+	size_t pld_size = (packet->enc_size != 0) ? packet->enc_size : size;
+
+	if (pre == NULL) {
+		trace(TRACE_TM_DATA_SENT, id, offset, packet->enc_size);
+		kdebug("Sending data of task %d to address %x with size %d at %d (%d encoded)\n", id, addr, size, offset, packet->enc_size);
 	}
-}
 
-bool tm_empty()
-{
-	return list_empty(&_tms);
+	_tm_stats.image_bytes += size;
+	_tm_stats.wire_bytes  += pld_size;
+
+	dmni_out_t out = {
+		.pkt      = packet,
+		.pld      = (buf != NULL) ? buf : pld,
+		.stamp    = NULL,
+		.pkt_size = sizeof(tm_data_t),
+		.pld_size = pld_size,
+		.sent     = (pre != NULL) ? _tm_pre_sent : NULL,
+		.arg      = pre,
+		.pkt_free = true,
+		.pld_free = (buf != NULL)
+	};
+
+	return dmni_send_out(&out);
 }
 
-tl_t *_tm_emplace_back(int task, int addr)
+void *_tm_encode(const void *image, size_t size, uint32_t *enc_size)
 {
-	tl_t *tl = malloc(sizeof(tl_t));
+	*enc_size = 0;
 
-	if (tl == NULL)
+	if (!TM_COMPRESS || size == 0)
 		return NULL;
 
-	tl_set(tl, task, addr);
-
-	list_entry_t *entry = list_push_back(&_tms, tl);
+	size_t max = size - (size >> 3);
+	void *buf = malloc(max);
+	if (buf == NULL)
+		return NULL;
 
-	if(entry == NULL){
-		free(tl);
+	*enc_size = zrle_encode(image, size, buf, max);
+	if (*enc_size == 0) {
+		free(buf);
 		return NULL;
 	}
 
-	return tl;
+	return buf;
 }
 
-bool _tm_find_app_fnc(void *data, void* cmpval)
+int _tm_recv_image(void *dst, size_t size, size_t enc_size)
 {
-	tl_t *tl = (tl_t*)data;
-	int app_id = *((int*)cmpval);
+	if (enc_size == 0)
+		return (dmni_recv(dst, size) == size) ? size : -EINVAL;
+
+	uint32_t *out = dst;
+	size_t out_words = size >> 2;
+	size_t in_words = enc_size >> 2;
+	size_t o = 0;
+	size_t i = 0;
+	while (i < in_words) {
+		/* {zeros, literals}, see zrle.h */
+		uint32_t header;
+		if (dmni_recv(&header, sizeof(header)) != sizeof(header))
+			return -EINVAL;
+
+		i++;
+		unsigned zeros = header >> 16;
+		unsigned literals = header & 0xFFFF;
+
+		if (o + zeros + literals > out_words || i + literals > in_words) {
+			dmni_drop_payload(in_words - i);
+			return -EINVAL;
+		}
 
-	return (((tl->task >> 8) & 0xFF) == app_id);
+		memset(&out[o], 0, zeros << 2);
+		o += zeros;
+
+		if (literals != 0 && dmni_recv(&out[o], literals << 2) != (literals << 2))
+			return -EINVAL;
+
+		o += literals;
+		i += literals;
+	}
+
+	return (o == out_words) ? size : -EINVAL;
 }
 
-int tm_send_text(tcb_t *tcb, int id, int addr)
+int _tm_broken_image(int task, int err)
 {
-	printf("Sending text of task %d to address %x\n", id, addr);
-	tm_text_t *packet = malloc(sizeof(tm_text_t));
-	if (packet == NULL)
+	kerror("Image of migrating task %d not received whole (%d)\n", task, err);
+
+	if (tl_find(&_tm_broken, task) == NULL && tl_emplace_back(&_tm_broken, task, -1) == NULL)
 		return -ENOMEM;
 
-	tl_t *mapper = tcb_get_mapper(tcb);
-	size_t text_size = tcb_get_text_size(tcb);
+	return err;
+}
 
-	packet->hermes.flags   = 0;
-    packet->hermes.service = MIGRATION_TEXT;
-    packet->hermes.address = addr;
-    packet->size           = text_size; 
-    packet->mapper_address = tl_get_addr(mapper);
-    packet->task           = id;
-    packet->mapper_task    = tl_get_task(mapper);
+int _tm_send_data(tcb_t *tcb, int id, int addr)
+{
+	size_t total_size = _tm_data_size(tcb, NULL);
+	void *section = tcb_get_offset(tcb) + tcb_get_text_size(tcb);
 
-	/* Align */
-	text_size = (text_size + 3) & ~3;
+	tm_pre_t *pre = _tm_pre_find(tcb);
+	if (pre == NULL) {
+		if (total_size == 0)
+			return 0;
 
-	void *offset = tcb_get_offset(tcb);
-	
-	printf("Sending text of task %d to address %x with size %d\n", id, addr, text_size);
+		_tm_stats.stop_bytes += total_size;
+		return _tm_send_data_part(tcb, id, addr, 0, section, total_size, NULL);
+	}
 
-    return dmni_send(packet, sizeof(tm_text_t), true, offset, text_size, false);
+	/* Stop-and-copy: the task is stopped, so blocks are sent from its page */
+	int ret = 0;
+	size_t sent = 0;
+	size_t run_start = 0;
+	size_t run_size = 0;
+	unsigned blocks = (total_size + TM_PRECOPY_BLOCK - 1) / TM_PRECOPY_BLOCK;
+	for (unsigned i = 0; i <= blocks && ret == 0; i++) {
+		bool dirty = false;
+		size_t offset = i * TM_PRECOPY_BLOCK;
+		size_t size = 0;
+		if (i < blocks) {
+			size = (total_size - offset < TM_PRECOPY_BLOCK) ? (total_size - offset) : TM_PRECOPY_BLOCK;
+			dirty = _tm_block_dirty(pre, section, i, size);
+		}
+
+		if (dirty) {
+			/* Consecutive changed blocks go in the same packet */
+			if (run_size == 0)
+				run_start = offset;
+			run_size += size;
+			continue;
+		}
+
+		if (run_size != 0) {
+			ret = _tm_send_data_part(tcb, id, addr, run_start, section + run_start, run_size, NULL);
+			sent += run_size;
+			run_size = 0;
+		}
+	}
+
+	/* Sizes are updated even if no block changed */
+	if (ret == 0 && sent == 0)
+		ret = _tm_send_data_part(tcb, id, addr, 0, NULL, 0, NULL);
+
+	kdebug("Sending %d of %d bytes of data of task %d to address %x\n", sent, total_size, id, addr);
+	_tm_stats.stop_bytes += sent;
+
+	_tm_pre_remove(pre);
+
+	return ret;
 }
 
-int tm_recv_text(tm_text_t *packet)
+int tm_precopy(tcb_t *tcb)
 {
-	tcb_t *tcb = malloc(sizeof(tcb_t));
+	size_t total_size = _tm_data_size(tcb, NULL);
+	if (!TM_PRECOPY || total_size < TM_PRECOPY_MIN_BLOCKS*TM_PRECOPY_BLOCK)
+		return -ENOSPC;
 
-	if (tcb == NULL)
+	unsigned cap = (total_size + TM_PRECOPY_BLOCK - 1) / TM_PRECOPY_BLOCK;
+
+	tm_pre_t *pre = malloc(sizeof(tm_pre_t) + cap*sizeof(uint16_t));
+	if (pre == NULL)
 		return -ENOMEM;
 
-	list_entry_t *entry = tcb_push_back(tcb);
-	if (entry == NULL) {
-		free(tcb);
+	/* Compared word by word at stop, so no write is missed */
+	pre->copy = malloc(cap*TM_PRECOPY_BLOCK);
+	if (pre->copy == NULL) {
+		free(pre);
 		return -ENOMEM;
 	}
 
-	/* Initializes the TCB */
-	tcb_alloc(tcb, packet->task, packet->size, 0, 0, packet->mapper_task, packet->mapper_address, 0);
-
-	uint32_t text_size = (packet->size + 3) & ~3;
+	memset(pre->len, 0, cap*sizeof(uint16_t));
+
+	pre->tcb       = tcb;
+	pre->id        = tcb_get_id(tcb);
+	pre->addr      = tcb_get_migrate_addr(tcb);
+	pre->round     = 0;
+	pre->next      = 0;
+	pre->dirty     = 0;
+	pre->cap       = cap;
+	pre->inflight  = false;
+	pre->converged = false;
+	timer_evt_init(&(pre->evt), _tm_pre_stop, pre);
+
+	if (list_push_back(&_tm_pres, pre) == NULL) {
+		free(pre->copy);
+		free(pre);
+		return -ENOMEM;
+	}
 
-	/* Obtain the program code */
-	void *offset = tcb_get_offset(tcb);
-    int ret = dmni_recv(offset, text_size);
-	if (ret < 0)
-		return ret;
+	trace(TRACE_TM_PRECOPY, pre->id, pre->addr, total_size);
+	kdebug("Pre-copying data of task %d to address %x with size %d\n", pre->id, pre->addr, total_size);
 
-	printf("Received text of task %d with size %lu\n", packet->task, text_size);
+	_tm_pre_step(pre);
 
 	return 0;
 }
 
-int tm_migrate(tcb_t *tcb)
+bool tm_can_stop(tcb_t *tcb)
 {
-	printf("Migrating now\n");
-	/* Get target address */
-	int addr = tcb_get_migrate_addr(tcb);
-	int id   = tcb_get_id(tcb);
+	if (tl_find(&_tm_probes, tcb_get_id(tcb)) != NULL)
+		return false;
 
-	tl_t *tm = _tm_emplace_back(id, addr);
-	if (tm == NULL)
-		return -ENOMEM;
+	tm_pre_t *pre = _tm_pre_find(tcb);
 
-    /* Send data, bss and heap */
-    int ret = _tm_send_data(tcb, id, addr);
-	if (ret != 0)
-		return ret;
+	return (pre == NULL || pre->converged);
+}
 
-    /* Send stack */
-	ret = _tm_send_stack(tcb, id, addr);
-	if (ret != 0)
-		return ret;
+bool _tm_block_dirty(tm_pre_t *pre, void *section, unsigned i, size_t size)
+{
+	if (i >= pre->cap || pre->len[i] != size)
+		return true;
 
-	/* Send data available + message request fifo */
-	ret = _tm_send_hdshk(tcb, id, addr);
-	if (ret != 0)
-		return ret;
+	size_t offset = i * TM_PRECOPY_BLOCK;
+	return (memcmp(pre->copy + offset, section + offset, size) != 0);
+}
 
-	/* Send pipe */
-	ret = _tm_send_opipe(tcb, id, addr);
-	if (ret != 0)
-		return ret;
+void _tm_pre_step(tm_pre_t *pre)
+{
+	if (!_tm_pre_alive(pre)) {
+		_tm_pre_remove(pre);
+		return;
+	}
 
-	/* Send task location array */
-	ret = _tm_send_tl(tcb, id, addr);
-	if (ret != 0)
-		return ret;
+	tcb_t *tcb = pre->tcb;
+	size_t total_size = _tm_data_size(tcb, NULL);
+	void *section = tcb_get_offset(tcb) + tcb_get_text_size(tcb);
+	unsigned blocks = (total_size + TM_PRECOPY_BLOCK - 1) / TM_PRECOPY_BLOCK;
+	if (blocks > pre->cap)
+		blocks = pre->cap;
+
+	while (true) {
+		while (pre->next < blocks) {
+			unsigned i = pre->next++;
+			size_t offset = i * TM_PRECOPY_BLOCK;
+			size_t size = (total_size - offset < TM_PRECOPY_BLOCK) ? (total_size - offset) : TM_PRECOPY_BLOCK;
+
+			if (!_tm_block_dirty(pre, section, i, size))
+				continue;
+
+			/* The DMNI reads the copy while the task runs */
+			memcpy(pre->copy + offset, section + offset, size);
+			pre->len[i] = size;
+
+			if (_tm_send_data_part(tcb, pre->id, pre->addr, offset, pre->copy + offset, size, pre) != 0) {
+				pre->len[i] = 0;
+				break;
+			}
+
+			pre->dirty++;
+			pre->inflight = true;
+			_tm_stats.precopy_bytes += size;
+			return;
+		}
 
-	/* Send TCB and scheduler info */
-	ret = _tm_send_tcb(tcb, id, addr);
-	if (ret != 0)
-		return ret;
-	
-	/* Code (.text) is in another function */
-	/**
-	 * @todo
-	 * Create a function to get the 64-bit timer
-	 */
-	printf(
-		"Task id %d migrated at time %d to processor %x\n", 
-		id, 
-		MMR_RTC_MTIME, 
-		addr
-	);
-	
-	/* Update task location of tasks of the same app running locally */
-	app_update(tcb_get_app(tcb), id, addr);
-	tcb_remove(tcb);
-	return 1;
+		/* Out of memory or end of round with few blocks written: stop the task */
+		if (pre->next < blocks || pre->dirty <= TM_PRECOPY_STOP_BLOCKS || pre->round + 1 >= TM_PRECOPY_ROUNDS)
+			break;
+
+		pre->round++;
+		pre->next  = 0;
+		pre->dirty = 0;
+	}
+
+	trace(TRACE_TM_CONVERGED, pre->id, pre->round + 1, 0);
+	kdebug("Pre-copy of task %d converged after %u rounds\n", pre->id, pre->round + 1);
+
+	pre->converged = true;
+	timer_set(&(pre->evt), timer_get_time());
 }
 
-int _tm_send_data(tcb_t *tcb, int id, int addr)
+void _tm_pre_sent(void *arg)
 {
-	size_t data_size  = tcb_get_data_size(tcb);
-	size_t bss_size   = tcb_get_bss_size(tcb);
+	tm_pre_t *pre = arg;
+	pre->inflight = false;
+
+	/* Removed while the block was being sent */
+	if (pre->tcb == NULL) {
+		free(pre->copy);
+		free(pre);
+		return;
+	}
 
-    /* Get the heap size */
-	void *heap_start = (void*)(MMR_DATA_BASE + data_size + bss_size);
-    void *heap_end   = tcb_get_heap_end(tcb);
-    size_t heap_size = (heap_end - heap_start);
+	_tm_pre_step(pre);
+}
 
-	size_t total_size = ((data_size + bss_size + heap_size) + 3) & ~3;
+void _tm_pre_stop(void *arg)
+{
+	tm_pre_t *pre = arg;
 
-	if (total_size == 0)
-		return 0;
+	if (!_tm_pre_alive(pre) || tcb_has_called_exit(pre->tcb)) {
+		_tm_pre_remove(pre);
+		return;
+	}
 
-    tm_data_t *packet = malloc(sizeof(tm_data_t));
-    if (packet == NULL)
-        return -ENOMEM;
+	tcb_t *tcb = pre->tcb;
+	if (!msg_rxring_idle(tcb)) {
+		/* The delivery paths can also migrate it when ready */
+		timer_set(&(pre->evt), timer_get_time() + TM_PRECOPY_RETRY);
+		return;
+	}
 
-    packet->hermes.flags   = 0;
-    packet->hermes.service = MIGRATION_DATA;
-    packet->hermes.address = addr;
-    packet->data_size      = data_size;
-    packet->bss_size       = bss_size;
-    packet->heap_size      = heap_size;
-    packet->task           = id;
+	tm_migrate(tcb);
+}
+
+bool _tm_pre_alive(tm_pre_t *pre)
+{
+	return (tcb_find(pre->id) == pre->tcb && tcb_get_migrate_addr(pre->tcb) == pre->addr);
+}
+
+void _tm_pre_remove(tm_pre_t *pre)
+{
+	list_entry_t *entry = list_find(&_tm_pres, pre->tcb, _tm_pre_find_fnc);
+	if (entry != NULL)
+		list_remove(&_tm_pres, entry);
 
-	printf("Sending data of task %d to address %x with size %d\n", id, addr, total_size);
+	timer_cancel(&(pre->evt));
 
-    return dmni_send(packet, sizeof(tm_data_t), true, tcb_get_offset(tcb) + tcb_get_text_size(tcb), total_size, false);
+	if (pre->inflight) {
+		pre->tcb = NULL;
+		return;
+	}
+
+	free(pre->copy);
+	free(pre);
+}
+
+tm_pre_t *_tm_pre_find(tcb_t *tcb)
+{
+	list_entry_t *entry = list_find(&_tm_pres, tcb, _tm_pre_find_fnc);
+	if (entry == NULL)
+		return NULL;
+
+	return list_get_data(entry);
+}
+
+bool _tm_pre_find_fnc(void *data, void *cmpval)
+{
+	tm_pre_t *pre = data;
+	tcb_t *tcb = cmpval;
+
+	return (pre->tcb == tcb);
 }
 
 int tm_recv_data(tm_data_t *packet)
@@ -361,13 +1379,15 @@ int tm_recv_data(tm_data_t *packet)
     void *heap_end = heap_start + packet->heap_size;
     tcb_set_brk(tcb, heap_end);
 
-	size_t total_size = ((packet->data_size + packet->bss_size + packet->heap_size) + 3) & ~3;
+	if (packet->size == 0)
+		return 0;
 
-    int ret = dmni_recv(tcb_get_offset(tcb) + tcb_get_text_size(tcb), total_size);
-	if (ret < 0)
-		return ret;
+    int ret = _tm_recv_image(tcb_get_offset(tcb) + tcb_get_text_size(tcb) + packet->offset, packet->size, packet->enc_size);
+	if (ret != packet->size)
+		return _tm_broken_image(packet->task, ret);
 
-	printf("Received data of task %d with size %u\n", packet->task, total_size);
+	trace(TRACE_TM_DATA_RECV, packet->task, packet->offset, packet->enc_size);
+	kdebug("Received data of task %d with size %u at %u (%u encoded)\n", packet->task, packet->size, packet->offset, packet->enc_size);
 
 	return 0;
 }
@@ -375,12 +1395,12 @@ int tm_recv_data(tm_data_t *packet)
 int _tm_send_stack(tcb_t *tcb, int id, int addr)
 {
 	/* Get the stack pointer */
-	size_t stack_size = (((MMR_DMNI_INF_DMEM_PAGE_SZ - (tcb_get_sp(tcb) - MMR_DATA_BASE)) + 3) & ~3);
+	size_t stack_size = (((tcb_get_page_size(tcb) - (tcb_get_sp(tcb) - MMR_DATA_BASE)) + 3) & ~3);
 
 	if (stack_size == 0)
 		return 0;
 
-    tm_stack_t *packet = malloc(sizeof(tm_stack_t));
+    tm_stack_t *packet = pool_alloc(sizeof(tm_stack_t));
     if (packet == NULL)
         return -ENOMEM;
 
@@ -390,9 +1410,21 @@ int _tm_send_stack(tcb_t *tcb, int id, int addr)
     packet->size           = stack_size;
     packet->task           = id;
 
-	printf("Sending stack of task %d to address %x with size %d\n", id, addr, stack_size);
+	void *stack = (tcb_get_offset(tcb) + MMR_DATA_BASE) + (tcb_get_page_size(tcb) - stack_size);
+	void *buf = _tm_encode(stack, stack_size, &(packet->enc_size));
+
+	trace(TRACE_TM_STACK_SENT, id, stack_size, packet->enc_size);
+	kdebug("Sending stack of task %d to address %x with size %d (%d encoded)\n", id, addr, stack_size, packet->enc_size);
+
+	_tm_stats.image_bytes += stack_size;
 
-    return dmni_send(packet, sizeof(tm_stack_t), true, (tcb_get_offset(tcb) + MMR_DATA_BASE) + (MMR_DMNI_INF_DMEM_PAGE_SZ - stack_size), stack_size, false);
+	if (buf == NULL) {
+		_tm_stats.wire_bytes += stack_size;
+		return dmni_send(packet, sizeof(tm_stack_t), true, stack, stack_size, false);
+	}
+
+	_tm_stats.wire_bytes += packet->enc_size;
+	return dmni_send(packet, sizeof(tm_stack_t), true, buf, packet->enc_size, true);
 }
 
 int tm_recv_stack(tm_stack_t *packet)
@@ -402,11 +1434,12 @@ int tm_recv_stack(tm_stack_t *packet)
 	if (tcb == NULL)
 		return -EINVAL;
 
-	int ret = dmni_recv((tcb_get_offset(tcb) + MMR_DATA_BASE) + (MMR_DMNI_INF_DMEM_PAGE_SZ - packet->size), packet->size);
-	if (ret < 0)
-		return ret;
+	int ret = _tm_recv_image((tcb_get_offset(tcb) + MMR_DATA_BASE) + (tcb_get_page_size(tcb) - packet->size), packet->size, packet->enc_size);
+	if (ret != packet->size)
+		return _tm_broken_image(packet->task, ret);
 
-	printf("Received stack of task %d with size %lu\n", packet->task, packet->size);
+	trace(TRACE_TM_STACK_RECV, packet->task, packet->size, packet->enc_size);
+	kdebug("Received stack of task %d with size %lu (%lu encoded)\n", packet->task, packet->size, packet->enc_size);
 
 	return 0;
 }
@@ -427,18 +1460,15 @@ int _tm_send_hdshk(tcb_t *tcb, int id, int addr)
 	if (hdshk == NULL)
 		return -ENOMEM;
 
-	list_vectorize(davs, &hdshk[0], sizeof(tl_t));
-	list_vectorize(reqs, &hdshk[available_size], sizeof(tl_t));
-	
-	list_clear(davs);
-	list_clear(reqs);
-
-	tm_hdshk_t *packet = malloc(sizeof(tm_hdshk_t));
+	tm_hdshk_t *packet = pool_alloc(sizeof(tm_hdshk_t));
 	if (packet == NULL) {
 		free(hdshk);
 		return -ENOMEM;
 	}
 
+	list_vectorize(davs, &hdshk[0], sizeof(tl_t));
+	list_vectorize(reqs, &hdshk[available_size], sizeof(tl_t));
+
 	packet->hermes.flags   = 0;
 	packet->hermes.service = MIGRATION_HDSHK;
 	packet->hermes.address = addr;
@@ -446,7 +1476,8 @@ int _tm_send_hdshk(tcb_t *tcb, int id, int addr)
 	packet->request_size   = request_size;
 	packet->task           = id;
 
-	printf("Sending hdshk %d to address %x with size %d\n", id, addr, total_size);
+	trace(TRACE_TM_HDSHK_SENT, id, addr, total_size);
+	kdebug("Sending hdshk %d to address %x with size %d\n", id, addr, total_size);
 
 	return dmni_send(packet, sizeof(tm_hdshk_t), true, hdshk, total_size*sizeof(tl_t), true);
 }
@@ -467,9 +1498,10 @@ int tm_recv_hdshk(tm_hdshk_t *packet)
 	if (ret < 0)
 		return ret;
 	
+	/* Each entry is allocated on its own so it can be released by tl_remove */
 	list_t *davs = tcb_get_davs(tcb);
 	for (int i = 0; i < packet->available_size; i++){
-		if (list_push_back(davs, &(vec[i])) == NULL) {
+		if (tl_emplace_back(davs, vec[i].task, vec[i].addr) == NULL) {
 			/**
 			 * @todo clear structure
 			 */
@@ -480,7 +1512,8 @@ int tm_recv_hdshk(tm_hdshk_t *packet)
 
 	list_t *reqs = tcb_get_msgreqs(tcb);
 	for (int i = 0; i < packet->request_size; i++){
-		if (list_push_back(reqs, &(vec[packet->available_size + i])) == NULL) {
+		tl_t *tl = &(vec[packet->available_size + i]);
+		if (tl_emplace_back(reqs, tl->task, tl->addr) == NULL) {
 			/**
 			 * @todo clear structure
 			 */
@@ -489,42 +1522,60 @@ int tm_recv_hdshk(tm_hdshk_t *packet)
 		}
 	}
 
-	printf("Received hdshk of task id %d with size %u\n", packet->task, total_size);
+	free(vec);
+
+	trace(TRACE_TM_HDSHK_RECV, packet->task, total_size, 0);
+	kdebug("Received hdshk of task id %d with size %u\n", packet->task, total_size);
 
 	return 0;
 }
 
 int _tm_send_opipe(tcb_t *tcb, int id, int addr)
 {
-	opipe_t *opipe = tcb_get_opipe(tcb);
-
-	if (opipe != NULL)
-		printf("Has pipe\n");
-
-	if (opipe == NULL)
-		return 0;
+	if (tcb_has_opipe(tcb))
+		kdebug("Has pipe\n");
 
-	size_t size;
-	void* buf = opipe_get_buf(opipe, &size);
-
-	tm_opipe_t *packet = malloc(sizeof(tm_opipe_t));
-	if (packet == NULL)
+	/* The DMNI frees the payload, so it cannot point to the producer page */
+	if (msg_materialize(tcb) != 0)
 		return -ENOMEM;
 
-	packet->hermes.flags   = 0;
-	packet->hermes.service = MIGRATION_PIPE;
-	packet->hermes.address = addr;
-	packet->receiver       = opipe_get_receiver(opipe);
-	packet->task           = id;
-	packet->size           = size;
+	/* The DMNI frees each buffer, so no pipe is released before all can be sent */
+	tm_opipe_t *packets[TCB_OPIPE_SLOTS];
+	unsigned cnt = TCB_OPIPE_SLOTS - tcb_get_opipe_free(tcb);
+	for (unsigned i = 0; i < cnt; i++) {
+		packets[i] = pool_alloc(sizeof(tm_opipe_t));
+		if (packets[i] == NULL) {
+			while (i != 0)
+				pool_free(packets[--i]);
+
+			return -ENOMEM;
+		}
+	}
 
-	size_t align_size = (size + 3) & ~3;
+	/* Pipes are sent oldest first, so the target recreates them in order */
+	for (unsigned i = 0; i < cnt; i++) {
+		opipe_t *opipe = tcb_get_opipe_at(tcb, 0);
+		size_t size;
+		void* buf = opipe_get_buf(opipe, &size);
+
+		tm_opipe_t *packet = packets[i];
+		packet->hermes.flags   = 0;
+		packet->hermes.service = MIGRATION_PIPE;
+		packet->hermes.address = addr;
+		packet->receiver       = opipe_get_receiver(opipe);
+		packet->task           = id;
+		packet->size           = size;
+
+		size_t align_size = (size + 3) & ~3;
+
+		trace(TRACE_TM_PIPE_SENT, id, addr, align_size);
+		kdebug("Sending pipe of task %d to address %x with size %d\n", id, addr, align_size);
+		
+		dmni_send(packet, sizeof(tm_opipe_t), true, buf, align_size, true);
+		tcb_destroy_opipe(tcb, opipe);
+	}
 
-	printf("Sending pipe of task %d to address %x with size %d\n", id, addr, align_size);
-	
-	int ret = dmni_send(packet, sizeof(tm_opipe_t), true, buf, align_size, true);
-	tcb_destroy_opipe(tcb);
-	return ret;
+	return 0;
 }
 
 int tm_recv_opipe(tm_opipe_t *packet)
@@ -544,7 +1595,8 @@ int tm_recv_opipe(tm_opipe_t *packet)
 	if (result != packet->size)
 		return -ENOMEM;
 
-	printf("Received pipe of task id %d with size %lu\n", packet->task, packet->size);
+	trace(TRACE_TM_PIPE_RECV, packet->task, packet->size, 0);
+	kdebug("Received pipe of task id %d with size %lu\n", packet->task, packet->size);
 
 	return result;
 }
@@ -554,14 +1606,18 @@ int _tm_send_tl(tcb_t *tcb, int id, int addr)
 	app_t *app = tcb_get_app(tcb);
 	size_t task_cnt = app_get_task_cnt(app);
 
-	tm_tl_t *packet = malloc(sizeof(tm_tl_t));
+	tm_tl_t *packet = pool_alloc(sizeof(tm_tl_t));
+	if (packet == NULL)
+		return -ENOMEM;
+
 	packet->hermes.flags   = 0;
 	packet->hermes.service = MIGRATION_TASK_LOCATION;
 	packet->hermes.address = addr;
 	packet->task           = id;
 	packet->task_cnt       = task_cnt;
 
-	printf("Sending task location of task %d to address %x with size %d\n", id, addr, packet->task_cnt);
+	trace(TRACE_TM_TL_SENT, id, addr, packet->task_cnt);
+	kdebug("Sending task location of task %d to address %x with size %d\n", id, addr, packet->task_cnt);
 
 	return dmni_send(packet, sizeof(tm_tl_t), true, app_get_locations(app), task_cnt*sizeof(int), false);
 }
@@ -590,24 +1646,34 @@ int tm_recv_tl(tm_tl_t *packet)
 		tmploc = NULL;
 	}
 
-	printf("Received app of task id %d with size %u\n", packet->task, packet->task_cnt);
+	trace(TRACE_TM_TL_RECV, packet->task, packet->task_cnt, 0);
+	kdebug("Received app of task id %d with size %u\n", packet->task, packet->task_cnt);
 
 	return received;
 }
 
-int _tm_send_tcb(tcb_t *tcb, int id, int addr)
+int _tm_send_tcb(tm_out_t *mig, tm_tcb_t *packet, int id, int addr)
 {
+	tcb_t *tcb = mig->tcb;
 	sched_t *sched = tcb_get_sched(tcb);
 	uint16_t received = 0;
+	void *posted_buf = NULL;
+	size_t posted_size = 0;
 	ipipe_t *ipipe = tcb_get_ipipe(tcb);
 	if (ipipe != NULL) {
-		received = ipipe_get_size(ipipe);
+		if (ipipe_is_read(ipipe)) {
+			received = ipipe_get_size(ipipe);
+		} else if (sched_is_waiting_delivery(sched)) {
+			/* The delivery requested is forwarded to the target, see msg_recv_message_delivery */
+			posted_buf = ipipe->buf;
+			posted_size = ipipe->size;
+		}
+
+		/* A buffer posted for a local producer is posted again after migration */
 		tcb_destroy_ipipe(tcb);
 	}
 
 	/* Send TCB */
-	tm_tcb_t *packet = malloc(sizeof(tm_tcb_t));
-
 	packet->hermes.flags = 0;
 	packet->hermes.service = MIGRATION_TCB;
 	packet->hermes.address = addr;
@@ -619,10 +1685,32 @@ int _tm_send_tcb(tcb_t *tcb, int id, int addr)
 	packet->source         = MMR_DMNI_INF_ADDRESS;
 	packet->waiting        = sched_get_waiting_msg(sched);
 	packet->received       = received;
-
-	printf("Sending TCB of task %d to address %x\n", id, addr);
-
-	return dmni_send(packet, sizeof(tm_tcb_t), true, tcb_get_regs(tcb), HAL_MAX_REGISTERS*sizeof(int), false);
+	packet->posted_buf     = (uint32_t)posted_buf;
+	packet->posted_size    = posted_size;
+	packet->cancel         = false;
+
+	/* Only the ring registration: the task migrates when the ring is idle */
+	rxring_t *rxring = tcb_get_rxring(tcb);
+	packet->rx_buf       = (rxring != NULL) ? (uint32_t)rxring->buf : 0;
+	packet->rx_slot_size = (rxring != NULL) ? rxring->slot_size : 0;
+	packet->rx_slots     = (rxring != NULL) ? rxring->slots : 0;
+
+	trace(TRACE_TM_TCB_SENT, id, addr, 0);
+	kdebug("Sending TCB of task %d to address %x\n", id, addr);
+
+	dmni_out_t out = {
+		.pkt      = packet,
+		.pld      = tcb_get_regs(tcb),
+		.stamp    = NULL,
+		.pkt_size = sizeof(tm_tcb_t),
+		.pld_size = HAL_MAX_REGISTERS*sizeof(int),
+		.sent     = _tm_sent,
+		.arg      = mig,
+		.pkt_free = true,
+		.pld_free = false
+	};
+
+	return dmni_send_out(&out);
 }
 
 int tm_recv_tcb(tm_tcb_t *packet)
@@ -631,6 +1719,30 @@ int tm_recv_tcb(tm_tcb_t *packet)
 	if (tcb == NULL)
 		return -EINVAL;
 
+	tl_t *broken = tl_find(&_tm_broken, packet->task);
+	if (broken != NULL)
+		tl_remove(&_tm_broken, broken);
+
+	if (packet->cancel) {
+		trace(TRACE_TM_CANCELLED, packet->task, packet->source, 0);
+		kinfo("Migration of task %d from processor %x cancelled\n", packet->task, packet->source);
+
+		_tm_drop_state(tcb);
+		tcb_remove(tcb);
+		return 0;
+	}
+
+	if (broken != NULL) {
+		/* The source has released the task: the mapper is told it is lost */
+		trace(TRACE_TM_CANCELLED, packet->task, packet->source, EINVAL);
+		kerror("Task %d aborted: its image did not arrive whole\n", packet->task);
+
+		dmni_drop_payload(HAL_MAX_REGISTERS);
+		_tm_drop_state(tcb);
+		tcb_abort_task(tcb);
+		return 0;
+	}
+
 	sched_t *sched = sched_emplace_back(tcb);
 	if (sched == NULL)
 		return -ENOMEM;
@@ -641,6 +1753,20 @@ int tm_recv_tcb(tm_tcb_t *packet)
 			return -ENOMEM;
 
 		ipipe_set_read(ipipe, packet->received);
+	} else if (packet->posted_size != 0) {
+		ipipe_t *ipipe = tcb_create_ipipe(tcb);
+		if (ipipe == NULL)
+			return -ENOMEM;
+
+		ipipe_set(ipipe, (void*)(packet->posted_buf), packet->posted_size);
+	}
+
+	if (packet->rx_slots != 0) {
+		rxring_t *rxring = tcb_create_rxring(tcb);
+		if (rxring == NULL)
+			return -ENOMEM;
+
+		rxring_init(rxring, (void*)(packet->rx_buf), packet->rx_slot_size, packet->rx_slots);
 	}
 
 	if (packet->period != 0)
@@ -650,15 +1776,19 @@ int tm_recv_tcb(tm_tcb_t *packet)
 
 	sched_set_waiting_msg(sched, packet->waiting);
 
+	/* DATA_AVs migrated with the task go to the ring */
+	msg_rxring_fill(tcb);
+
 	app_t *app = tcb_get_app(tcb);
 	app_update(app, packet->task, MMR_DMNI_INF_ADDRESS);
 
 	dmni_recv(tcb_get_regs(tcb), HAL_MAX_REGISTERS*sizeof(int));
 
-	printf(
-		"Task id %d allocated by task migration at time %d from processor %x\n", 
+	trace(TRACE_TM_TCB_RECV, packet->task, packet->source, 0);
+	kinfo(
+		"Task id %d allocated by task migration at time %u from processor %x\n", 
 		packet->task, 
-		MMR_RTC_MTIME, 
+		(unsigned)timer_get_time(), 
 		packet->source
 	);
 
@@ -675,3 +1805,20 @@ int tm_recv_tcb(tm_tcb_t *packet)
 
 	return 1;
 }
+
+void _tm_drop_state(tcb_t *tcb)
+{
+	list_t *davs = tcb_get_davs(tcb);
+	while (!list_empty(davs))
+		pool_free(list_pop_front(davs));
+
+	list_t *reqs = tcb_get_msgreqs(tcb);
+	while (!list_empty(reqs))
+		pool_free(list_pop_front(reqs));
+
+	opipe_t *opipe;
+	while ((opipe = tcb_get_opipe_at(tcb, 0)) != NULL) {
+		opipe_pop(opipe);
+		tcb_destroy_opipe(tcb, opipe);
+	}
+}
@@ -21,8 +21,8 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
+#include <errno.h>
 
-#include <mutils/list.h>
 #include <memphis/services.h>
 #include <memphis/monitor.h>
 
@@ -32,6 +32,10 @@
 #include <llm.h>
 #include <mmr.h>
 #include <mpipe.h>
+#include <timer.h>
+#include <pool.h>
+#include <perf.h>
+#include <trace.h>
 
 static const unsigned SCHED_MAX_TIME_SLICE = 100000;	//!< Standard time slice value for task execution
 static const unsigned REPORT_SCHEDULER = 0x40000;
@@ -41,36 +45,169 @@ static const int SCHED_NO_DEADLINE = -1;	//!< A task that is best-effort have it
 
 tcb_t *current = NULL;
 
-unsigned total_slack_time = 0;	//!< Store the total of the processor idle time
+uint64_t total_slack_time = 0;	//!< Store the total of the processor idle time
 unsigned cpu_utilization = 0;	//!< RT CPU utilization, only filled with RT constraints
 unsigned time_slice = 0;		//!< Time slice used to configure the processor to generate an interruption
-unsigned last_idle_time = 0;	//!< Store the last idle time duration
+uint64_t last_idle_time = 0;	//!< Store the last idle time duration
 
-list_t _scheds;
+size_t   _sched_cnt = 0;			//!< Number of schedulers in the PE
+bool     _sched_tickless = false;	//!< No time slice is programmed for the running task
+sched_t *_sched_running = NULL;	//!< Scheduler selected by the last LST call
+sched_t *_sched_be = NULL;		//!< Next BE task of the round-robin ring
+unsigned _sched_deadline_misses = 0;	//!< RT jobs released again before finishing
+pqueue_t _sched_ready;			//!< Ready RT tasks, least slack time first
 
-void sched_init()
+int sched_init()
 {
-	list_init(&_scheds);
+	const unsigned MAX_TASKS = (MMR_DMNI_INF_MANYCORE_SZ >> 16);
 
-	/**
-	 * @todo
-	 * Create a function to read 64-bit timer
-	 */
-	last_idle_time = MMR_RTC_MTIME;
+	if (pqueue_init(&_sched_ready, MAX_TASKS) != 0)
+		return -ENOMEM;
+
+	last_idle_time = timer_get_time();
+
+	return 0;
+}
+
+/**
+ * @brief Gets the latest time a RT task can start running without losing its deadline
+ * 
+ * @details While the task is not running this value is constant, so it orders
+ * the ready queue exactly as the slack time does.
+ * 
+ * @param sched Pointer to the scheduler
+ * 
+ * @return uint64_t Latest start time
+ */
+uint64_t _sched_latest_start(sched_t *sched)
+{
+	return sched->ready_time + sched->deadline - sched->remaining_exec_time;
+}
+
+/**
+ * @brief Inserts a BE task in the round-robin ring
+ * 
+ * @details The task is placed behind the ring cursor, running last in the round
+ * 
+ * @param sched Pointer to the scheduler
+ */
+void _sched_be_insert(sched_t *sched)
+{
+	if (sched->next != NULL)
+		return;
+
+	if (_sched_be == NULL) {
+		sched->next = sched;
+		sched->prev = sched;
+		_sched_be = sched;
+		return;
+	}
+
+	sched->next = _sched_be;
+	sched->prev = _sched_be->prev;
+	_sched_be->prev->next = sched;
+	_sched_be->prev = sched;
+}
+
+/**
+ * @brief Removes a BE task from the round-robin ring
+ * 
+ * @param sched Pointer to the scheduler
+ */
+void _sched_be_remove(sched_t *sched)
+{
+	if (sched->next == NULL)
+		return;
+
+	if (sched->next == sched) {
+		_sched_be = NULL;
+	} else {
+		sched->prev->next = sched->next;
+		sched->next->prev = sched->prev;
+
+		if (_sched_be == sched)
+			_sched_be = sched->next;
+	}
+
+	sched->next = NULL;
+	sched->prev = NULL;
+}
+
+/**
+ * @brief Inserts a task in its ready structure if it is able to run
+ * 
+ * @param sched Pointer to the scheduler
+ */
+void _sched_enqueue(sched_t *sched)
+{
+	if (sched->waiting_msg != SCHED_WAIT_NO)
+		return;
+
+	if (sched->deadline == SCHED_NO_DEADLINE) {
+		_sched_be_insert(sched);
+	} else if (sched->status == SCHED_READY && !pqueue_is_queued(&(sched->ready_node))) {
+		pqueue_push(&_sched_ready, &(sched->ready_node), _sched_latest_start(sched));
+	} else {
+		return;
+	}
+
+	/* The running task now contends for the CPU and must be preempted */
+	if (_sched_tickless) {
+		_sched_tickless = false;
+		timer_program(SCHED_MAX_TIME_SLICE);
+	}
+}
+
+/**
+ * @brief Removes a task from its ready structure
+ * 
+ * @param sched Pointer to the scheduler
+ */
+void _sched_dequeue(sched_t *sched)
+{
+	if (sched->deadline == SCHED_NO_DEADLINE)
+		_sched_be_remove(sched);
+	else
+		pqueue_remove(&_sched_ready, &(sched->ready_node));
+}
+
+/**
+ * @brief Handles the end of period of a RT task
+ * 
+ * @details Called by the timer module. The task is set to READY and its next
+ * end of period is registered.
+ * 
+ * @param arg Pointer to the scheduler
+ */
+void _sched_release(void *arg)
+{
+	sched_t *sched = arg;
+
+	/* Previous job did not complete its execution in the period */
+	if (sched->status != SCHED_SLEEPING && sched->remaining_exec_time > 0)
+		_sched_deadline_misses++;
+
+	sched->ready_time += sched->period;
+	sched->remaining_exec_time = sched->exec_time;
+
+	/* End of period -- ready to run */
+	sched->status = SCHED_READY;
+
+	timer_set(&(sched->release_evt), sched->ready_time + sched->period);
+
+	if (pqueue_is_queued(&(sched->ready_node)))
+		pqueue_update(&_sched_ready, &(sched->ready_node), _sched_latest_start(sched));
+	else
+		_sched_enqueue(sched);
 }
 
 sched_t *sched_emplace_back(tcb_t *tcb)
 {
-	sched_t *sched = malloc(sizeof(sched_t));
+	sched_t *sched = pool_alloc(sizeof(sched_t));
 
 	if(sched == NULL)
 		return NULL;
 
-	if(list_push_back(&_scheds, sched) == NULL){
-		free(sched);
-		return NULL;
-	}
-
 	sched->status = SCHED_READY;
 	sched->waiting_msg = SCHED_WAIT_NO;
 	sched->last_monitored = 0;
@@ -85,14 +222,17 @@ sched_t *sched_emplace_back(tcb_t *tcb)
 	sched->running_start_time = 0;
 	sched->utilization = 0;
 
+	pqueue_node_init(&(sched->ready_node), sched);
+	timer_evt_init(&(sched->release_evt), _sched_release, sched);
+	sched->next = NULL;
+	sched->prev = NULL;
+
 	sched->tcb = tcb;
 
 	tcb_set_sched(tcb, sched);
 
-	if (list_get_size(&_scheds) > 1) {
-		// printf("Enabling MTI\n");
-		_hal_enable_mti();
-	}
+	_sched_cnt++;
+	_sched_enqueue(sched);
 
 	return sched;
 }
@@ -104,23 +244,24 @@ bool sched_is_idle()
 
 void sched_remove(sched_t *sched)
 {
+	/* Task was never released */
+	if (sched == NULL)
+		return;
+
 	if(sched->deadline != SCHED_NO_DEADLINE){
 		cpu_utilization -= sched->utilization;
-		printf(" ----> CPU utilization decremented by %d, now is %d\n", sched->utilization, cpu_utilization);
+		kdebug(" ----> CPU utilization decremented by %d, now is %d\n", sched->utilization, cpu_utilization);
 	}
 
-	list_entry_t *entry = list_find(&_scheds, sched, NULL);
-	if(entry != NULL)
-		list_remove(&_scheds, entry);
+	_sched_dequeue(sched);
+	timer_cancel(&(sched->release_evt));
 
-	free(sched);
+	if (_sched_running == sched)
+		_sched_running = NULL;
 
-	if (list_get_size(&_scheds) <= 1){
-		sched_t *rem = list_get_data(list_front(&_scheds));
-		// printf("Disabling MTI\n");
-		if (rem == NULL || (rem->deadline != SCHED_NO_DEADLINE))
-			_hal_disable_mti();
-	}
+	_sched_cnt--;
+
+	pool_free(sched);
 }
 
 tcb_t *sched_get_current_tcb()
@@ -130,11 +271,7 @@ tcb_t *sched_get_current_tcb()
 
 void sched_update_slack_time()
 {
-	/**
-	 * @todo
-	 * Create a function to read 64-bit timer
-	 */
-	total_slack_time += MMR_RTC_MTIME - last_idle_time;
+	total_slack_time += timer_get_time() - last_idle_time;
 }
 
 bool sched_is_waiting_msgreq(sched_t *sched)
@@ -160,20 +297,18 @@ void sched_release_wait(sched_t *sched)
 	
 	// printf("CLEARING!\n");
 	sched->waiting_msg = SCHED_WAIT_NO;
+	_sched_enqueue(sched);
 }
 
 void sched_update_idle_time()
 {
-	/**
-	 * @todo
-	 * Create a function to read 64-bit timer
-	 */
-	last_idle_time = MMR_RTC_MTIME;
+	last_idle_time = timer_get_time();
 	MMR_DBG_SCHED_REPORT = REPORT_IDLE;
 }
 
 void sched_set_wait_msgreq(sched_t *sched)
 {
+	_sched_dequeue(sched);
 	sched->waiting_msg = SCHED_WAIT_REQUEST;
 }
 
@@ -182,11 +317,13 @@ void sched_set_wait_dav(sched_t *sched)
 	if (tcb_get_id(sched->tcb) == mpipe_owner())
 		MMR_DMNI_IRQ_IE |= (1 << DMNI_IE_MONITOR);
 
+	_sched_dequeue(sched);
 	sched->waiting_msg = SCHED_WAIT_DATA_AV;
 }
 
 void sched_set_wait_msgdlvr(sched_t *sched)
 {
+	_sched_dequeue(sched);
 	sched->waiting_msg = SCHED_WAIT_DELIVERY;
 }
 
@@ -205,80 +342,10 @@ unsigned sched_get_exec_time(sched_t *sched)
 	return sched->exec_time;
 }
 
-void _sched_dynamic_slice_time(sched_t *scheduled, unsigned time)
+void _sched_update_task_slack_time(sched_t *sched, uint64_t current_time)
 {
-	unsigned closer_period = 0;
-	unsigned second_lst = 0;
-
-	/* Searches for the second task with the least slack time and the closer end of period */
-	list_entry_t *entry = list_front(&_scheds);
-
-	while(entry != NULL){
-		sched_t *sched = list_get_data(entry);
-
-		if(sched->deadline == SCHED_NO_DEADLINE || sched == scheduled){
-			entry = list_next(entry);
-			continue;
-		}
-
-		if(sched->status == SCHED_SLEEPING || sched->waiting_msg != SCHED_WAIT_NO){
-			unsigned end_period = sched->ready_time + sched->period;
-			if(closer_period == 0 || end_period < closer_period)
-				closer_period = end_period;
-			
-		} else if(
-			scheduled->slack_time && 
-			(second_lst == 0 || second_lst > sched->slack_time)
-		){
-			/* Only RUNNING, READY tasks */
-			second_lst = sched->slack_time;
-		}
-
-		entry = list_next(entry);
-	}
-
-	/* Decides to extend the time slice */
-	if(second_lst > 0 && second_lst < time_slice)
-		time_slice = second_lst;
-
-	if(closer_period > 0 && (closer_period - time) < time_slice)
-		time_slice = closer_period - time;
-
-}
-
-void _sched_idle_slice_time(unsigned time)
-{
-	time_slice = 0;
-
-	/* Searches for the next end of period */
-	list_entry_t *entry = list_front(&_scheds);
-	while(entry != NULL){
-		sched_t *sched = list_get_data(entry);
-
-		if(sched->deadline == SCHED_NO_DEADLINE){
-			entry = list_next(entry);
-			continue;
-		}
-
-		if(sched->status == SCHED_SLEEPING || sched->waiting_msg != SCHED_WAIT_NO){
-			unsigned end_period = sched->ready_time + sched->period;
-			if(time_slice == 0 || end_period < time_slice)
-				time_slice = end_period;
-		}
-
-		entry = list_next(entry);
-	}
-
-	if(time_slice)
-		time_slice = time_slice - time;
-	else
-		time_slice = SCHED_MAX_TIME_SLICE;
-}
-
-void _sched_update_task_slack_time(sched_t *sched, unsigned current_time)
-{
-	int relative_deadline = sched->ready_time + sched->deadline;
-	int time_until_deadline = relative_deadline - current_time;
+	uint64_t relative_deadline = sched->ready_time + sched->deadline;
+	int64_t time_until_deadline = relative_deadline - current_time;
 
 	if(time_until_deadline < sched->remaining_exec_time)
 		sched->slack_time = 0;
@@ -286,155 +353,101 @@ void _sched_update_task_slack_time(sched_t *sched, unsigned current_time)
 		sched->slack_time = time_until_deadline - sched->remaining_exec_time;
 }
 
-void _sched_rt_update(unsigned current_time, unsigned schedule_overhead)
+void _sched_dynamic_slice_time(sched_t *scheduled, uint64_t time)
 {
-	bool should_monitor = llm_has_monitor(MON_QOS);
-
-	list_entry_t *entry = list_front(&_scheds);
-	while(entry != NULL){
-		sched_t *sched = list_get_data(entry);
+	/* The task with the second least slack time is now in front of the ready queue */
+	sched_t *second = pqueue_front(&_sched_ready);
+	if (second != NULL && scheduled->slack_time) {
+		_sched_update_task_slack_time(second, time);
+
+		/* Decides to extend the time slice */
+		if (second->slack_time > 0 && second->slack_time < time_slice)
+			time_slice = second->slack_time;
+	}
+}
 
-		/* If the current task is a BEST EFFORT task then continue the loop */
-		if(sched->deadline == SCHED_NO_DEADLINE){
-			/* If the current task is BEST EFFORT only set it status to READY */
-			if(sched->status == SCHED_RUNNING && sched->waiting_msg == SCHED_WAIT_NO)
-				sched->status = SCHED_READY;
+void _sched_rt_update(uint64_t current_time, unsigned schedule_overhead)
+{
+	bool should_monitor = llm_has_monitor(MON_QOS);
 
-			entry = list_next(entry);
-			continue;
-		}
+	/* Only the task that was running has consumed execution time */
+	sched_t *sched = _sched_running;
+	_sched_running = NULL;
 
-		if(sched->status == SCHED_RUNNING){
-			/* Remaining execution time is equal to the time that the task 
-								started its execution until the current time */
-			sched->remaining_exec_time -= 
-				(current_time - schedule_overhead) - sched->running_start_time;
-
-			/* If the task has finished its execution, it must SLEEP until the end of its period */
-			if(sched->remaining_exec_time <= 0){
-				/* When the task is set to SLEEP, the function 
-					'sched_update_slack_time' must be called once one last time 
-													to update its final slack */
-				/* This slack can be used to monitor the efective slack time of the task */
-				sched->remaining_exec_time = 0;
-				sched->status = SCHED_SLEEPING;
-
-				_sched_update_task_slack_time(sched, current_time);
-
-			} else {
-				/* However, if the task has not finished its execution, it goes to READY again */
-				sched->status = SCHED_READY;
-			}
+	if (sched != NULL && sched->deadline == SCHED_NO_DEADLINE) {
+		/* If the current task is BEST EFFORT only set it status to READY */
+		if(sched->waiting_msg == SCHED_WAIT_NO)
+			sched->status = SCHED_READY;
 
-			/* Monitor RT task after update */
-			if (should_monitor) {
-				int id = tcb_get_id(sched->tcb);
-				int appid = id >> 8;
-				int mig_pe = tcb_get_migrate_addr(sched->tcb);
-				
-				if (appid != 0 && mig_pe == -1 && sched->waiting_msg == SCHED_WAIT_NO) {
-					llm_rt(
-						&(sched->last_monitored), 
-						id, 
-						sched->slack_time, 
-						sched->remaining_exec_time
-					);
-				}
-			}
-		}
+	} else if (sched != NULL && sched->status == SCHED_RUNNING) {
+		/* Remaining execution time is equal to the time that the task 
+							started its execution until the current time */
+		sched->remaining_exec_time -= 
+			(current_time - schedule_overhead) - sched->running_start_time;
+
+		/* If the task has finished its execution, it must SLEEP until the end of its period */
+		if(sched->remaining_exec_time <= 0){
+			/* When the task is set to SLEEP, the function 
+				'sched_update_slack_time' must be called once one last time 
+												to update its final slack */
+			/* This slack can be used to monitor the efective slack time of the task */
+			sched->remaining_exec_time = 0;
+			sched->status = SCHED_SLEEPING;
 
-		/* Below this region, the task chosen is a valid real-time task */
-		/* The first step is verify its period. If the period has finished, the task must be set to READY */
-		if(current_time >= (sched->ready_time + sched->period)){
-			sched->ready_time += sched->period;
-			sched->remaining_exec_time = sched->exec_time;
+			_sched_update_task_slack_time(sched, current_time);
 
-			/* End of period -- ready to run */
+		} else {
+			/* However, if the task has not finished its execution, it goes to READY again */
 			sched->status = SCHED_READY;
+			_sched_enqueue(sched);
 		}
 
-		/* For all real-time task that are not SLEEPING, the slack time must be updated at each scheduler call */
-		if(sched->status != SCHED_SLEEPING)
-			_sched_update_task_slack_time(sched, current_time);
-
-		entry = list_next(entry);
+		/* Monitor RT task after update */
+		if (should_monitor) {
+			int id = tcb_get_id(sched->tcb);
+			int appid = id >> 8;
+			int mig_pe = tcb_get_migrate_addr(sched->tcb);
+			
+			if (appid != 0 && mig_pe == -1 && sched->waiting_msg == SCHED_WAIT_NO) {
+				llm_rt(
+					&(sched->last_monitored), 
+					id, 
+					sched->slack_time, 
+					sched->remaining_exec_time
+				);
+			}
+		}
 	}
+
+	/* Only the real-time tasks whose period has finished are touched. They are set to READY by the timer */
+	timer_expire(current_time);
 }
 
-sched_t *_sched_lst(unsigned current_time)
+sched_t *_sched_lst(uint64_t current_time)
 {
-	static sched_t *_last_scheduled = NULL;
 	static unsigned schedule_overhead = 500;	//!<Used to dynamically estimate the scheduler overhead
 
-	unsigned instant_overhead = current_time;
+	uint64_t call_time = current_time;
 	current_time += schedule_overhead;
 
-	/* Updates real-time parameters: slack_time, ready_time, remaining_exe_time, status */
+	/* Updates real-time parameters: ready_time, remaining_exe_time, status */
 	_sched_rt_update(current_time, schedule_overhead);
 
-	sched_t *scheduled = NULL;
-
-	list_entry_t *entry = list_front(&_scheds);
-	while (entry != NULL) {
-		sched_t *sched = list_get_data(entry);
-
-		// printf("Trying %x\n", sched->tcb->id);
-		// printf("Deadline = %d\n", sched->deadline);
-		// printf("STATUS = %d\n", sched->status);
-		// printf("WAITING = %d\n", sched->waiting_msg);
-		
-		if (
-			sched->deadline != SCHED_NO_DEADLINE && 
-			sched->status == SCHED_READY && 
-			sched->waiting_msg == SCHED_WAIT_NO
-		) {
-			if(scheduled == NULL || (sched->slack_time < scheduled->slack_time))
-				scheduled = sched;
-		}
-
-		entry = list_next(entry);
-	}
+	/* The real-time task with the least slack time is in front of the ready queue */
+	sched_t *scheduled = pqueue_front(&_sched_ready);
 
-	/* If no real-time tasks are scheduled, selects the next round-robin BEST EFFORT task */
-	if (scheduled == NULL) {
-		/* Fire the round robin */
-		entry = list_find(&_scheds, _last_scheduled, NULL);
-		
-		if (entry != NULL)
-			entry = list_next(entry);
-
-		while (entry != NULL) {
-			sched_t *sched = list_get_data(entry);
-
-			if(sched->status == SCHED_READY && sched->waiting_msg == SCHED_WAIT_NO){
-				scheduled = sched;
-				break;
-			}
-
-			entry = list_next(entry);
-		}
-
-		if (scheduled == NULL) {
-			entry = list_front(&_scheds);
-			while (entry != NULL) {
-				sched_t *sched = list_get_data(entry);
-
-				if(sched->status == SCHED_READY && sched->waiting_msg == SCHED_WAIT_NO){
-					scheduled = sched;
-					break;
-				}
-
-				if (sched == _last_scheduled)
-					break;
-				
-				entry = list_next(entry);
-			}
-		}
+	if (scheduled != NULL) {
+		pqueue_remove(&_sched_ready, &(scheduled->ready_node));
+		_sched_update_task_slack_time(scheduled, current_time);
+	} else if (_sched_be != NULL) {
+		/* If no real-time tasks are scheduled, selects the next round-robin BEST EFFORT task */
+		scheduled = _sched_be;
+		_sched_be = scheduled->next;
 	}
 
 	/* If at least one task has been selected (BEST EFFORT or REAL TIME) */
 	if (scheduled != NULL) {
-		_last_scheduled = scheduled;
+		_sched_running = scheduled;
 
 		scheduled->status = SCHED_RUNNING;
 
@@ -448,24 +461,14 @@ sched_t *_sched_lst(unsigned current_time)
 
 		if(scheduled->deadline != SCHED_NO_DEADLINE){
 			/* Sets the task running start time to the current time */
-			/**
-			 * @todo
-			 * Create a function to read 64-bit timer
-			 */
-			scheduled->running_start_time = MMR_RTC_MTIME;
+			scheduled->running_start_time = timer_get_time();
 		}
 
-	} else { 
-		/* Schedules Idle */
-		_sched_idle_slice_time(current_time);
 	}
 
-	/**
-	 * @todo
-	 * Create a function to read 64-bit timer
-	 */
-	instant_overhead = MMR_RTC_MTIME - instant_overhead;
+	unsigned instant_overhead = timer_get_time() - call_time;
 	schedule_overhead = (schedule_overhead + instant_overhead) >> 1;
+	perf_sched_overhead(schedule_overhead);
 
 	return scheduled;
 }
@@ -473,40 +476,49 @@ sched_t *_sched_lst(unsigned current_time)
 void sched_run()
 {
 	// puts("Scheduler called!");
-	/**
-	 * @todo
-	 * Create a function to read 64-bit timer
-	 */
-	unsigned scheduler_call_time = MMR_RTC_MTIME;
+	uint64_t scheduler_call_time = timer_get_time();
+	uint64_t entry = perf_cycles();
 
 	MMR_DBG_SCHED_REPORT = REPORT_SCHEDULER;
 
+	_sched_tickless = false;
+
 	sched_t *sched = _sched_lst(scheduler_call_time);
 	
 	if (sched != NULL) {
 		current = sched->tcb;
 		// printf("Current = %x\n", current->id);
 		sched_report(tcb_get_id(current));
-		/**
-		 * @todo
-		 * Create a function to update the 64-bit timer
-		*/
-		MMR_RTC_MTIMECMPH = 0;
-		MMR_RTC_MTIMECMP = MMR_RTC_MTIME + time_slice;
 	} else {
 		// printf("CURRENT IS NULL!\n");
 		current = NULL;
 		sched_update_idle_time();
 	}
+
+	/**
+	 * A slice is only needed to account a RT task or to share the CPU with
+	 * other BE tasks. Otherwise, sleeps until the next timer event.
+	 */
+	_sched_tickless = (
+		sched == NULL || 
+		(sched->deadline == SCHED_NO_DEADLINE && sched->next == sched)
+	);
+
+	if (_sched_tickless)
+		timer_program_tickless();
+	else
+		timer_program(time_slice);
+
+	perf_sched(perf_cycles() - entry);
 }
 
 void sched_real_time_task(sched_t *sched, unsigned period, int deadline, unsigned execution_time)
 {
-	/**
-	 * @todo
-	 * Create a function to read 64-bit timer
-	 */
-	unsigned current_time = MMR_RTC_MTIME;
+	uint64_t current_time = timer_get_time();
+
+	/* Leave the round-robin ring before becoming a RT task */
+	if (sched->deadline == SCHED_NO_DEADLINE)
+		_sched_be_remove(sched);
 
 	sched->period = period;
 	sched->deadline = deadline;
@@ -514,7 +526,7 @@ void sched_real_time_task(sched_t *sched, unsigned period, int deadline, unsigne
 
 	/* If task has already called RealTime */
 	if(sched->ready_time == 0){
-		unsigned ready_time = ((unsigned)(current_time / period)) * period;
+		uint64_t ready_time = (current_time / period) * period;
 
 		while(ready_time < current_time)
 			ready_time += period;
@@ -532,7 +544,10 @@ void sched_real_time_task(sched_t *sched, unsigned period, int deadline, unsigne
 
 	cpu_utilization += sched->utilization;
 
-	_hal_enable_mti();
+	/* Requeue the task with the new constraints */
+	pqueue_remove(&_sched_ready, &(sched->ready_node));
+	timer_set(&(sched->release_evt), sched->ready_time + sched->period);
+	_sched_enqueue(sched);
 }
 
 sched_wait_t sched_get_waiting_msg(sched_t *sched)
@@ -542,7 +557,13 @@ sched_wait_t sched_get_waiting_msg(sched_t *sched)
 
 void sched_set_waiting_msg(sched_t *sched, sched_wait_t waiting_msg)
 {
-	sched->waiting_msg = waiting_msg;
+	if (waiting_msg == SCHED_WAIT_NO) {
+		sched->waiting_msg = waiting_msg;
+		_sched_enqueue(sched);
+	} else {
+		_sched_dequeue(sched);
+		sched->waiting_msg = waiting_msg;
+	}
 }
 
 void sched_report_interruption()
@@ -555,7 +576,7 @@ void sched_report(int id)
 	MMR_DBG_SCHED_REPORT = id;
 }
 
-bool sched_enabled()
+unsigned sched_get_deadline_misses()
 {
-	return (list_get_size(&_scheds) > 1);
+	return _sched_deadline_misses;
 }
@@ -0,0 +1,195 @@
+/**
+ * MAestro
+ * @file text_cache.c
+ *
+ * @author Angelo Elias Dalzotto (angelo.dalzotto@edu.pucrs.br)
+ * GAPH - Hardware Design Support Group (https://corfu.pucrs.br/)
+ * PUCRS - Pontifical Catholic University of Rio Grande do Sul (http://pucrs.br/)
+ *
+ * @date October 2026
+ *
+ * @brief Per-PE cache of task binaries (.text) identified by content.
+ */
+
+#include <text_cache.h>
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include <mutils/list.h>
+
+list_t _tcache;				//!< Entries, least recently used first
+size_t _tcache_used = 0;	//!< Bytes held by kernel copies
+
+/**
+ * @brief Text identification used to find an entry
+ */
+typedef struct _tcache_key {
+	uint64_t hash;
+	size_t size;
+} tcache_key_t;
+
+/**
+ * @brief Finds an entry by its text
+ *
+ * @param data Pointer to the entry
+ * @param cmpval Pointer to the key
+ *
+ * @return True if the entry holds the text
+ */
+bool _tcache_find_key_fnc(void *data, void *cmpval);
+
+/**
+ * @brief Finds an entry by its owner
+ *
+ * @param data Pointer to the entry
+ * @param cmpval Pointer to the owner
+ *
+ * @return True if the entry is of the owner
+ */
+bool _tcache_find_owner_fnc(void *data, void *cmpval);
+
+/**
+ * @brief Drops the least recently used kernel copies
+ *
+ * @param size Bytes that must fit the budget
+ *
+ * @return True if size fits the budget
+ */
+bool _tcache_evict(size_t size);
+
+void tcache_init()
+{
+	list_init(&_tcache);
+}
+
+uint64_t tcache_hash(const void *text, size_t size)
+{
+	const uint32_t *word = text;
+	uint64_t hash = 14695981039346656037ull;
+
+	for (size_t i = 0; i < (size >> 2); i++) {
+		hash ^= word[i];
+		hash *= 1099511628211ull;
+	}
+
+	/* 0 flags an unknown text */
+	return (hash == 0) ? 1 : hash;
+}
+
+int tcache_add(void *owner, uint64_t hash, const void *text, size_t size)
+{
+	tcache_entry_t *entry = malloc(sizeof(tcache_entry_t));
+	if (entry == NULL)
+		return -ENOMEM;
+
+	entry->hash  = hash;
+	entry->size  = size;
+	entry->text  = text;
+	entry->owner = owner;
+
+	if (list_push_back(&_tcache, entry) == NULL) {
+		free(entry);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+void tcache_remove(void *owner)
+{
+	list_entry_t *le = list_find(&_tcache, owner, _tcache_find_owner_fnc);
+	if (le == NULL)
+		return;
+
+	tcache_entry_t *entry = list_get_data(le);
+	list_remove(&_tcache, le);
+
+	/* Another task or copy still holds the text */
+	tcache_key_t key = {.hash = entry->hash, .size = entry->size};
+	if (list_find(&_tcache, &key, _tcache_find_key_fnc) != NULL || !_tcache_evict(entry->size)) {
+		free(entry);
+		return;
+	}
+
+	void *copy = malloc(entry->size);
+	if (copy == NULL) {
+		free(entry);
+		return;
+	}
+
+	memcpy(copy, entry->text, entry->size);
+	entry->text  = copy;
+	entry->owner = NULL;
+
+	if (list_push_back(&_tcache, entry) == NULL) {
+		free(copy);
+		free(entry);
+		return;
+	}
+
+	_tcache_used += entry->size;
+}
+
+bool tcache_load(uint64_t hash, size_t size, void *dst)
+{
+	tcache_key_t key = {.hash = hash, .size = size};
+
+	list_entry_t *le = list_find(&_tcache, &key, _tcache_find_key_fnc);
+	if (le == NULL)
+		return false;
+
+	tcache_entry_t *entry = list_get_data(le);
+	memcpy(dst, entry->text, size);
+
+	if (entry->owner == NULL) {
+		/* Most recently used copy goes to the back */
+		list_remove(&_tcache, le);
+		if (list_push_back(&_tcache, entry) == NULL) {
+			_tcache_used -= entry->size;
+			free((void*)entry->text);
+			free(entry);
+		}
+	}
+
+	return true;
+}
+
+bool _tcache_evict(size_t size)
+{
+	if (size > TCACHE_BUDGET)
+		return false;
+
+	list_entry_t *le = list_front(&_tcache);
+	while (le != NULL && _tcache_used + size > TCACHE_BUDGET) {
+		tcache_entry_t *entry = list_get_data(le);
+		list_entry_t *next = list_next(le);
+
+		if (entry->owner == NULL) {
+			list_remove(&_tcache, le);
+			_tcache_used -= entry->size;
+			free((void*)entry->text);
+			free(entry);
+		}
+
+		le = next;
+	}
+
+	return (_tcache_used + size <= TCACHE_BUDGET);
+}
+
+bool _tcache_find_key_fnc(void *data, void *cmpval)
+{
+	tcache_entry_t *entry = data;
+	tcache_key_t *key = cmpval;
+
+	return (entry->hash == key->hash && entry->size == key->size);
+}
+
+bool _tcache_find_owner_fnc(void *data, void *cmpval)
+{
+	tcache_entry_t *entry = data;
+
+	return (entry->owner == cmpval);
+}
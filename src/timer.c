@@ -0,0 +1,162 @@
+/**
+ * MAestro
+ * @file timer.c
+ *
+ * @author Angelo Elias Dalzotto (angelo.dalzotto@edu.pucrs.br)
+ * GAPH - Hardware Design Support Group (https://corfu.pucrs.br/)
+ * PUCRS - Pontifical Catholic University of Rio Grande do Sul (http://pucrs.br/)
+ *
+ * @date October 2026
+ *
+ * @brief Per-PE timer event queue.
+ */
+
+#include <timer.h>
+
+#include <stddef.h>
+#include <errno.h>
+
+#include <mmr.h>
+#include <hal.h>
+
+static const unsigned TIMER_TASK_EVTS = 2;			//!< Events per task: release and migration pre-copy
+static const unsigned TIMER_KERNEL_EVTS = 4;		//!< Events owned by the kernel besides the task ones
+static const unsigned TIMER_COALESCE_WINDOW = 2000;	//!< Events this close to the first one are served by the same interrupt
+static const uint64_t TIMER_NEVER = UINT64_MAX;
+
+pqueue_t _timer_evts;
+uint64_t _timer_target = UINT64_MAX;	//!< Time programmed in the compare register, TIMER_NEVER if disabled
+
+/**
+ * @brief Programs the timer interrupt
+ *
+ * @details The first event expiration is postponed to serve the events inside
+ * the coalescing window with a single interrupt, but never beyond the end of
+ * slice.
+ *
+ * @param slice_end End of the running slice, TIMER_NEVER if no slice
+ */
+void _timer_reprogram(uint64_t slice_end);
+
+/**
+ * @brief Writes the 64-bit RTC compare register
+ *
+ * @details The lower word is first set to its maximum, so no interrupt is
+ * raised by a compare value that is only partially written.
+ *
+ * @param time Compare value in clock cycles
+ */
+void _timer_set_compare(uint64_t time);
+
+uint64_t timer_get_time()
+{
+	uint32_t high;
+	uint32_t low;
+
+	do {
+		high = MMR_RTC_MTIMEH;
+		low  = MMR_RTC_MTIME;
+	} while (high != MMR_RTC_MTIMEH);
+
+	return (((uint64_t)high) << 32) | low;
+}
+
+int timer_init()
+{
+	const unsigned MAX_TASKS = (MMR_DMNI_INF_MANYCORE_SZ >> 16);
+
+	return pqueue_init(&_timer_evts, MAX_TASKS*TIMER_TASK_EVTS + TIMER_KERNEL_EVTS);
+}
+
+void timer_evt_init(timer_evt_t *evt, void (*handler)(void *arg), void *arg)
+{
+	pqueue_node_init(&(evt->node), evt);
+	evt->handler = handler;
+	evt->arg = arg;
+}
+
+int timer_set(timer_evt_t *evt, uint64_t time)
+{
+	if (pqueue_is_queued(&(evt->node))) {
+		pqueue_update(&_timer_evts, &(evt->node), time);
+	} else {
+		int ret = pqueue_push(&_timer_evts, &(evt->node), time);
+		if (ret != 0)
+			return ret;
+	}
+
+	/* Anticipates the interrupt if the event is before the programmed one */
+	if (time < _timer_target) {
+		_timer_target = time;
+		_timer_set_compare(time);
+		_hal_enable_mti();
+	}
+
+	return 0;
+}
+
+void timer_cancel(timer_evt_t *evt)
+{
+	pqueue_remove(&_timer_evts, &(evt->node));
+}
+
+bool timer_is_set(timer_evt_t *evt)
+{
+	return pqueue_is_queued(&(evt->node));
+}
+
+void timer_expire(uint64_t time)
+{
+	while (!pqueue_empty(&_timer_evts) && pqueue_front_key(&_timer_evts) <= time) {
+		timer_evt_t *evt = pqueue_front(&_timer_evts);
+		pqueue_remove(&_timer_evts, &(evt->node));
+
+		if (evt->handler != NULL)
+			evt->handler(evt->arg);
+	}
+}
+
+void timer_program(unsigned slice)
+{
+	_timer_reprogram(timer_get_time() + slice);
+}
+
+void timer_program_tickless()
+{
+	_timer_reprogram(TIMER_NEVER);
+}
+
+bool timer_expired()
+{
+	return (_timer_target != TIMER_NEVER && timer_get_time() >= _timer_target);
+}
+
+void _timer_reprogram(uint64_t slice_end)
+{
+	uint64_t time = slice_end;
+
+	if (!pqueue_empty(&_timer_evts)) {
+		uint64_t first = pqueue_front_key(&_timer_evts);
+		uint64_t last = pqueue_last_key_until(&_timer_evts, first + TIMER_COALESCE_WINDOW);
+
+		if (last < time)
+			time = last;
+	}
+
+	_timer_target = time;
+
+	if (time == TIMER_NEVER) {
+		_hal_disable_mti();
+		return;
+	}
+
+	_timer_set_compare(time);
+	_hal_enable_mti();
+}
+
+void _timer_set_compare(uint64_t time)
+{
+	MMR_RTC_MTIMECMP  = UINT32_MAX;
+	MMR_RTC_MTIMECMPH = time >> 32;
+	MMR_RTC_MTIMECMP  = time & UINT32_MAX;
+}
@@ -0,0 +1,52 @@
+/**
+ * MAestro
+ * @file trace.c
+ *
+ * @author Angelo Elias Dalzotto (angelo.dalzotto@edu.pucrs.br)
+ * GAPH - Hardware Design Support Group (https://corfu.pucrs.br/)
+ * PUCRS - Pontifical Catholic University of Rio Grande do Sul (http://pucrs.br/)
+ *
+ * @date October 2026
+ *
+ * @brief Binary event trace and compile-time print levels.
+ */
+
+#include <trace.h>
+
+#include <mmr.h>
+
+trace_rec_t _trace_ring[TRACE_RING_SZ];
+unsigned _trace_cnt = 0;	//!< Records in the ring, oldest at index 0
+
+void trace(trace_evt_t evt, int task, uint32_t arg0, uint32_t arg1)
+{
+	if (!TRACE_ENABLE)
+		return;
+
+	if (_trace_cnt == TRACE_RING_SZ)
+		trace_drain();
+
+	trace_rec_t *rec = &_trace_ring[_trace_cnt++];
+	rec->time   = MMR_RTC_MTIME;
+	rec->evt    = evt;
+	rec->task   = task;
+	rec->arg[0] = arg0;
+	rec->arg[1] = arg1;
+}
+
+void trace_drain()
+{
+	if (!TRACE_ENABLE)
+		return;
+
+	/* Burst of 4 words per record */
+	for (unsigned i = 0; i < _trace_cnt; i++) {
+		uint32_t *word = (uint32_t*)&_trace_ring[i];
+		MMR_DBG_TRACE = word[0];
+		MMR_DBG_TRACE = word[1];
+		MMR_DBG_TRACE = word[2];
+		MMR_DBG_TRACE = word[3];
+	}
+
+	_trace_cnt = 0;
+}
@@ -0,0 +1,87 @@
+/**
+ * MAestro
+ * @file zrle.c
+ *
+ * @author Angelo Elias Dalzotto (angelo.dalzotto@edu.pucrs.br)
+ * GAPH - Hardware Design Support Group (https://corfu.pucrs.br/)
+ * PUCRS - Pontifical Catholic University of Rio Grande do Sul (http://pucrs.br/)
+ *
+ * @date October 2026
+ *
+ * @brief Zero-run encoding of memory images.
+ */
+
+#include <zrle.h>
+
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+static const unsigned ZRLE_MAX_RUN = 0xFFFF;	//!< Maximum zeros or literals of a group
+
+size_t zrle_encode(const void *src, size_t size, void *dst, size_t max)
+{
+	const uint32_t *in = src;
+	uint32_t *out = dst;
+	size_t words = size >> 2;
+	size_t cap = max >> 2;
+	size_t i = 0;
+	size_t o = 0;
+
+	while (i < words) {
+		unsigned zeros = 0;
+		while (i < words && in[i] == 0 && zeros < ZRLE_MAX_RUN) {
+			zeros++;
+			i++;
+		}
+
+		/* A single zero word costs less as a literal than as a new header */
+		size_t first = i;
+		unsigned literals = 0;
+		while (
+			i < words && 
+			literals < ZRLE_MAX_RUN && 
+			!(in[i] == 0 && (i + 1 == words || in[i + 1] == 0))
+		) {
+			literals++;
+			i++;
+		}
+
+		if (o + 1 + literals > cap)
+			return 0;
+
+		out[o++] = (zeros << 16) | literals;
+		memcpy(&out[o], &in[first], literals << 2);
+		o += literals;
+	}
+
+	return o << 2;
+}
+
+int zrle_decode(const void *src, size_t enc_size, void *dst, size_t size)
+{
+	const uint32_t *in = src;
+	uint32_t *out = dst;
+	size_t in_words = enc_size >> 2;
+	size_t out_words = size >> 2;
+	size_t i = 0;
+	size_t o = 0;
+
+	while (i < in_words) {
+		uint32_t header = in[i++];
+		unsigned zeros = header >> 16;
+		unsigned literals = header & ZRLE_MAX_RUN;
+
+		if (o + zeros + literals > out_words || i + literals > in_words)
+			return -EINVAL;
+
+		memset(&out[o], 0, zeros << 2);
+		o += zeros;
+
+		memcpy(&out[o], &in[i], literals << 2);
+		o += literals;
+		i += literals;
+	}
+
+	return o << 2;
+}